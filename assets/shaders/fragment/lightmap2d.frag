@@ -0,0 +1,12 @@
+#version 300 es
+precision highp float;
+
+uniform sampler2D lightmap;
+smooth in vec2 fragTexCoord;
+out vec4 fragColor;
+
+void main()
+{
+  // Already scaled down by the light buffer range when baked
+  fragColor = vec4(texture(lightmap, fragTexCoord).rgb, 1.0f);
+}
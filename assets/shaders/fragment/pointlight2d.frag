@@ -1,21 +1,32 @@
 #version 300 es
 precision highp float;
 
-smooth in vec3 fragPos;
-flat in vec3 fragBasePos;
+smooth in vec2 fragOffset;
 flat in vec3 fragLightColor;
-
 out vec4 fragColor;
 
-// Filled in by app settings and/or TileRenderer
-layout (std140) uniform LightingParams
-{
-  vec3 ambientLight;
+// Tile shaders scale the light buffer back up by this, so lights can add up
+// past 1.0 without clamping; matches GL_LightRenderer.h
+const float LIGHT_BUFFER_RANGE = 4.0f;
+
+struct LightConstants {
+  float constantTerm;
+  float linearTerm;
+  float quadraticTerm;
 };
+// Lightmaps are baked with the same falloff (see GL_LightRenderer.cc).
+// See https://wiki.ogre3d.org/Light+Attenuation+Shortcut
+const LightConstants light = LightConstants(1.0f, 4.5f, 75.0f);
+
+float attenuate(float dist) {
+  return 1.0f / (light.constantTerm + light.linearTerm * dist + light.quadraticTerm * (dist * dist));
+}
 
 void main()
 {
-  float dist = 0.5f - length(fragPos - fragBasePos);
-  fragColor = vec4(fragLightColor.rg, dist, dist);
-  //fragColor = vec4(ambientLight, 0.8f);
+  // Fade out to nothing at the edge of the light's radius, rather than
+  // leaving a visible square
+  float edge = attenuate(1.0f);
+  float attenuation = max(attenuate(length(fragOffset)) - edge, 0.0f) / (1.0f - edge);
+  fragColor = vec4(fragLightColor * attenuation / LIGHT_BUFFER_RANGE, 1.0f);
 }
@@ -0,0 +1,4 @@
+{
+  "vertexShaderPath": "/assets/shaders/vertex/lightmap2d.vert",
+  "fragmentShaderPath": "/assets/shaders/fragment/lightmap2d.frag"
+}
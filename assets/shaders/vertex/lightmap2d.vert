@@ -0,0 +1,26 @@
+#version 300 es
+precision highp float;
+
+// Pixel position within the map, then texture coordinates; set once when
+// the lightmap is uploaded
+layout (location = 0) in vec4 vertCoords;
+// Where the map's top-left corner is, in pixels relative to the view center
+// with Y going down; a constant attribute set per draw by LightRenderer
+layout (location = 1) in vec2 mapOffset;
+
+smooth out vec2 fragTexCoord;
+
+// Filled in by LightRenderer, matching the app settings tile shaders get
+layout (std140) uniform ViewParams
+{
+  vec2 viewSize;
+  float scale;
+};
+
+void main()
+{
+  vec2 pixelPos = mapOffset + vertCoords.xy;
+  vec2 pixelScale = (2.0f * scale) / viewSize;
+  gl_Position = vec4(vec2(pixelPos.x, -pixelPos.y) * pixelScale, 0.0f, 1.0f);
+  fragTexCoord = vertCoords.zw;
+}
@@ -1,51 +1,32 @@
 #version 300 es
 precision highp float;
 
-layout (location = 0) in vec3 vertPos;
-layout (location = 1) in vec2 vertUv;
-layout (location = 2) in vec3 tilePos;
-layout (location = 3) in vec3 tileTuv;
+layout (location = 0) in vec2 vertCoords;
+layout (location = 1) in vec2 lightPos;
+layout (location = 2) in vec4 lightColor;
 
-smooth out vec3 fragPos;
-flat out vec3 fragBasePos;
+smooth out vec2 fragOffset;
 flat out vec3 fragLightColor;
 
-// Filled in by app settings and/or TileRenderer
+// Filled in by LightRenderer, matching the app settings tile shaders get
 layout (std140) uniform ViewParams
 {
   vec2 viewSize;
   float scale;
 };
 
-// Filled in by Tilesets
-layout (std140) uniform TilesetDetails
+// Filled in by LightRenderer
+layout (std140) uniform LightDetails
 {
-  vec2 tileSize;
-  vec2 tilesetSize;
-};
-
-// Filled in by Tilemaps
-layout (std140) uniform MapDetails
-{
-  vec2 mapPosition;
-  vec2 mapSize;
-  float mapDepthRange;
+  float lightRadius;
 };
 
 void main()
 {
+  // Light positions are relative to the view center, with Y going down
   vec2 pixelScale = (2.0f * scale) / viewSize;
-  vec3 normalizedVertPos = vec3((vertPos.xy + 1.0f) / 2.0f * pixelScale * tileSize, vertPos.z);
-  vec3 normalizedTilePos = vec3(tilePos.xy * pixelScale, tilePos.z / mapDepthRange);
-  vec3 normalizedMapPos = vec3(0.0f, -mapSize.y * pixelScale.y, 0.0f);
-  vec3 normalizedCameraPos = vec3(mapPosition * pixelScale, -0.5f);
-  fragBasePos = vec3(
-      normalizedVertPos * 4.0f
-    + normalizedTilePos
-    + normalizedMapPos
-    + normalizedCameraPos);
-  fragPos = fragBasePos;
-  gl_Position = vec4(fragPos, 1.0f);
-
-  fragLightColor = tileTuv / 255.0f;
+  vec2 center = vec2(lightPos.x, -lightPos.y) * pixelScale;
+  gl_Position = vec4(center + vertCoords * lightRadius * pixelScale, 0.0f, 1.0f);
+  fragOffset = vertCoords;
+  fragLightColor = lightColor.rgb;
 }
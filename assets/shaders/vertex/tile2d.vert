@@ -3,15 +3,15 @@ precision highp float;
 
 layout (location = 0) in vec3 vertCoords;
 layout (location = 1) in vec2 vertUv;
-layout (location = 2) in vec3 tilePos;
-layout (location = 3) in vec3 tileTuv;
+// Packed TileInstances: (x, y) in tiles and the tile index, then the sheet's
+// texture array layer and the flags
+layout (location = 2) in uvec3 tileCoords;
+layout (location = 3) in uvec2 tileLayerFlags;
 
-// Max number of lights allowed by the varying variables threshold
-const uint MAX_MAP_LIGHTS = 15u;
-const uint MAX_LIGHT_DETAILS = MAX_MAP_LIGHTS * 2u;
-flat out vec3 lightColors[MAX_MAP_LIGHTS];
-smooth out float lightDistances[MAX_MAP_LIGHTS];
-smooth out vec2 fragTexCoord;
+const uint TILE_ANIMATED = 0x80u;
+const uint TILE_DEPTH_MASK = 0x7Fu;
+
+smooth out vec3 fragTexCoord;
 
 // Filled in by app settings and/or TileRenderer
 layout (std140) uniform ViewParams
@@ -20,7 +20,7 @@ layout (std140) uniform ViewParams
   float scale;
 };
 
-// Filled in by Tilesets
+// Filled in by Tilemaps, with the size of their tileset texture array layers
 layout (std140) uniform TilesetDetails
 {
   vec2 tileSize;
@@ -33,9 +33,71 @@ layout (std140) uniform MapDetails
   vec2 mapPosition;
   float mapInverseSizeY;
   float mapDepthRange;
-  vec4 lightDetails[MAX_LIGHT_DETAILS];
 };
 
+// Filled in by Tilemaps, with the (columns, rows) of each tileset's tiles
+const uint MAX_TILESETS = 256u;
+layout (std140) uniform TilesetLayouts
+{
+  uvec4 tilesetLayouts[MAX_TILESETS];
+};
+
+// Filled in by Tilemaps with animated tiles. Each animation is a header of
+// (frame count, total duration), then each frame's (t, u, end time).
+const uint MAX_ANIMATION_VECS = 256u;
+layout (std140) uniform TileAnimations
+{
+  uvec4 tileAnimations[MAX_ANIMATION_VECS];
+};
+
+// Filled in by app settings: the 64-bit clock in milliseconds, split into
+// its low and high words so it never wraps
+layout (std140) uniform AnimationParams
+{
+  uvec2 animationTime;
+};
+
+// The clock modulo a loop length of at most 2^24 ms, a byte at a time so
+// nothing overflows 32 bits
+uint getLoopTime(uint duration) {
+  uint elapsed = 0u;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    elapsed = ((elapsed << 8) | ((animationTime.y >> shift) & 0xffu)) %
+              duration;
+  }
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    elapsed = ((elapsed << 8) | ((animationTime.x >> shift) & 0xffu)) %
+              duration;
+  }
+  return elapsed;
+}
+
+// Get the bottom-left corner of a tile in its sheet, in pixels
+vec2 getSheetCorner(uint tile, uint layer) {
+  uvec2 counts = tilesetLayouts[min(layer, MAX_TILESETS - 1u)].xy;
+  uint columns = max(counts.x, 1u);
+  uint lastRow = max(counts.y, 1u) - 1u;
+  uint row = lastRow - min(tile / columns, lastRow);
+  return vec2(uvec2(tile % columns, row)) * tileSize;
+}
+
+// Pick the sheet corner of a tile, or of an animated tile's current frame
+vec2 getTileCorner(uint tile, uint layer, uint flags) {
+  uint animation = tile;
+  if ((flags & TILE_ANIMATED) == 0u || animation == 0u ||
+      animation >= MAX_ANIMATION_VECS - 1u) {
+    return getSheetCorner(tile, layer);
+  }
+  uvec4 header = tileAnimations[animation];
+  uint elapsed = getLoopTime(max(header.y, 1u));
+  uint frame = animation + 1u;
+  uint lastFrame = min(animation + header.x, MAX_ANIMATION_VECS - 1u);
+  while (frame < lastFrame && elapsed >= tileAnimations[frame].z) {
+    ++frame;
+  }
+  return vec2(tileAnimations[frame].xy);
+}
+
 vec3 getNormalizedPos(vec3 vertPos, vec3 instancePos) {
   vec2 pixelScale = (2.0f * scale) / viewSize;
   vec3 normalizedVertPos = vec3((vertPos.xy + 1.0f) / 2.0f * pixelScale * tileSize, vertPos.z);
@@ -51,29 +113,13 @@ vec3 getNormalizedPos(vec3 vertPos, vec3 instancePos) {
 
 void main()
 {
-  vec3 actualPos = getNormalizedPos(vertCoords, tilePos);
+  // Each map layer is a map's height deep, and lower Y is in front within it
+  uint flags = tileLayerFlags.y;
+  vec2 tilePixels = vec2(tileCoords.xy) * tileSize;
+  float depth = float(flags & TILE_DEPTH_MASK) * -mapInverseSizeY + tilePixels.y;
+  vec3 actualPos = getNormalizedPos(vertCoords, vec3(tilePixels, depth));
   gl_Position = vec4(actualPos, 1.0f);
   vec2 tilesetScale = 1.0f / tilesetSize;
-  fragTexCoord = (tileTuv.xy * tilesetScale) + (vertUv * tilesetScale * tileSize);
-
-  // Convert light source positions into distances and pass them along
-  float lightAspect = (viewSize.x / viewSize.y);
-  uint light;
-  for (light = 0u; light < MAX_MAP_LIGHTS; ++light) {
-    uint idx = light * 2u;
-    vec4 lightColor = lightDetails[idx];
-    // An early end of the incoming list will be zeroed out
-    if (lightColor.a < 0.001f) {
-      // Flag the end of the outputs by zeroing out the color
-      lightColors[light] = vec3(0.0f, 0.0f, 0.0f);
-      break;
-    }
-    lightColors[light] = lightColor.rgb;
-
-    // Use just a single vertex (the bottom-left) for smooth rather than blocky lighting
-    // vec3 lightPos = getNormalizedPos(vertCoords, lightDetails[++idx].xyz);
-    vec3 lightPos = getNormalizedPos(vec3(-1.0f, -1.0f, 0.0f), lightDetails[++idx].xyz);
-    float lightDist = distance(vec2(actualPos.x * lightAspect, actualPos.y), vec2(lightPos.x * lightAspect, lightPos.y));
-    lightDistances[light] = lightDist / scale;
-  }
+  vec2 tileCorner = getTileCorner(tileCoords.z, tileLayerFlags.x, flags);
+  fragTexCoord = vec3((tileCorner * tilesetScale) + (vertUv * tilesetScale * tileSize), float(tileLayerFlags.x));
 }
@@ -0,0 +1,108 @@
+/****************************************************
+ * CookedFile.h: Binary resource layout for cooking *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+#pragma once
+
+#include <SDL3/SDL_rwops.h>
+
+#include "types.h"
+
+namespace renity {
+/** Make a four-character tag for a cooked file or section type. */
+constexpr Uint32 cookedTag(const char (&tag)[5]) {
+  return (Uint32)(Uint8)tag[0] | (Uint32)(Uint8)tag[1] << 8 |
+         (Uint32)(Uint8)tag[2] << 16 | (Uint32)(Uint8)tag[3] << 24;
+}
+
+/** Cooked file layout version; files from any other version are rejected. */
+constexpr Uint32 COOKED_VERSION = 9;
+
+/** Section holding the NUL-terminated strings that other sections refer to. */
+constexpr Uint32 COOKED_STRINGS = cookedTag("STRS");
+
+/** A resource file cooked ahead of time by renity-cook.
+ * Cooked files are a header, a section table, and then the sections, each
+ * aligned to 16 bytes so they can be used in-place from a memory-mapped file.
+ * Everything is in host byte order, so they aren't portable between hosts of
+ * different endianness; files from those are rejected.
+ */
+class RENITY_API CookedFile {
+ public:
+  CookedFile();
+  ~CookedFile();
+
+  /** Open a cooked file of the given type, if src is one.
+   * @param src A read-only, seekable SDL_RWops stream. If it's a valid cooked
+   * file, this takes ownership of it (using it in-place if it's mapped, or
+   * reading it all in otherwise). If not, it's rewound for the caller to read
+   * as usual.
+   * @param type The tag of the file type to expect, e.g. cookedTag("TMAP").
+   * @return True if src was a valid cooked file of that type.
+   */
+  bool open(SDL_RWops *src, Uint32 type);
+
+  /** Get a section's contents as an array of T.
+   * @return The section, or an empty Span if it doesn't exist.
+   */
+  template <typename T>
+  Span<const T> getSection(Uint32 tag) const {
+    size_t bytes = 0;
+    const T *data = (const T *)getSectionData(tag, &bytes);
+    return {data, data ? bytes / sizeof(T) : 0};
+  }
+
+  /** Get a string by its offset into the COOKED_STRINGS section.
+   * @return The string, or an empty one if the offset is out of range.
+   */
+  const char *getString(Uint32 offset) const;
+
+ private:
+  const void *getSectionData(Uint32 tag, size_t *bytesOut) const;
+  struct Impl;
+  Impl *pimpl_;
+};
+
+/** Builds cooked files; see CookedFile for the layout. */
+class RENITY_API CookedFileWriter {
+ public:
+  /** @param type The tag of the file type, e.g. cookedTag("TMAP"). */
+  explicit CookedFileWriter(Uint32 type = 0);
+  ~CookedFileWriter();
+
+  /** Set the tag of the file type, e.g. from a Resource's cook() function. */
+  void setType(Uint32 type);
+
+  /** Add a section, replacing any previous one with the same tag. */
+  void addSection(Uint32 tag, const void *data, size_t bytes);
+
+  template <typename T>
+  void addSection(Uint32 tag, const Vector<T> &items) {
+    addSection(tag, items.data(), sizeof(T) * items.size());
+  }
+
+  /** Add a string to the COOKED_STRINGS section.
+   * @return Its offset, for getString(). Repeated strings share an offset.
+   */
+  Uint32 addString(const char *str);
+
+  /** Lay out the file, including the COOKED_STRINGS section.
+   * @param out Where to store the file contents.
+   */
+  void serialize(Vector<Uint8> &out) const;
+
+  /** Save the file to a PhysFS path.
+   * @return True if the whole file was written, false otherwise.
+   */
+  bool save(const char *destPath) const;
+
+ private:
+  struct Impl;
+  Impl *pimpl_;
+};
+}  // namespace renity
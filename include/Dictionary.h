@@ -10,6 +10,7 @@
 #pragma once
 
 #include "3rdparty/duktape/duktape.h"
+#include "DictionaryPath.h"
 #include "Resource.h"
 #include "types.h"
 
@@ -22,6 +23,37 @@ class RENITY_API Dictionary : public Resource {
 
   void load(SDL_RWops *src);
 
+  size_t getCpuBytes() const;
+
+  /** Choose how future loads decode their files.
+   * Natively-decoded Dictionaries read from a compact read-only tree, and only
+   * convert to a Duktape heap once something modifies or scripts them.
+   * @param enable Whether to decode natively (the default), rather than
+   * decoding everything with Duktape.
+   */
+  static void setNativeDecoding(bool enable);
+
+  /** Memory usage of a Dictionary's Duktape heap. */
+  struct HeapStats {
+    size_t bytesInUse;   // Allocated now, including Duktape's builtins
+    size_t peakBytes;    // Most allocated at once since the Dictionary got it
+    Uint64 allocations;  // Allocations made since the Dictionary got it
+  };
+
+  /** Get the memory usage of the Duktape heap.
+   * @return All zeroes if there is no heap yet, e.g. when natively decoded and
+   * not yet modified.
+   */
+  HeapStats getHeapStats() const;
+
+  /** Limit how much memory the Duktape heap may use.
+   * Allocations past the limit fail, which scripts see as out-of-memory
+   * errors. Intended for ScriptContexts, since scripts run in protected calls
+   * but other Dictionary methods don't.
+   * @param maxBytes The limit in bytes, or 0 (the default) for none.
+   */
+  void setHeapLimit(size_t maxBytes);
+
   /** Save Dictionary contents to a file.
    * @param destPath Destination PhysFS path. File extension will determine what
    * format it saves in, defaulting to CBOR for ones it doesn't recognize.
@@ -49,6 +81,29 @@ class RENITY_API Dictionary : public Resource {
    */
   bool saveCBOR(const char *destPath, bool selectionOnly = false);
 
+  /** Save Dictionary contents to a file from a background thread.
+   * The contents are encoded right away (in the same format save() would use),
+   * but written later, so this never waits on the disk. Saving the same path
+   * again before the write starts replaces the pending contents, and files are
+   * replaced atomically, so readers never see a partly-written one.
+   * @param destPath Destination PhysFS path, relative to the write dir.
+   * @param selectionOnly Whether to save just the current selection, or the
+   * entire Dictionary.
+   * @return True if the contents were encoded and queued, false otherwise.
+   * Write errors are only logged.
+   */
+  bool saveAsync(const char *destPath, bool selectionOnly = false);
+
+  /** Wait for every saveAsync() write to finish.
+   * Application does this on exit, before shutting PhysFS down.
+   */
+  static void flushSaves();
+
+  /** Get the number of files saveAsync() has written so far.
+   * Saves replaced by a later one before they were written aren't counted.
+   */
+  static Uint64 getSavesWritten();
+
   /** Select a relative path into the Dictionary.
    * Further operations, e.g. get() and put(), will use this as a prefix.
    * @param path Selection path, relative to the current selection.
@@ -60,6 +115,13 @@ class RENITY_API Dictionary : public Resource {
     return select(path, autoCreate, true);
   }
 
+  /** Select a pre-split relative path into the Dictionary.
+   * @see select(const char *, bool)
+   */
+  inline size_t select(const DictionaryPath &path, bool autoCreate = false) {
+    return select(path, autoCreate, true);
+  }
+
   /** Select a numerical index from the current path.
    * Further operations, e.g. get() and put(), will use this as a prefix.
    * @param index Selection path, relative to the current selection.
@@ -121,6 +183,12 @@ class RENITY_API Dictionary : public Resource {
   template <typename T>
   bool get(const char *key, T *valOut);
 
+  /** Get a Property value of the given type at a pre-split path.
+   * @see get(const char *, T *)
+   */
+  template <typename T>
+  bool get(const DictionaryPath &path, T *valOut);
+
   /** Get an index value of the given type if it exists.
    * @param index An index into the currently-selected path to get the value of.
    * @param valOut Where to store the value, if found. Can be a nullptr.
@@ -129,6 +197,28 @@ class RENITY_API Dictionary : public Resource {
   template <typename T>
   bool getIndex(Uint32 index, T *valOut);
 
+  /** Get a whole numeric array of the given type in one pass.
+   * @param path The array to get, which may also be a byte string or CBOR
+   * typed array. Can be a nullptr to use the currently-selected path.
+   * @param valsOut Where to store the values, or cleared if path is not an
+   * array. Any elements that are not numbers are stored as 0.
+   * @return True if the array exists, false otherwise.
+   */
+  template <typename T>
+  bool getArray(const char *path, Vector<T> &valsOut);
+
+  /** Get a view of a whole numeric array of the given type.
+   * CBOR typed arrays with matching elements are viewed in-place; anything else
+   * is copied into scratch with getArray() first.
+   * @param path The array to get.
+   * Can be a nullptr to use the currently-selected path.
+   * @param scratch Storage to use for arrays that need converting.
+   * @return A view of the values, valid until the Dictionary is modified or
+   * reloaded, or until scratch changes. Empty if path is not an array.
+   */
+  template <typename T>
+  Span<const T> getArraySpan(const char *path, Vector<T> &scratch);
+
   /** Create an array at a given path.
    * @param key The key to store the array under.
    * @return True if the array was able to be stored (or the path was already an
@@ -165,6 +255,12 @@ class RENITY_API Dictionary : public Resource {
   template <typename T>
   bool put(const char *key, T val);
 
+  /** Store a Property value of the given type at a pre-split path.
+   * @see put(const char *, T)
+   */
+  template <typename T>
+  bool put(const DictionaryPath &path, T val);
+
   /** Store an index value of the given type.
    * @param index An index into the currently-selected path to set the value of.
    * @param val The value to store. Will overwrite a previous value of any type.
@@ -202,8 +298,11 @@ class RENITY_API Dictionary : public Resource {
   }
 
  protected:
+  bool prepareLoad(SDL_RWops *src);
+  void finishLoad();
   duk_context *getContext();
   size_t select(const char *path, bool autoCreate, bool loadValue);
+  size_t select(const DictionaryPath &path, bool autoCreate, bool loadValue);
 
  private:
   struct Impl;
@@ -0,0 +1,48 @@
+/****************************************************
+ * DictionaryPath.h: Pre-split Dictionary keys      *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+#pragma once
+
+#include "types.h"
+
+namespace renity {
+/** A dotted Dictionary key path, split into interned segments up front.
+ * Selecting by DictionaryPath skips re-splitting and copying the path on every
+ * lookup, so keys that loaders use for every file can be declared once, e.g.
+ * as statics.
+ */
+class RENITY_API DictionaryPath {
+ public:
+  /** One key along the path. */
+  struct Segment {
+    const char *key;  // Interned, so it lives as long as the program
+    Uint32 length;
+    Uint32 index;  // The key as an array index, if isIndex
+    bool isIndex;
+  };
+
+  /** Split a path such as "layers.0.data".
+   * @param path The path to split. Paths with empty segments are invalid, and
+   * end up with no segments.
+   */
+  explicit DictionaryPath(const char *path);
+
+  /** Get the original path, e.g. for logging. */
+  const char *c_str() const { return path_.c_str(); }
+
+  /** Get the number of segments; 0 if the path is invalid. */
+  size_t size() const { return segments_.size(); }
+
+  const Segment &operator[](size_t index) const { return segments_[index]; }
+
+ private:
+  String path_;
+  Vector<Segment> segments_;
+};
+}  // namespace renity
@@ -0,0 +1,127 @@
+/****************************************************
+ * GL_LightRenderer.h: GL 2D light accumulation     *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+#pragma once
+
+#include "Dimension2D.h"
+#include "Point2D.h"
+#include "Rect2D.h"
+#include "ResourcePath.h"
+#include "types.h"
+
+namespace renity {
+constexpr ResourcePath LIGHT_SHADER_PATH("/assets/shaders/pointlight2d.shader");
+constexpr ResourcePath LIGHTMAP_SHADER_PATH(
+    "/assets/shaders/lightmap2d.shader");
+// Texture unit that tile shaders sample the light buffer from
+constexpr Uint32 LIGHT_TEXTURE_UNIT = 1;
+// How far every light reaches, in world pixels
+constexpr float LIGHT_RADIUS = 256.0f;
+// Light buffer values are scaled down by this, so lights can add up past 1.0
+constexpr float LIGHT_BUFFER_RANGE = 4.0f;
+// Width and height of each lightmap texel, in world pixels
+constexpr Sint32 LIGHTMAP_TEXEL_PIXELS = 8;
+
+struct LightInstance {
+  float x, y;        // Center, in pixels right of and below the view's center
+  Uint8 r, g, b, a;  // Color; alpha is unused
+};
+
+/** Static lights baked into a low-resolution image. */
+struct LightmapImage {
+  Rect2Di32 bounds;      // Area covered, in pixels
+  Dimension2Du32 size;   // In texels
+  // RGB10_A2 like the light buffer and scaled the same way, red in the low
+  // bits, top row first
+  Vector<Uint32> texels;
+};
+
+/** Static lights baked into a low-resolution texture.
+ * Drawing one costs a texture read per pixel it covers, no matter how many
+ * lights went into it, rather than working out each light's falloff.
+ */
+class RENITY_API GL_Lightmap {
+ public:
+  GL_Lightmap();
+  ~GL_Lightmap();
+  GL_Lightmap(const GL_Lightmap&) = delete;
+  GL_Lightmap& operator=(const GL_Lightmap&) = delete;
+
+  /** Bake lights into an image, with the same falloff as drawing them.
+   * Doesn't touch GL, so it can be done while loading or cooking.
+   * \param lights The lights to bake, positioned in pixels from the top-left
+   * corner of an area.
+   * \param areaSize The size of the area in pixels. The image also covers
+   * LIGHT_RADIUS around it, so lights near the edges reach past them.
+   * \param imageOut Where to store the image, or an empty one if there are no
+   * lights.
+   */
+  static void bake(Span<const LightInstance> lights,
+                   const Dimension2Du32& areaSize, LightmapImage& imageOut);
+
+  /** Replace the texture contents, and the quad it's drawn with.
+   * The quad covers the image's bounds, so it only needs drawing at the
+   * map's offset. Changes the currently-bound texture, VAO, and VBO and does
+   * not restore them.
+   * \param image The image to upload.
+   */
+  void upload(const LightmapImage& image);
+
+  /** Get the area the lightmap covers, as given by its image. */
+  Rect2Di32 getBounds() const;
+
+  /** Get the size of the texture and quad in GPU memory. */
+  size_t getGpuBytes() const;
+
+ private:
+  friend class GL_LightRenderer;
+  struct Impl;
+  Impl* pimpl_;
+};
+
+struct LightmapInstance {
+  const GL_Lightmap* lightmap;
+  Point2Di32 offset;  // Of its map's top-left, in pixels from the view center
+};
+
+/** Accumulates lightmaps and point lights into a window-sized light buffer.
+ * Lightmaps hold static lights, and point lights are for dynamic ones. Each
+ * light is drawn as a quad covering only the pixels it reaches, blended
+ * additively, so the cost follows how much of the screen is lit rather than
+ * how many lights there are. Tile shaders then sample the buffer once per
+ * pixel instead of looping over lights.
+ */
+class RENITY_API GL_LightRenderer {
+ public:
+  GL_LightRenderer();
+  ~GL_LightRenderer();
+  GL_LightRenderer(const GL_LightRenderer&) = delete;
+  GL_LightRenderer& operator=(const GL_LightRenderer&) = delete;
+
+  /** Replace the light buffer contents, and bind it for tile shaders.
+   * The buffer is resized to match the window as needed. Changes the
+   * currently-bound VAO/VBOs and textures and does not restore them; the
+   * framebuffer, clear color, and active texture unit are restored.
+   * \param lightmaps The lightmaps to draw. Any outside the view should be
+   * left out.
+   * \param lights The point lights to draw. Any beyond the view plus
+   * LIGHT_RADIUS can't reach it, so should be left out.
+   * \param scale The view scale, as given to the tile shader's ViewParams.
+   */
+  void draw(Span<const LightmapInstance> lightmaps,
+            Span<const LightInstance> lights, float scale);
+
+  /** Get the size of the light buffer in GPU memory. */
+  size_t getGpuBytes() const;
+
+ private:
+  struct Impl;
+  Impl* pimpl_;
+};
+}  // namespace renity
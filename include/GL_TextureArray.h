@@ -0,0 +1,58 @@
+/****************************************************
+ * GL_TextureArray.h: Packed GL 2D texture arrays   *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+#pragma once
+
+#include "Dimension2D.h"
+#include "resources/GL_Texture2D.h"
+#include "types.h"
+
+namespace renity {
+/** Several textures packed into the layers of one GL_TEXTURE_2D_ARRAY.
+ * Shaders pick a layer per-vertex, so things drawn from different textures,
+ * e.g. the tiles of a map's tilesets, can go out in the same draw call.
+ */
+class RENITY_API GL_TextureArray {
+ public:
+  GL_TextureArray();
+  ~GL_TextureArray();
+  GL_TextureArray(const GL_TextureArray&) = delete;
+  GL_TextureArray& operator=(const GL_TextureArray&) = delete;
+
+  /** Copy textures into the layers of the array, replacing its contents.
+   * The copies happen on the GPU. Layers are as big as the biggest texture,
+   * and smaller ones sit at the bottom-left, so their pixel coordinates stay
+   * the same. Changes the currently-bound texture and does not restore it,
+   * but does restore the read framebuffer.
+   * \param textures The textures to pack, in layer order. Empty pointers
+   * leave their layers blank.
+   * \returns True on success, false if there are more textures than the GL
+   * implementation allows layers.
+   */
+  bool pack(const Vector<GL_Texture2DPtr>& textures);
+
+  /** Make this the active texture for the current GL context. */
+  void use();
+
+  /** Get the size of each layer.
+   * \returns A Dimension2D containing the layer size in pixels, or (0, 0) if
+   * nothing has been packed.
+   */
+  Dimension2Du32 getSize() const;
+
+  /** Get the number of layers. */
+  Uint32 getLayerCount() const;
+
+  size_t getGpuBytes() const;
+
+ private:
+  struct Impl;
+  Impl* pimpl_;
+};
+}  // namespace renity
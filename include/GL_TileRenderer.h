@@ -9,15 +9,57 @@
  ***************************************************/
 #pragma once
 
+#include "ResourcePath.h"
 #include "resources/GL_ShaderProgram.h"
 #include "types.h"
 
 namespace renity {
+constexpr ResourcePath TILE_SHADER_PATH("/assets/shaders/tile2d.shader");
+
+// TileInstance flag marking tiles whose index is into TileAnimations
+constexpr Uint8 TILE_ANIMATED = 0x80;
+// TileInstance flag bits holding the map layer the tile is on
+constexpr Uint8 TILE_DEPTH_MASK = 0x7F;
+
+/** A tile packed into 8 bytes, read by the shader as integers.
+ * The shader works out the pixel position, depth, and sheet corner from the
+ * map's shader blocks, so none of them need storing per-tile.
+ */
 struct TileInstance {
-  Uint32 x, y, z;
-  Uint32 t, u, v;
+  Uint16 x, y;  // Position in the map, in tiles from its bottom-left corner
+  Uint16 tile;  // Index into its tileset, or into TileAnimations if animated
+  Uint8 layer;  // Texture array layer of its tileset's sheet
+  Uint8 flags;  // Map layer (lowest is in front) and TILE_ANIMATED
+};
+
+/** A list of tile instances kept resident on the GPU.
+ * For tiles that rarely change, e.g. map layers, so they're uploaded once
+ * rather than on every draw.
+ */
+class RENITY_API GL_TileBuffer {
+ public:
+  GL_TileBuffer();
+  ~GL_TileBuffer();
+  GL_TileBuffer(const GL_TileBuffer&) = delete;
+  GL_TileBuffer& operator=(const GL_TileBuffer&) = delete;
+
+  /** Replace the buffer contents.
+   * Changes the currently-bound VBO and does not restore it.
+   * \param tiles The tiles to upload.
+   */
+  void upload(Span<const TileInstance> tiles);
+
+  /** Get the number of tiles in the buffer. */
+  Uint32 size() const;
+
+  /** Get the size of the buffer in GPU memory. */
+  size_t getGpuBytes() const;
+
+ private:
+  friend class GL_TileRenderer;
+  struct Impl;
+  Impl* pimpl_;
 };
-using LightInstance = TileInstance;
 
 class RENITY_API GL_TileRenderer {
  public:
@@ -38,6 +80,22 @@ class RENITY_API GL_TileRenderer {
    */
   void draw(const Vector<TileInstance>& tiles);
 
+  /** Draw a range of tiles using the current texture, e.g. part of a list.
+   * \see draw(const Vector<TileInstance>&)
+   */
+  void draw(Span<const TileInstance> tiles);
+
+  /** Draw a range of tiles from a GPU-resident buffer.
+   * Changes the currently-bound VAO/VBOs and does not restore them.
+   * \param buffer The buffer to draw from.
+   * \param first The index of the first tile to draw.
+   * \param count How many tiles to draw, clipped to the end of the buffer.
+   * \param opaque Whether every tile in the range is fully opaque, so they can
+   * skip blending.
+   */
+  void draw(const GL_TileBuffer& buffer, Uint32 first = 0,
+            Uint32 count = UINT32_MAX, bool opaque = false);
+
  private:
   struct Impl;
   Impl* pimpl_;
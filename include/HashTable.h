@@ -67,6 +67,52 @@ class HashTable {
   unordered_map<Id, Val> map;
 };
 
+/** Hash table keyed by precomputed 64-bit ids, e.g. PathIds. Keys are used
+ * as-is, so lookups don't hash (or copy) anything, and aren't truncated to a
+ * 32-bit Id like HashTable's.
+ */
+template <typename Val>
+class IdHashTable {
+ public:
+  /** Check if an item exists in the table */
+  bool exists(Uint64 id) const { return map.find(id) != map.end(); }
+
+  /** Get an item from the table, constructing a new one if it doesn't exist. */
+  Val &get(Uint64 id) { return map[id]; }
+
+  /** Get an existing item without modifying the table, e.g. from a reader.
+   * @return A pointer to the item, or nullptr if it doesn't exist.
+   */
+  const Val *find(Uint64 id) const {
+    auto it = map.find(id);
+    return it != map.end() ? &it->second : nullptr;
+  }
+
+  /** Insert or overwrite an item in the table. */
+  void put(Uint64 id, Val v) { map[id] = v; }
+
+  /** Enumerate all values in the table using a callback.
+   * The callback should return true to keep going, or false to stop.
+   */
+  void enumerate(const FuncPtr<bool(const Val &)> &callback) const {
+    for (auto &it : map) {
+      if (!callback(it.second)) return;
+    }
+  }
+
+  /** Remove an item from the table. */
+  void erase(Uint64 id) { map.erase(id); }
+
+  /** Remove *all* items from the table. */
+  void clear() { map.clear(); }
+
+ private:
+  struct IdentityHash {
+    size_t operator()(Uint64 id) const { return (size_t)id; }
+  };
+  unordered_map<Uint64, Val, IdentityHash> map;
+};
+
 /** Dual-key hash table that currently just mashes two Id's together. */
 template <typename KeyA, typename KeyB, typename Val>
 class DualHashTable {
@@ -9,6 +9,7 @@
  ***************************************************/
 #pragma once
 
+#include <SDL3/SDL_atomic.h>
 #include <SDL3/SDL_rwops.h>
 
 #include "types.h"
@@ -18,9 +19,15 @@ class ResourceManager;
 
 typedef void (*ResourceLoadCallback)(void *userdata);
 
+/** A Resource file path, along with the name of the type to load it as. */
+struct ResourceRef {
+  String path;
+  String type;
+};
+
 class RENITY_API Resource {
  public:
-  Resource() : cb_(nullptr), userdata_(nullptr){};
+  Resource() : subscribersLock_(0), pending_(0){};
   virtual ~Resource(){};
 
   /* TODO: Someday it may make sense to allow copying/moving Resource
@@ -31,26 +38,106 @@ class RENITY_API Resource {
   Resource &operator=(Resource &other) = delete;
   Resource &operator=(const Resource &other) = delete;
 
-  /** Set a callback to use after ResourceManager reloads a loaded Resource. */
-  inline void setReloadCallback(const ResourceLoadCallback &cb,
-                                void *userdata = nullptr) {
-    cb_ = cb;
-    userdata_ = userdata;
+  /** Add a callback to run after ResourceManager (re)loads this Resource.
+   * That includes reloads caused by a dependency changing, e.g. a Tilemap's
+   * tileset image. Adding the same callback and userdata again does nothing.
+   * Safe to call from any thread, e.g. while loading on a worker; callbacks
+   * still only run on the thread that owns the ResourceManager.
+   */
+  void addReloadCallback(ResourceLoadCallback cb, void *userdata = nullptr) {
+    SDL_AtomicLock(&subscribersLock_);
+    bool known = false;
+    for (auto &sub : subscribers_) {
+      known = known || (sub.cb == cb && sub.userdata == userdata);
+    }
+    if (!known) subscribers_.push_back({cb, userdata});
+    SDL_AtomicUnlock(&subscribersLock_);
+  }
+
+  /** Remove a callback added with addReloadCallback(), from any thread.
+   * A callback removed while reload callbacks are running may still run once.
+   */
+  void removeReloadCallback(ResourceLoadCallback cb, void *userdata = nullptr) {
+    SDL_AtomicLock(&subscribersLock_);
+    for (auto it = subscribers_.begin(); it != subscribers_.end(); ++it) {
+      if (it->cb == cb && it->userdata == userdata) {
+        subscribers_.erase(it);
+        break;
+      }
+    }
+    SDL_AtomicUnlock(&subscribersLock_);
   }
 
+  /** Whether the Resource is still waiting on a background load.
+   * Pending Resources are usable, but hold placeholder (default) contents.
+   */
+  inline bool isPending() const { return pending_ != 0; }
+
+  /** Get the approximate system memory held by this Resource, in bytes.
+   * ResourceManager uses this (with getGpuBytes) to budget its retained cache.
+   */
+  virtual size_t getCpuBytes() const { return 0; }
+
+  /** Get the approximate GPU memory held by this Resource, in bytes. */
+  virtual size_t getGpuBytes() const { return 0; }
+
  protected:
   friend class ResourceManager;
-  ResourceLoadCallback cb_;
-  void *userdata_;
+  struct ReloadSubscriber {
+    ResourceLoadCallback cb;
+    void *userdata;
+  };
+  Vector<ReloadSubscriber> subscribers_;
+  SDL_SpinLock subscribersLock_;  // Held only to copy or change subscribers_
+  AtomicFlag8 pending_;
+
+  // Run every reload callback; a callback may add or remove callbacks, since
+  // they run from a copy taken under the lock
+  void runReloadCallbacks() {
+    SDL_AtomicLock(&subscribersLock_);
+    Vector<ReloadSubscriber> subs = subscribers_;
+    SDL_AtomicUnlock(&subscribersLock_);
+    for (auto &sub : subs) sub.cb(sub.userdata);
+  }
 
   /** Load the resource from an SDL_RWops stream.
    * Derived classes should start in a usable, empty state on construction.
    * This function then may (or may not) be called at any time to signal e.g. a
-   * replaced or deleted file. ResourceManager will automatically run cb_ after.
+   * replaced or deleted file, or a reloaded dependency. ResourceManager will
+   * automatically run the reload callbacks after.
    * @param src A read-only SDL_RWops stream. If NULL, a derived class should
    * clean up as needed and switch to a default state (such as a blank texture).
    */
   virtual void load(SDL_RWops *src) = 0;
+
+  /** Do the thread-safe part of a background load, e.g. parsing or decoding.
+   * Called on a ResourceManager worker thread; implementations must not touch
+   * shared state such as the GL context or the ResourceManager itself, and
+   * should stage their results privately until finishLoad().
+   * @param src A read-only SDL_RWops stream, owned by the callee.
+   * @return True if src was consumed and finishLoad() should be called, or
+   * false (the default) to have ResourceManager buffer the file for load().
+   */
+  virtual bool prepareLoad(SDL_RWops *src) {
+    (void)(src);
+    return false;
+  }
+
+  /** Apply results staged by prepareLoad(), on the thread running update(). */
+  virtual void finishLoad() {}
+
+  /** List the other Resources that finishLoad() will request.
+   * Called between prepareLoad() and finishLoad(), so ResourceManager can load
+   * dependencies in parallel and finish them first.
+   * @param deps Vector to append dependency paths and type names to.
+   */
+  virtual void getDependencies(Vector<ResourceRef> &deps) { (void)(deps); }
+
+  /** Whether loading touches the GL context, e.g. to upload a texture.
+   * ResourceManager only finishes loading these on its owning thread; other
+   * threads that request one prepare it if need be, then wait for update().
+   */
+  virtual bool needsGpuContext() const { return false; }
 };
 using ResourcePtr = SharedPtr<Resource>;
 }  // namespace renity
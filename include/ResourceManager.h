@@ -12,9 +12,53 @@
 #include <SDL3/SDL_rwops.h>
 
 #include "Resource.h"
+#include "ResourcePath.h"
 #include "types.h"
 
 namespace renity {
+using ResourceFactory = Resource *(*)();
+
+/** Timings and sizes from the most recent load of a Resource.
+ * Phase times are exclusive of any nested loads (e.g. a map's tilesets).
+ */
+struct ResourceLoadStats {
+  String path;
+  Uint64 openNS;       // Opening the file
+  Uint64 readNS;       // Reading data from the file
+  Uint64 parseNS;      // Decoding the data (and uploading, if not staged)
+  Uint64 uploadNS;     // Applying staged data, e.g. uploading it to the GPU
+  Uint64 bytesRead;    // Bytes read from the file
+  Uint32 reloadCount;  // Number of loads after the first
+  long refCount;       // Current strong references, including the cache's
+  size_t cpuBytes;     // Current system memory use, as reported by getCpuBytes
+  size_t gpuBytes;     // Current GPU memory use, as reported by getGpuBytes
+};
+
+/** Background loading progress, e.g. for a loading screen. */
+struct ResourceLoadProgress {
+  Uint32 queued;    // Background loads started since the queue was last empty
+  Uint32 finished;  // How many of those have finished loading
+};
+
+/** Resource cache counters, e.g. for tuning the retention budget. */
+struct ResourceCacheStats {
+  Uint64 hits;           // Requests served by an already-loaded Resource
+  Uint64 misses;         // Requests that had to create a Resource
+  Uint64 evictions;      // Unused Resources released to stay within budget
+  Uint32 retainedCount;  // Resources currently kept alive only by the cache
+  size_t retainedBytes;  // CPU + GPU bytes held by those Resources
+};
+
+/** Loads Resources and caches them by path.
+ * get() and getAsync() may be called from any thread; concurrent requests for
+ * the same path share a single load. Everything else, including update() and
+ * clear(), belongs on the thread that created the ResourceManager, which should
+ * also own the GL context: Resources that upload to the GPU only finish loading
+ * there. Other threads requesting one read and decode it, then wait for the
+ * next update() to finish it, so that thread must keep calling update() while
+ * they wait. Resources the cache lets go of are destroyed there too, during
+ * update().
+ */
 class RENITY_API ResourceManager {
  public:
   ResourceManager();
@@ -32,16 +76,123 @@ class RENITY_API ResourceManager {
    * Keeps it in a context-specific cache.
    * @param path Filename to read, in platform-independent notation,
    * or a name in <angle brackets> to generate a cached in-memory Resource.
+   * Hot lookups can pass a static constexpr ResourcePath to skip hashing.
    * @return A Resource representing a file's data, or default data if there was
    * an error or a request to generate a temporary Resource.
    */
   template <typename T>
-  SharedPtr<T> get(const char *path) {
+  SharedPtr<T> get(const ResourcePath &path) {
     requireBaseOf<Resource, T>();
     SharedPtr<Resource> res = getOrCreate(path, &createResource<T>);
     return dynamicPointerCast<T>(res);
   }
 
+  /** Get a Resource like get(), but read and decode its file in the background.
+   * The Resource is returned right away in its default state, as a placeholder
+   * (e.g. a blank texture), and gets filled in by a later update() call - which
+   * then runs its reload callback. Calling get() on a pending Resource finishes
+   * loading it immediately instead, or waits for it if another thread is (or,
+   * off the owning thread, if the Resource needs the GL context).
+   * @param path Filename to read, in platform-independent notation.
+   * @return A Resource that will represent the file's data once loaded.
+   */
+  template <typename T>
+  SharedPtr<T> getAsync(const ResourcePath &path) {
+    requireBaseOf<Resource, T>();
+    SharedPtr<Resource> res = getOrCreateAsync(path, &createResource<T>);
+    return dynamicPointerCast<T>(res);
+  }
+
+  /** Get a Resource like getAsync(), using a type name from registerType().
+   * @param path Filename to read, in platform-independent notation.
+   * @param typeName Registered type name, or nullptr to pick a type based on
+   * the file extension.
+   * @return A pending Resource, or nullptr if the type is unknown.
+   */
+  SharedPtr<Resource> getAsync(const char *path, const char *typeName);
+
+  /** Start loading a list of Resources in the background.
+   * Dependencies (e.g. a world's maps, their tilesets, and those tilesets'
+   * images) are found as each Resource is parsed, and loaded in parallel too.
+   * Use getLoadProgress() to track completion, and keep the returned Resources
+   * (or rely on the retention budget) until they're needed.
+   * @param refs Paths and registered type names; empty types use extensions.
+   * @return The Resources that were found or queued.
+   */
+  Vector<ResourcePtr> preload(const Vector<ResourceRef> &refs);
+
+  /** Start loading the Resources listed in a manifest file in the background.
+   * A manifest is a JSON or CBOR object with a "resources" array, where each
+   * entry is either a path string or a {"path": ..., "type": ...} object.
+   * The manifest itself is loaded right away, and cached like any Dictionary.
+   * @param manifestPath PhysFS path of the manifest.
+   * @return The Resources that were found or queued.
+   */
+  Vector<ResourcePtr> preload(const char *manifestPath);
+
+  /** Reload a Resource from its file during the next update().
+   * Everything that requested it while loading (directly or indirectly) gets
+   * reloaded after it, e.g. a tileset's maps when its image changes. Debug
+   * builds do this automatically when files change on disk.
+   * @param path Path of a loaded Resource; others are ignored.
+   */
+  void reload(const ResourcePath &path);
+
+  /** Stop retaining a Resource, e.g. one its user knows it's done with.
+   * It stays cached while referenced elsewhere, but is freed (during the next
+   * update()) once it isn't, rather than lingering within the retention budget.
+   * @param path Path of a loaded Resource; others are ignored.
+   */
+  void release(const ResourcePath &path);
+
+  /** Get the paths of Resources that requested a given one while loading. */
+  Vector<String> getDependents(const ResourcePath &path) const;
+
+  /** Get the progress of background loading. */
+  ResourceLoadProgress getLoadProgress() const;
+
+  /** Register a Resource type name for manifests and getAsync(path, type).
+   * Built-in Resource types are registered under their class names.
+   * @param typeName Name to register the type under.
+   * @param extensions Lowercase file extensions (including the dot) to load as
+   * this type when no type name is given, e.g. {".tmj"}.
+   */
+  template <typename T>
+  static void registerType(const char *typeName,
+                           const Vector<String> &extensions = {}) {
+    requireBaseOf<Resource, T>();
+    registerFactory(typeName, &createResource<T>, extensions);
+  }
+
+  /** Set how much time update() may spend finishing background loads.
+   * At least one finished load is applied per update() regardless, so loading
+   * always makes progress.
+   * @param budgetNS Time budget per update() in nanoseconds. Default is 4ms.
+   */
+  void setLoadBudget(Uint64 budgetNS);
+
+  /** Set how much memory unused Resources may keep occupied.
+   * Resources stay cached after their last outside reference is dropped, so a
+   * later get() can reuse them without reloading; once the total CPU + GPU size
+   * of those exceeds the budget, update() releases the least-recently-requested
+   * ones. Sizes are measured as each Resource finishes (re)loading.
+   * @param budgetBytes Retention budget in bytes. 0 disables retention.
+   * Default is 64MB.
+   */
+  void setRetentionBudget(size_t budgetBytes);
+
+  /** Get the current cache statistics. */
+  ResourceCacheStats getCacheStats() const;
+
+  /** Get load statistics for every Resource loaded since the last clear(). */
+  Vector<ResourceLoadStats> getLoadStats() const;
+
+  /** Save load statistics for every Resource loaded since the last clear().
+   * @param destPath Destination PhysFS path, always written as JSON.
+   * @return True if the operation succeeded, false otherwise.
+   */
+  bool saveLoadStats(const char *destPath) const;
+
   /** Get the active (current) ResourceManager.
    * \returns A pointer to the last-activated ResourceManager, or null if none
    * are valid.
@@ -51,11 +202,16 @@ class RENITY_API ResourceManager {
   /** Activate this ResourceManager.
    * Makes it the "current" manager for any subsequent resource operations.
    * This is useful for e.g. GL_Shaders, which are Window-specific.
+   * In debug builds, it also starts watching for changed files; from then on,
+   * files are read into memory rather than mapped, so they can be rewritten
+   * safely while a load still holds them.
    */
   void activate();
 
   /** Update the ResourceManager.
-   * Reloads any cached resources which have changed on disk.
+   * Finishes background loads (up to the load budget), reloads any cached
+   * resources which have changed on disk (or were passed to reload()) along
+   * with their dependents, and trims the retained cache.
    * Rendering threads should use this to reload Window-specific resources.
    */
   void update();
@@ -67,14 +223,13 @@ class RENITY_API ResourceManager {
 
  protected:
   template <typename T>
-  static Resource *createResource(SDL_RWops *ops) {
-    // Should return a default resource if the file was not opened successfully.
-    T *res = new T();
-    res->load(ops);
-    return res;
-  }
-  SharedPtr<Resource> getOrCreate(const char *path,
-                                  Resource *(*factory)(SDL_RWops *));
+  static Resource *createResource() { return new T(); }
+  SharedPtr<Resource> getOrCreate(const ResourcePath &path,
+                                  ResourceFactory factory);
+  SharedPtr<Resource> getOrCreateAsync(const ResourcePath &path,
+                                       ResourceFactory factory);
+  static void registerFactory(const char *typeName, ResourceFactory factory,
+                              const Vector<String> &extensions);
 
  private:
   struct Impl;
@@ -0,0 +1,53 @@
+/****************************************************
+ * ResourcePath.h: Prehashed resource path handles  *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+#pragma once
+
+#include "types.h"
+
+namespace renity {
+/** Hash a path into a 64-bit PathId (FNV-1a), at compile time if possible.
+ * @param path Path to hash. A nullptr hashes to 0.
+ */
+constexpr PathId hashPath(const char *path) {
+  if (!path) return 0;
+  PathId hash = 0xcbf29ce484222325ULL;
+  for (; *path; ++path) {
+    hash ^= (Uint8)(*path);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/** A resource path paired with its precomputed PathId.
+ * Lookups by ResourcePath don't need to copy or rehash the path, so
+ * frequently-requested paths can be declared once as static constexpr
+ * handles. Handles only point to their strings, which must outlive them -
+ * string literals do, and intern() provides long-lived copies of others.
+ */
+class RENITY_API ResourcePath {
+ public:
+  constexpr ResourcePath(const char *path) : path_(path), id_(hashPath(path)) {}
+
+  /** Get a handle to a permanent copy of a path, e.g. one built at runtime.
+   * Interning the same path again returns the same copy.
+   */
+  static ResourcePath intern(const char *path);
+  static ResourcePath intern(const String &path) {
+    return intern(path.c_str());
+  }
+
+  constexpr PathId id() const { return id_; }
+  constexpr const char *c_str() const { return path_; }
+
+ private:
+  const char *path_;
+  PathId id_;
+};
+}  // namespace renity
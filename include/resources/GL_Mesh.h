@@ -13,6 +13,8 @@
 #include "types.h"
 
 namespace renity {
+class CookedFileWriter;
+class Dictionary;
 struct MeshPosition {
   float x, y, z;
   Uint32 u, v;
@@ -34,9 +36,20 @@ class RENITY_API GL_Mesh : public Resource {
    */
   void draw(const Vector<MeshPosition>& instances);
 
+  size_t getGpuBytes() const;
+
+  /** Cook a mesh file's contents into the binary format loads prefer.
+   * Any indices or UVs the file leaves out are generated ahead of time.
+   * \param dict The mesh file contents.
+   * \param out Where to add the cooked sections.
+   * \returns True on success, false if the mesh has no vertices.
+   */
+  static bool cook(Dictionary& dict, CookedFileWriter& out);
+
  protected:
   friend class ResourceManager;
   void load(SDL_RWops* src);
+  bool needsGpuContext() const { return true; }
 
  private:
   struct Impl;
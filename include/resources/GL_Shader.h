@@ -34,6 +34,7 @@ class RENITY_API GL_Shader : public Resource {
  protected:
   friend class ResourceManager;
   void load(SDL_RWops* src);
+  bool needsGpuContext() const { return true; }
 
  private:
   struct Impl;
@@ -13,6 +13,8 @@
 #include "types.h"
 
 namespace renity {
+class CookedFileWriter;
+class Dictionary;
 // The GL guarantees >=24 binding points per program and up to 16kb block sizes:
 // https://registry.khronos.org/OpenGL-Refpages/es3.0/html/glGet.xhtml
 constexpr size_t MAX_UNIFORM_BLOCK_NAMES = 24;
@@ -72,12 +74,28 @@ class RENITY_API GL_ShaderProgram : public Resource {
   template <typename T>
   bool setUniformBlock(String blockName, Vector<T> uniforms);
 
+  /** Choose which texture unit a sampler uniform reads from.
+   * Samplers read from unit 0 unless set otherwise. The choice is kept when
+   * the program is relinked, e.g. after its shaders are reloaded.
+   * \param samplerName The sampler's name in the shader source.
+   * \param unit The texture unit, e.g. 1 for GL_TEXTURE1.
+   * \returns True on success, false if the program has no such sampler.
+   */
+  bool setSamplerUnit(String samplerName, Uint32 unit);
+
+  /** Cook a shader program file's contents into the format loads prefer.
+   * \param dict The shader program file contents.
+   * \param out Where to add the cooked sections.
+   * \returns True on success, false if the program is missing shader paths.
+   */
+  static bool cook(Dictionary& dict, CookedFileWriter& out);
+
  protected:
   friend class ResourceManager;
   void load(SDL_RWops* src);
+  bool needsGpuContext() const { return true; }
 
  private:
-  friend static void flagReload(void* userdata);
   struct Impl;
   Impl* pimpl_;
 };
@@ -10,6 +10,7 @@
 #pragma once
 
 #include "Dimension2D.h"
+#include "Rect2D.h"
 #include "Resource.h"
 #include "types.h"
 
@@ -51,7 +52,26 @@ class RENITY_API GL_Texture2D : public Resource {
    */
   Dimension2Du32 getSize() const;
 
+  /** Check whether an area of the image has no transparent pixels.
+   * Opacity is recorded in blocks of 4x4 pixels while decoding, so an area
+   * that doesn't line up with them is judged by every block it touches, and
+   * may be reported translucent even when it isn't (but never the reverse).
+   * \param area The area in pixels, from the image's top-left corner.
+   * \returns True if the area is in bounds and every pixel is fully opaque.
+   */
+  bool isOpaque(const Rect2Di32& area) const;
+
+  size_t getCpuBytes() const;
+  size_t getGpuBytes() const;
+
+ protected:
+  bool prepareLoad(SDL_RWops* src);
+  void finishLoad();
+  bool needsGpuContext() const { return true; }
+
  private:
+  friend class GL_TextureArray;
+  Uint32 getTextureIndex() const;
   struct Impl;
   Impl* pimpl_;
 };
@@ -38,6 +38,7 @@ class RENITY_API ScriptContext : public Dictionary {
  protected:
   friend class ResourceManager;
   void load(SDL_RWops* src);
+  void finishLoad();
   void setupGlobalEnv();
 
  private:
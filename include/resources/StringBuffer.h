@@ -24,6 +24,8 @@ class RENITY_API StringBuffer : public Resource {
 
   size_t length() const;
 
+  size_t getCpuBytes() const;
+
   void load(SDL_RWops *src);
 
  private:
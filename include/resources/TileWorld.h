@@ -9,11 +9,15 @@
  ***************************************************/
 #pragma once
 
+#include "GL_LightRenderer.h"
 #include "Point2D.h"
 #include "Resource.h"
 #include "types.h"
 
 namespace renity {
+class CookedFile;
+class CookedFileWriter;
+class Dictionary;
 class RENITY_API TileWorld : public Resource {
  public:
   TileWorld();
@@ -25,11 +29,43 @@ class RENITY_API TileWorld : public Resource {
    */
   void draw(const Point2Di32 cameraPos, float scale = 1.0f);
 
+  /** Set how far around the view maps are streamed in and kept.
+   * Maps start loading in the background once they're within prefetchRadius
+   * of the view, so they're ready before they scroll on screen, and are
+   * released once they're beyond evictRadius. The gap between the two keeps
+   * maps near the edge from being reloaded as the camera moves back and forth.
+   * Released maps are also dropped from the ResourceManager's retention, so
+   * they're freed rather than held within its budget.
+   * \param prefetchRadius Distance from the view to load maps within, in
+   * world pixels. Default is 512.
+   * \param evictRadius Distance from the view to release maps beyond, in world
+   * pixels; at least prefetchRadius. Default is 1024.
+   */
+  void setStreamingRadius(Sint32 prefetchRadius, Sint32 evictRadius);
+
+  /** Set the dynamic lights, e.g. ones that move, replacing any set before.
+   * Map lights are static and baked into lightmaps; these are drawn
+   * separately every frame, so they can change as often as needed.
+   * \param lights The lights, positioned in pixels from the world's origin.
+   */
+  void setLights(Span<const LightInstance> lights);
+
+  /** Cook a world file's contents into the binary format loads prefer.
+   * \param dict The world file contents.
+   * \param out Where to add the cooked sections.
+   * \returns True on success, false if any maps are missing details.
+   */
+  static bool cook(Dictionary& dict, CookedFileWriter& out);
+
  protected:
   friend class ResourceManager;
   void load(SDL_RWops* src);
+  bool prepareLoad(SDL_RWops* src);
+  void finishLoad();
 
  private:
+  void load(Dictionary& dict);
+  void load(const CookedFile& cooked);
   struct Impl;
   Impl* pimpl_;
 };
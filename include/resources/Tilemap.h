@@ -9,14 +9,32 @@
  ***************************************************/
 #pragma once
 
+#include "GL_LightRenderer.h"
 #include "GL_TileRenderer.h"
 #include "Point2D.h"
+#include "Rect2D.h"
 #include "Resource.h"
 #include "types.h"
 
 namespace renity {
-// Max number currently allowed by the GLES varying variables threshold
-constexpr Uint8 MAX_MAP_LIGHTS = 15;
+class CookedFile;
+class CookedFileWriter;
+class Dictionary;
+// Width and height of the chunks that maps are culled by, in tiles
+constexpr Uint32 MAP_CHUNK_TILES = 16;
+// Size of the TileAnimations shader block, in uvec4s; each animation a map
+// uses takes one for itself plus one per frame
+constexpr Uint32 MAX_ANIMATION_VECS = 256;
+// Longest an animation can take to loop, in milliseconds (about 4.6 hours),
+// so the shader can take the clock modulo it exactly in 32-bit math
+constexpr Uint32 MAX_ANIMATION_DURATION = 1 << 24;
+// Size of the TilesetLayouts shader block, in uvec4s, which is also the most
+// tilesets a map can use
+constexpr Uint32 MAX_TILESETS = 256;
+// Most tiles a map can have across or down, and most layers it can have;
+// both are limited by how tiles are packed into TileInstances
+constexpr Uint32 MAX_MAP_TILES = 65536;
+constexpr Uint32 MAX_MAP_LAYERS = TILE_DEPTH_MASK + 1;
 
 class RENITY_API Tilemap : public Resource {
  public:
@@ -28,11 +46,47 @@ class RENITY_API Tilemap : public Resource {
    */
   void draw(GL_TileRenderer& renderer, const Point2Di32 position);
 
+  /** Draw the parts of the map within a view, skipping off-screen chunks.
+   * \param position A top-left-relative screen location to draw at, in pixels.
+   * \param view The visible area, in pixels from the map's top-left corner.
+   */
+  void draw(GL_TileRenderer& renderer, const Point2Di32 position,
+            const Rect2Di32& view);
+
+  /** Get the point lights of the map's tiles.
+   * \returns Every light, positioned in pixels from the map's top-left corner.
+   */
+  Span<const LightInstance> getLights() const;
+
+  /** Get the map's lights, baked into a lightmap when it was loaded or cooked.
+   * The lightmap is uploaded on first use after a (re)load.
+   * \returns The lightmap, or an empty pointer if the map has no lights.
+   */
+  SharedPtr<GL_Lightmap> getLightmap();
+
+  size_t getCpuBytes() const;
+  size_t getGpuBytes() const;
+
+  /** Cook a map file's contents into the binary format loads prefer.
+   * The tiles are resolved against each tileset ahead of time, so the tileset
+   * files must be readable at their given paths.
+   * \param dict The map file contents.
+   * \param out Where to add the cooked sections.
+   * \returns True on success, false if the map or its tilesets are invalid.
+   */
+  static bool cook(Dictionary& dict, CookedFileWriter& out);
+
  protected:
   friend class ResourceManager;
   void load(SDL_RWops* src);
+  bool prepareLoad(SDL_RWops* src);
+  void finishLoad();
+  void getDependencies(Vector<ResourceRef>& deps);
+  bool needsGpuContext() const { return true; }
 
  private:
+  void load(Dictionary& dict);
+  void load(const CookedFile& cooked);
   struct Impl;
   Impl* pimpl_;
 };
@@ -11,9 +11,26 @@
 
 #include "Dimension2D.h"
 #include "Resource.h"
+#include "resources/GL_Texture2D.h"
 #include "types.h"
 
 namespace renity {
+class CookedFile;
+class CookedFileWriter;
+class Dictionary;
+
+/** One frame of an animated tile. */
+struct TileFrame {
+  TileId id;        // 0-indexed TileId to show, relative to the tileset
+  Uint32 duration;  // In milliseconds
+};
+
+/** The animation frames of every tile in a tileset. */
+struct TileAnimations {
+  Vector<Uint32> starts;     // Index of each tile's first frame, then the end
+  Vector<TileFrame> frames;  // Grouped by tile, in TileId order
+};
+
 class RENITY_API Tileset : public Resource {
  public:
   Tileset();
@@ -31,11 +48,61 @@ class RENITY_API Tileset : public Resource {
   /** Get the number of drawable tiles in each dimension (width and height). */
   Dimension2Du32 getTileCounts() const;
 
+  /** Get the sheet texture, e.g. to pack it together with other tilesets.
+   * \returns The texture, or an empty pointer if it hasn't been loaded.
+   */
+  GL_Texture2DPtr getTexture() const;
+
+  /** Check whether a tile has no transparent pixels.
+   * Opaque tiles can be drawn without blending, and front-to-back so the depth
+   * test skips whatever they cover.
+   * \param id The 0-indexed TileId, relative to the tileset.
+   * \returns True if every pixel of the tile is fully opaque.
+   */
+  bool isOpaque(TileId id) const;
+
+  /** Get the animation frames of a tile.
+   * \param id The 0-indexed TileId, relative to the tileset.
+   * \returns The frames in the order they play, or an empty Span if the tile
+   * isn't animated.
+   */
+  Span<const TileFrame> getAnimation(TileId id) const;
+
+  size_t getCpuBytes() const;
+
+  /** Cook a tileset file's contents into the binary format loads prefer.
+   * \param dict The tileset file contents.
+   * \param out Where to add the cooked sections.
+   * \returns True on success, false if the tileset is missing details or
+   * its sheet image doesn't match the size it gives.
+   */
+  static bool cook(Dictionary& dict, CookedFileWriter& out);
+
+  /** Read the tile counts and point light colors from a tileset file.
+   * Loaded tilesets count tiles using their texture instead; this is for tools
+   * that read tilesets without loading textures, e.g. when cooking maps.
+   * \param opaqueTilesOut Where to store whether each tile is opaque (see
+   * isOpaque()), or a nullptr to skip decoding the sheet image for it.
+   * \param animationsOut Where to store the tile animations, or a nullptr to
+   * skip them.
+   * \returns True on success, false if the tileset is missing details or
+   * its sheet image doesn't match the size it gives.
+   */
+  static bool readTileDetails(Dictionary& dict, Dimension2Du32* tileCountsOut,
+                              Vector<Uint32>* lightColorsOut,
+                              Vector<Uint8>* opaqueTilesOut = nullptr,
+                              TileAnimations* animationsOut = nullptr);
+
  protected:
   friend class ResourceManager;
   void load(SDL_RWops* src);
+  bool prepareLoad(SDL_RWops* src);
+  void finishLoad();
+  void getDependencies(Vector<ResourceRef>& deps);
 
  private:
+  void load(Dictionary& dict);
+  void load(const CookedFile& cooked);
   struct Impl;
   Impl* pimpl_;
 };
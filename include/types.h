@@ -21,7 +21,9 @@
 #if defined RENITY_USE_STL && __cplusplus >= 201703L
 // PORTABILITY NOTE: Some features require RTTI and at least C++17
 #include <atomic>
+#include <deque>
 #include <functional>
+#include <list>
 #include <memory>
 #include <string>
 #include <thread>
@@ -37,6 +39,7 @@ using ActionCategoryId = Id;
 using ActionId = Id;
 using ChunkId = Id;
 using EntityId = Uint64;
+using PathId = Uint64;
 using TileId = Id;
 using Timestamp = Uint64;
 
@@ -79,8 +82,27 @@ template <typename T>
 using WeakPtr = std::weak_ptr<T>;
 template <typename T>
 using Vector = std::vector<T>;
+template <typename T>
+using Deque = std::deque<T>;
+template <typename T>
+using List = std::list<T>;
+
+/** Non-owning view of contiguous values, until we can use C++20 std::span. */
+template <typename T>
+struct Span {
+  T *ptr = nullptr;
+  size_t count = 0;
+
+  T *data() const { return ptr; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  T *begin() const { return ptr; }
+  T *end() const { return ptr + count; }
+  T &operator[](size_t index) const { return ptr[index]; }
+};
 
 using AtomicFlag8 = std::atomic<uint_fast8_t>;
+using AtomicUint64 = std::atomic<Uint64>;
 using String = std::string;
 using PrimitiveVariant =
     std::variant<String, Uint64, Uint32, Uint16, Uint8, Sint64, Sint32, Sint16,
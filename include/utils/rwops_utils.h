@@ -67,6 +67,32 @@ RENITY_API Sint64 RENITY_ReadCharBufferMax(SDL_RWops* src, char** bufOut,
 #define RENITY_ReadCharBuffer(src, bufOut) \
   RENITY_ReadCharBufferMax(src, bufOut, 1 << 24)
 
+/** Open a PhysFS file for reading as a read-only memory map.
+ * Only files in real directories can be mapped; PhysFS doesn't expose where
+ * (or whether) archive entries are stored uncompressed, so those return NULL.
+ * Truncating a file while it's mapped faults on the next access, so files that
+ * can change while in use (e.g. hot-reloadable ones) shouldn't be mapped.
+ * @param fname File to open in platform-independent notation.
+ * @return An RWops over the mapping, or NULL if the file could not be mapped.
+ */
+RENITY_API SDL_RWops* RENITY_OpenMappedRead(const char* fname);
+
+/** Open a PhysFS file for reading, memory-mapping it where possible.
+ * @param fname File to open in platform-independent notation.
+ * @return A mapped RWops if RENITY_OpenMappedRead() succeeded, otherwise the
+ * result of PHYSFSRWOPS_openRead().
+ */
+RENITY_API SDL_RWops* RENITY_OpenRead(const char* fname);
+
+/** Get direct access to the contents of a memory-mapped RWops.
+ * @param src Any RWops; only ones from RENITY_OpenMappedRead() have a buffer.
+ * @param sizeOut Where to store the size of the contents. Can be NULL.
+ * @return The unterminated file contents, valid until src is closed, or NULL
+ * if src is not memory-mapped.
+ */
+RENITY_API const Uint8* RENITY_GetMappedBuffer(SDL_RWops* src,
+                                               Sint64* sizeOut);
+
 #ifdef __cplusplus
 }
 #endif  //__cplusplus
@@ -13,12 +13,15 @@
 #include <SDL3/SDL.h>
 #include <physfs.h>
 
+#include <algorithm>
+
 #ifdef RENITY_DEBUG
 #include "3rdparty/dmon/dmon.h"
 #endif
 #include "3rdparty/imgui/imgui.h"
 #include "ActionHandler.h"
 #include "ActionManager.h"
+#include "Dictionary.h"
 #include "GL_TileRenderer.h"
 #include "InputMapper.h"
 #include "ResourceManager.h"
@@ -105,6 +108,68 @@ class ActionLogger : public ActionHandler {
 };
 #endif
 
+#ifdef RENITY_DEBUG
+// Show per-resource load timings and memory use, slowest loads first
+static void showResourceInspector() {
+  ResourceManager *resMgr = ResourceManager::getActive();
+  if (!resMgr) return;
+  ImGui::SetNextWindowSize(ImVec2(720, 300));
+  ImGui::Begin("Resources");
+  ResourceCacheStats cache = resMgr->getCacheStats();
+  ImGui::Text("Cache: %llu hits, %llu misses, %llu evictions, %u retained "
+              "(%.1f KB)",
+              (unsigned long long)cache.hits, (unsigned long long)cache.misses,
+              (unsigned long long)cache.evictions, cache.retainedCount,
+              cache.retainedBytes / 1024.0f);
+
+  Vector<ResourceLoadStats> allStats = resMgr->getLoadStats();
+  std::sort(allStats.begin(), allStats.end(),
+            [](const ResourceLoadStats &a, const ResourceLoadStats &b) {
+              return a.openNS + a.readNS + a.parseNS + a.uploadNS >
+                     b.openNS + b.readNS + b.parseNS + b.uploadNS;
+            });
+  const ImGuiTableFlags flags = ImGuiTableFlags_Borders |
+                                ImGuiTableFlags_RowBg |
+                                ImGuiTableFlags_ScrollY |
+                                ImGuiTableFlags_Resizable;
+  if (ImGui::BeginTable("loadStats", 10, flags)) {
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Path");
+    ImGui::TableSetupColumn("Open ms");
+    ImGui::TableSetupColumn("Read ms");
+    ImGui::TableSetupColumn("Parse ms");
+    ImGui::TableSetupColumn("Upload ms");
+    ImGui::TableSetupColumn("Read KB");
+    ImGui::TableSetupColumn("CPU KB");
+    ImGui::TableSetupColumn("GPU KB");
+    ImGui::TableSetupColumn("Refs");
+    ImGui::TableSetupColumn("Reloads");
+    ImGui::TableHeadersRow();
+    for (auto &stats : allStats) {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(stats.path.c_str());
+      for (Uint64 ns : {stats.openNS, stats.readNS, stats.parseNS,
+                        stats.uploadNS}) {
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", (double)ns / SDL_NS_PER_MS);
+      }
+      for (size_t bytes :
+           {(size_t)stats.bytesRead, stats.cpuBytes, stats.gpuBytes}) {
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", bytes / 1024.0f);
+      }
+      ImGui::TableNextColumn();
+      ImGui::Text("%li", stats.refCount);
+      ImGui::TableNextColumn();
+      ImGui::Text("%u", stats.reloadCount);
+    }
+    ImGui::EndTable();
+  }
+  ImGui::End();
+}
+#endif
+
 RENITY_API Application::Application(int argc, char *argv[]) {
 #ifdef RENITY_DEBUG
   // Redirect logs to a file and turn on debug logs
@@ -136,6 +201,8 @@ RENITY_API Application::~Application() {
   dmon_deinit();
 #endif
   pimpl_->window.close();
+  // Finish any background saves while their write dir is still available
+  Dictionary::flushSaves();
   PHYSFS_deinit();
   delete this->pimpl_;
   SDL_Quit();
@@ -280,10 +347,9 @@ RENITY_API int Application::run() {
   float ambient[3] = {0.5f, 0.5f, 0.5f};
   srand((Uint32)SDL_GetTicksNS());
   GL_ShaderProgramPtr tileShader =
-      ResourceManager::getActive()->get<GL_ShaderProgram>(
-          "/assets/shaders/tile2d.shader");
-  TileWorldPtr world =
-      ResourceManager::getActive()->get<TileWorld>("/assets/maps/test.world");
+      ResourceManager::getActive()->get<GL_ShaderProgram>(TILE_SHADER_PATH);
+  TileWorldPtr world = ResourceManager::getActive()->getAsync<TileWorld>(
+      "/assets/maps/test.world");
 
   while (keepGoing) {
     // Recalculate displayed FPS every second
@@ -309,7 +375,7 @@ RENITY_API int Application::run() {
       ImGui::PushStyleColor(ImGuiCol_TitleBgActive,
                             IM_COL32(clearColor[0] / 2, clearColor[1] / 2,
                                      clearColor[2] / 2, 128));
-      ImGui::SetNextWindowSize(ImVec2(0, 235));
+      ImGui::SetNextWindowSize(ImVec2(0, 260));
       ImGui::Begin("Settings");
 
       // ImGui::Text("Rendering %llu sprites.", spriteCount);
@@ -324,9 +390,19 @@ RENITY_API int Application::run() {
       ImGui::SliderInt2("Camera position", worldOffset, -500, 2000);
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / fps,
                   fps);
+      ResourceLoadProgress loading =
+          ResourceManager::getActive()->getLoadProgress();
+      if (loading.finished < loading.queued) {
+        ImGui::ProgressBar((float)loading.finished / loading.queued,
+                           ImVec2(-1.0f, 0.0f), "Loading...");
+      }
       ImGui::End();
       ImGui::PopStyleColor();
     }
+#ifdef RENITY_DEBUG
+    showResourceInspector();
+#endif
+
     // Set wireframe mode and toggle VSync if requested
     GL_TileRenderer::enableWireframe(wireframe);
     if (vsync != vsyncLast) {
@@ -344,6 +420,10 @@ RENITY_API int Application::run() {
     tileShader->setUniformBlock<float>("ViewParams", {width, height, scale});
     tileShader->setUniformBlock<float>(
         "LightingParams", {ambient[0], ambient[1], ambient[2], gamma});
+    const Uint64 ticks = SDL_GetTicks();
+    tileShader->setUniformBlock<unsigned int>(
+        "AnimationParams",
+        {(unsigned int)ticks, (unsigned int)(ticks >> 32), 0, 0});
     world->draw({worldOffset[0], worldOffset[1]}, scale);
 
     // Pump events, then clear them all out after subsystems react to the
@@ -367,6 +447,10 @@ RENITY_API int Application::run() {
     }
   }
 
+#ifndef RENITY_DEBUG
+  // There's no inspector in release builds, so leave a report behind instead
+  ResourceManager::getActive()->saveLoadStats("resource_stats.json");
+#endif
   return 0;
 }
 
@@ -0,0 +1,276 @@
+/****************************************************
+ * AsyncFileWriter.cc: Write-behind file saving     *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+
+#include "AsyncFileWriter.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_timer.h>
+#include <errno.h>
+#include <physfs.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace renity {
+// How long a write waits for more saves of the same file to replace it
+static const Uint64 COALESCE_MS = 50;
+
+struct PendingWrite {
+  String nativePath;
+  Vector<Uint8> contents;
+  Uint64 queuedAt;
+};
+
+struct WriteQueue {
+  SDL_Mutex *lock = SDL_CreateMutex();
+  SDL_Condition *queued = SDL_CreateCondition();
+  SDL_Condition *flushed = SDL_CreateCondition();
+  SDL_Thread *thread = nullptr;
+  List<PendingWrite> pending;
+  bool stopping = false;  // Whether a flush() owns (and is joining) the thread
+  Uint64 written = 0;
+};
+
+// Never destroyed, so static Dictionaries can still save at exit
+static WriteQueue &getQueue() {
+  static WriteQueue *queue = new WriteQueue();
+  return *queue;
+}
+
+#ifdef _WIN32
+// Native paths are UTF-8, which the ANSI file APIs would mangle
+static std::wstring widen(const String &path) {
+  const int length =
+      MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  if (length <= 0) return std::wstring();
+  std::wstring widePath(length, L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &widePath[0], length);
+  widePath.resize(length - 1);
+  return widePath;
+}
+#endif
+
+// Write and sync a file, so renaming it can never expose a partial one
+static bool writeSynced(const String &path, const Vector<Uint8> &contents) {
+#ifdef _WIN32
+  FILE *dest = _wfopen(widen(path).c_str(), L"wb");
+#else
+  FILE *dest = fopen(path.c_str(), "wb");
+#endif
+  if (!dest) return false;
+  bool written =
+      fwrite(contents.data(), 1, contents.size(), dest) == contents.size();
+  written = written && fflush(dest) == 0;
+#ifdef _WIN32
+  written = written && _commit(_fileno(dest)) == 0;
+#else
+  written = written && fsync(fileno(dest)) == 0;
+#endif
+  return fclose(dest) == 0 && written;
+}
+
+static void removeFile(const String &path) {
+#ifdef _WIN32
+  _wremove(widen(path).c_str());
+#else
+  remove(path.c_str());
+#endif
+}
+
+// Write to a temporary file, then atomically replace the destination with it
+static bool writeFile(const PendingWrite &write) {
+  const String tempPath = write.nativePath + ".tmp";
+  if (!writeSynced(tempPath, write.contents)) {
+    SDL_LogError(SDL_LOG_CATEGORY_SYSTEM,
+                 "AsyncFileWriter: Could not write '%s': %s\n",
+                 tempPath.c_str(), strerror(errno));
+    removeFile(tempPath);
+    return false;
+  }
+
+#ifdef _WIN32
+  const bool renamed =
+      MoveFileExW(widen(tempPath).c_str(), widen(write.nativePath).c_str(),
+                  MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  const bool renamed =
+      rename(tempPath.c_str(), write.nativePath.c_str()) == 0;
+#endif
+  if (!renamed) {
+    SDL_LogError(SDL_LOG_CATEGORY_SYSTEM,
+                 "AsyncFileWriter: Could not replace '%s'.\n",
+                 write.nativePath.c_str());
+    removeFile(tempPath);
+    return false;
+  }
+  SDL_LogVerbose(SDL_LOG_CATEGORY_SYSTEM,
+                 "AsyncFileWriter: Wrote %zu bytes to '%s'.\n",
+                 write.contents.size(), write.nativePath.c_str());
+  return true;
+}
+
+/* Resolve a PhysFS path in the write dir to a native one. Like PhysFS itself,
+ * this rejects "." and ".." components, and any ':' or '\' that could make
+ * up a drive or absolute path, so nothing can be written outside the dir.
+ */
+static bool getNativePath(const char *writeDir, const char *destPath,
+                          String *nativePathOut) {
+  const char *separator = PHYSFS_getDirSeparator();
+  String nativePath(writeDir);
+  if (!nativePath.empty() && nativePath.back() != separator[0]) {
+    nativePath += separator;
+  }
+  while (*destPath == '/') ++destPath;
+  bool named = false;
+  for (const char *start = destPath; *start;) {
+    const char *end = start;
+    while (*end && *end != '/') ++end;
+    const String component(start, end - start);
+    if (component == "." || component == ".." ||
+        component.find_first_of(":\\") != String::npos) {
+      return false;
+    }
+    if (!component.empty()) {
+      if (named) nativePath += separator;
+      nativePath += component;
+      named = true;
+    }
+    start = *end ? end + 1 : end;
+  }
+  if (!named) return false;
+  *nativePathOut = std::move(nativePath);
+  return true;
+}
+
+static int writerMain(void *data) {
+  WriteQueue &queue = *(WriteQueue *)data;
+  SDL_LockMutex(queue.lock);
+  for (;;) {
+    if (queue.pending.empty()) {
+      if (queue.stopping) break;
+      SDL_WaitCondition(queue.queued, queue.lock);
+      continue;
+    }
+    // Give bursts of saves a moment to coalesce, unless flushing
+    const Uint64 due = queue.pending.front().queuedAt + COALESCE_MS;
+    const Uint64 now = SDL_GetTicks();
+    if (!queue.stopping && now < due) {
+      SDL_WaitConditionTimeout(queue.queued, queue.lock, (Sint32)(due - now));
+      continue;
+    }
+    PendingWrite write = std::move(queue.pending.front());
+    queue.pending.pop_front();
+    SDL_UnlockMutex(queue.lock);
+    const bool written = writeFile(write);
+    SDL_LockMutex(queue.lock);
+    if (written) ++queue.written;
+  }
+  SDL_UnlockMutex(queue.lock);
+  return 0;
+}
+
+bool AsyncFileWriter::queue(const char *destPath, Vector<Uint8> &&contents) {
+  // Resolve the native path now, in case the write dir changes later
+  const char *writeDir = PHYSFS_getWriteDir();
+  if (!destPath || !writeDir) {
+    SDL_LogError(SDL_LOG_CATEGORY_SYSTEM,
+                 "AsyncFileWriter::queue: No write dir to save '%s' in.\n",
+                 destPath ? destPath : "<nullptr>");
+    return false;
+  }
+  String nativePath;
+  if (!getNativePath(writeDir, destPath, &nativePath)) {
+    SDL_LogError(SDL_LOG_CATEGORY_SYSTEM,
+                 "AsyncFileWriter::queue: Refusing to save outside the write "
+                 "dir: '%s'.\n",
+                 destPath);
+    return false;
+  }
+
+  WriteQueue &queue = getQueue();
+  SDL_LockMutex(queue.lock);
+  bool coalesced = false;
+  for (auto &write : queue.pending) {
+    if (write.nativePath == nativePath) {
+      write.contents = std::move(contents);
+      coalesced = true;
+      break;
+    }
+  }
+  if (!coalesced) {
+    queue.pending.push_back({nativePath, std::move(contents), SDL_GetTicks()});
+  }
+  // While flushing, the stopping thread (or flush itself) writes it instead
+  bool started = queue.thread || queue.stopping;
+  if (!started) {
+    queue.thread = SDL_CreateThread(writerMain, "AsyncFileWriter", &queue);
+    started = queue.thread != nullptr;
+  }
+  SDL_SignalCondition(queue.queued);
+  SDL_UnlockMutex(queue.lock);
+
+  // Without a thread, write it now rather than lose it
+  if (!started) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_SYSTEM,
+                "AsyncFileWriter::queue: Could not start writer thread (%s); "
+                "writing synchronously.\n",
+                SDL_GetError());
+    flush();
+  }
+  return true;
+}
+
+void AsyncFileWriter::flush() {
+  WriteQueue &queue = getQueue();
+  SDL_LockMutex(queue.lock);
+  // Only one flush can join the thread, so any others wait for it to finish
+  while (queue.stopping) SDL_WaitCondition(queue.flushed, queue.lock);
+  SDL_Thread *thread = queue.thread;
+  queue.thread = nullptr;
+  queue.stopping = true;
+  SDL_SignalCondition(queue.queued);
+  SDL_UnlockMutex(queue.lock);
+
+  // The thread only stops once everything queued is written
+  if (thread) SDL_WaitThread(thread, nullptr);
+
+  // Write anything left, e.g. if there was no thread to do it
+  SDL_LockMutex(queue.lock);
+  while (!queue.pending.empty()) {
+    List<PendingWrite> pending = std::move(queue.pending);
+    queue.pending.clear();
+    SDL_UnlockMutex(queue.lock);
+    Uint64 written = 0;
+    for (auto &write : pending) written += writeFile(write) ? 1 : 0;
+    SDL_LockMutex(queue.lock);
+    queue.written += written;
+  }
+  queue.stopping = false;
+  SDL_BroadcastCondition(queue.flushed);
+  SDL_UnlockMutex(queue.lock);
+}
+
+Uint64 AsyncFileWriter::getWriteCount() {
+  WriteQueue &queue = getQueue();
+  SDL_LockMutex(queue.lock);
+  const Uint64 written = queue.written;
+  SDL_UnlockMutex(queue.lock);
+  return written;
+}
+}  // namespace renity
@@ -0,0 +1,43 @@
+/****************************************************
+ * AsyncFileWriter.h: Write-behind file saving      *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+#pragma once
+
+#include "types.h"
+
+namespace renity {
+/** Writes files from a background thread, so saving costs callers no I/O.
+ * Files are written to a temporary name and then renamed over the original,
+ * so readers never see a partial file even if the program dies mid-write.
+ */
+class AsyncFileWriter {
+ public:
+  /** Queue a file to be written.
+   * If the same file is already queued and not yet being written, its
+   * contents are replaced, so bursts of saves only write the latest one.
+   * Writes wait briefly for more saves before starting, so they coalesce too.
+   * @param destPath Destination PhysFS path, relative to the write dir. Paths
+   * with "." or ".." components, or a ':' or '\', are rejected.
+   * @param contents The complete file contents, which the writer takes.
+   * @return True if the write was queued, false if there's no write dir or
+   * destPath is invalid.
+   */
+  static bool queue(const char *destPath, Vector<Uint8> &&contents);
+
+  /** Wait for every queued write to finish, and stop the writer thread.
+   * It restarts on the next queue(). Must be called before PhysFS shuts down,
+   * e.g. at exit, to make sure nothing queued is lost. Safe to call from
+   * several threads at once.
+   */
+  static void flush();
+
+  /** Get the number of files written successfully so far. */
+  static Uint64 getWriteCount();
+};
+}  // namespace renity
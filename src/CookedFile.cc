@@ -0,0 +1,260 @@
+/****************************************************
+ * CookedFile.cc: Binary resource layout for cooking*
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+
+#include "CookedFile.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "HashTable.h"
+#include "utils/rwops_utils.h"
+
+namespace renity {
+static const char COOKED_MAGIC[8] = {'R', 'N', 'T', 'Y', 'C', 'O', 'O', 'K'};
+static const Uint32 BYTE_ORDER_MARK = 0x01020304;
+static const size_t SECTION_ALIGN = 16;
+
+struct CookedHeader {
+  char magic[8];
+  Uint32 version;
+  Uint32 byteOrder;  // Reads as BYTE_ORDER_MARK on hosts of the same order
+  Uint32 type;
+  Uint32 sectionCount;
+};
+
+struct CookedSection {
+  Uint32 tag;
+  Uint32 offset;  // From the start of the file
+  Uint32 bytes;
+  Uint32 reserved;
+};
+
+static size_t alignSection(size_t offset) {
+  return (offset + SECTION_ALIGN - 1) & ~(SECTION_ALIGN - 1);
+}
+
+struct CookedFile::Impl {
+  Impl() : data(nullptr), size(0), mapped(nullptr), owned(nullptr) {}
+  ~Impl() { close(); }
+
+  void close() {
+    if (mapped) SDL_RWclose(mapped);
+    SDL_free(owned);
+    data = nullptr;
+    size = 0;
+    mapped = nullptr;
+    owned = nullptr;
+  }
+
+  const CookedHeader *header() const { return (const CookedHeader *)data; }
+
+  const CookedSection *sections() const {
+    return (const CookedSection *)(data + sizeof(CookedHeader));
+  }
+
+  const Uint8 *data;  // Either the mapped file or owned
+  size_t size;
+  SDL_RWops *mapped;
+  Uint8 *owned;
+};
+
+RENITY_API CookedFile::CookedFile() { pimpl_ = new Impl(); }
+
+RENITY_API CookedFile::~CookedFile() { delete pimpl_; }
+
+RENITY_API bool CookedFile::open(SDL_RWops *src, Uint32 type) {
+  pimpl_->close();
+  if (!src) return false;
+
+  // Check the header and section table without disturbing the stream, so
+  // anything that isn't a valid cooked file is left for other decoders
+  Sint64 size = 0;
+  const Uint8 *mapped = RENITY_GetMappedBuffer(src, &size);
+  if (!mapped) size = SDL_RWsize(src);
+  auto peek = [&](void *dest, size_t offset, size_t bytes) {
+    if (offset + bytes > (size_t)size) return false;
+    if (mapped) {
+      SDL_memcpy(dest, mapped + offset, bytes);
+      return true;
+    }
+    const bool read =
+        SDL_RWseek(src, offset, SDL_RW_SEEK_SET) == (Sint64)offset &&
+        SDL_RWread(src, dest, bytes) == (Sint64)bytes;
+    SDL_RWseek(src, 0, SDL_RW_SEEK_SET);
+    return read;
+  };
+  CookedHeader head;
+  if (size < (Sint64)sizeof(head) || !peek(&head, 0, sizeof(head)) ||
+      SDL_memcmp(head.magic, COOKED_MAGIC, sizeof(COOKED_MAGIC)) != 0) {
+    return false;
+  }
+  if (head.version != COOKED_VERSION || head.byteOrder != BYTE_ORDER_MARK ||
+      head.type != type) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "CookedFile::open: Unsupported cooked file (version %u, "
+                 "byte order %#010x, type %#010x vs %#010x).\n",
+                 head.version, head.byteOrder, head.type, type);
+    return false;
+  }
+  const size_t maxSections = (size - sizeof(head)) / sizeof(CookedSection);
+  Vector<CookedSection> table(SDL_min(head.sectionCount, maxSections));
+  if (head.sectionCount > maxSections ||
+      !peek(table.data(), sizeof(head),
+            sizeof(CookedSection) * head.sectionCount)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "CookedFile::open: Truncated section table.\n");
+    return false;
+  }
+  for (auto &section : table) {
+    if (section.offset % SECTION_ALIGN || section.offset > size ||
+        section.bytes > size - section.offset) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "CookedFile::open: Section %#010x is out of bounds.\n",
+                   section.tag);
+      return false;
+    }
+  }
+
+  // Use mapped files in-place, and read anything else in
+  if (mapped) {
+    pimpl_->data = mapped;
+    pimpl_->size = (size_t)size;
+    pimpl_->mapped = src;
+  } else {
+    const Sint64 readBytes =
+        RENITY_ReadRawBufferMax(src, &pimpl_->owned, (Uint32)size);
+    if (readBytes != size) {
+      // The stream is gone either way; leave the file empty
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "CookedFile::open: Could only read %li of %li bytes.\n",
+                   readBytes, size);
+      pimpl_->close();
+      return true;
+    }
+    pimpl_->data = pimpl_->owned;
+    pimpl_->size = (size_t)size;
+  }
+  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                 "CookedFile::open: Opened %lu-byte %s cooked file.\n",
+                 pimpl_->size, mapped ? "mapped" : "buffered");
+  return true;
+}
+
+RENITY_API const char *CookedFile::getString(Uint32 offset) const {
+  const Span<const char> strings = getSection<char>(COOKED_STRINGS);
+  if (offset >= strings.size() || strings[strings.size() - 1] != '\0') {
+    return "";
+  }
+  return strings.data() + offset;
+}
+
+RENITY_API const void *CookedFile::getSectionData(Uint32 tag,
+                                                  size_t *bytesOut) const {
+  if (!pimpl_->data) return nullptr;
+  const CookedHeader *head = pimpl_->header();
+  for (Uint32 i = 0; i < head->sectionCount; ++i) {
+    const CookedSection &section = pimpl_->sections()[i];
+    if (section.tag == tag) {
+      *bytesOut = section.bytes;
+      return pimpl_->data + section.offset;
+    }
+  }
+  return nullptr;
+}
+
+struct CookedFileWriter::Impl {
+  struct Section {
+    Uint32 tag;
+    Vector<Uint8> data;
+  };
+
+  Uint32 type;
+  Vector<Section> sections;
+  String strings;
+  HashTable<String, Uint32> stringOffsets;
+};
+
+RENITY_API CookedFileWriter::CookedFileWriter(Uint32 type) {
+  pimpl_ = new Impl();
+  pimpl_->type = type;
+}
+
+RENITY_API CookedFileWriter::~CookedFileWriter() { delete pimpl_; }
+
+RENITY_API void CookedFileWriter::setType(Uint32 type) { pimpl_->type = type; }
+
+RENITY_API void CookedFileWriter::addSection(Uint32 tag, const void *data,
+                                             size_t bytes) {
+  const Uint8 *begin = (const Uint8 *)data;
+  for (auto &section : pimpl_->sections) {
+    if (section.tag == tag) {
+      section.data.assign(begin, begin + bytes);
+      return;
+    }
+  }
+  pimpl_->sections.push_back({tag, Vector<Uint8>(begin, begin + bytes)});
+}
+
+RENITY_API Uint32 CookedFileWriter::addString(const char *str) {
+  const String key(str ? str : "");
+  if (pimpl_->stringOffsets.exists(key)) {
+    return pimpl_->stringOffsets.get(key);
+  }
+  const Uint32 offset = (Uint32)pimpl_->strings.size();
+  pimpl_->strings.append(key.c_str(), key.size() + 1);
+  pimpl_->stringOffsets.put(key, offset);
+  return offset;
+}
+
+RENITY_API void CookedFileWriter::serialize(Vector<Uint8> &out) const {
+  Vector<const Impl::Section *> sections;
+  for (auto &section : pimpl_->sections) {
+    if (section.tag != COOKED_STRINGS) sections.push_back(&section);
+  }
+  Impl::Section strings = {
+      COOKED_STRINGS,
+      Vector<Uint8>(pimpl_->strings.begin(), pimpl_->strings.end())};
+  if (!strings.data.empty()) sections.push_back(&strings);
+
+  CookedHeader head;
+  SDL_memcpy(head.magic, COOKED_MAGIC, sizeof(COOKED_MAGIC));
+  head.version = COOKED_VERSION;
+  head.byteOrder = BYTE_ORDER_MARK;
+  head.type = pimpl_->type;
+  head.sectionCount = (Uint32)sections.size();
+
+  Vector<CookedSection> table;
+  size_t offset =
+      alignSection(sizeof(head) + sizeof(CookedSection) * sections.size());
+  for (auto section : sections) {
+    table.push_back(
+        {section->tag, (Uint32)offset, (Uint32)section->data.size(), 0});
+    offset = alignSection(offset + section->data.size());
+  }
+
+  out.assign(offset, 0);
+  SDL_memcpy(out.data(), &head, sizeof(head));
+  SDL_memcpy(out.data() + sizeof(head), table.data(),
+             sizeof(CookedSection) * table.size());
+  for (size_t i = 0; i < sections.size(); ++i) {
+    if (sections[i]->data.empty()) continue;
+    SDL_memcpy(out.data() + table[i].offset, sections[i]->data.data(),
+               sections[i]->data.size());
+  }
+}
+
+RENITY_API bool CookedFileWriter::save(const char *destPath) const {
+  Vector<Uint8> contents;
+  serialize(contents);
+  return RENITY_WriteBufferToPath(destPath, contents.data(),
+                                  (Uint32)contents.size()) ==
+         (Sint64)contents.size();
+}
+}  // namespace renity
@@ -11,185 +11,693 @@
 #include "Dictionary.h"
 
 #include <SDL3/SDL_log.h>
+#include <SDL3/SDL_mutex.h>
 #include <SDL3/SDL_stdinc.h>
 
 #include "3rdparty/duktape/duktape.h"
+#include "AsyncFileWriter.h"
+#include "DictionaryDOM.h"
+#include "DuktapeAllocator.h"
 #include "utils/rwops_utils.h"
 #include "utils/string_helpers.h"
 
 namespace renity {
+// A native equivalent of a Duktape stack entry
+struct DOMSelection {
+  const DOMNode *node;      // nullptr if the selected key doesn't exist
+  const DOMMember *member;  // Set when selected by Object key
+  Uint32 index;             // Otherwise, the selected Array index
+};
+
+static AtomicFlag8 nativeDecoding(1);
+
+/* Spare Duktape heaps. Creating one (with all its builtins) can cost more than
+ * decoding a typical asset, and most Dictionaries are short-lived temporaries
+ * in loaders, so their heaps get emptied and reused rather than destroyed.
+ * Spares give back their empty chunks first, and any that still hold more than
+ * MAX_SPARE_HEAP_BYTES afterwards aren't worth keeping.
+ */
+static const size_t MAX_SPARE_HEAPS = 8;
+static const size_t MAX_SPARE_HEAP_BYTES = 1 << 20;
+struct HeapPool {
+  SDL_Mutex *lock = SDL_CreateMutex();
+  Vector<duk_context *> heaps;
+};
+
+// Never destroyed, so static Dictionaries can still release heaps at exit
+static HeapPool &getHeapPool() {
+  static HeapPool *pool = new HeapPool();
+  return *pool;
+}
+
+static duk_context *acquireHeap() {
+  HeapPool &pool = getHeapPool();
+  duk_context *ctx = nullptr;
+  SDL_LockMutex(pool.lock);
+  if (!pool.heaps.empty()) {
+    ctx = pool.heaps.back();
+    pool.heaps.pop_back();
+  }
+  SDL_UnlockMutex(pool.lock);
+  if (!ctx) return DuktapeAllocator::createHeap();
+  DuktapeAllocator::get(ctx)->resetCounts();
+  return ctx;
+}
+
+// Scripted heaps may have altered builtins or the stash, so aren't reused
+static void releaseHeap(duk_context *ctx, bool reusable) {
+  if (reusable) {
+    // Dropping the only reference to the old global object frees it right away
+    DuktapeAllocator *allocator = DuktapeAllocator::get(ctx);
+    allocator->setLimit(0);
+    duk_set_top(ctx, 0);
+    duk_push_bare_object(ctx);
+    duk_set_global_object(ctx);
+    allocator->trim();
+    HeapPool &pool = getHeapPool();
+    SDL_LockMutex(pool.lock);
+    if (pool.heaps.size() < MAX_SPARE_HEAPS &&
+        allocator->getChunkBytes() <= MAX_SPARE_HEAP_BYTES) {
+      pool.heaps.push_back(ctx);
+      ctx = nullptr;
+    }
+    SDL_UnlockMutex(pool.lock);
+  }
+  if (ctx) DuktapeAllocator::destroyHeap(ctx);
+}
+
+static duk_uint_t clampUint(double n) {
+  if (!(n > 0.0)) return 0;
+  if (n >= 4294967295.0) return UINT32_MAX;
+  return (duk_uint_t)n;
+}
+
+static duk_int_t clampInt(double n) {
+  if (n != n) return 0;
+  if (n <= -2147483648.0) return INT32_MIN;
+  if (n >= 2147483647.0) return INT32_MAX;
+  return (duk_int_t)n;
+}
+
+// Array element conversions, matching the typed get()s
+template <typename T>
+static T toUint(double n) {
+  return (T)clampUint(n);
+}
+
+template <typename T>
+static T toInt(double n) {
+  return (T)clampInt(n);
+}
+
+template <typename T>
+static T toNumber(double n) {
+  return (T)n;
+}
+
 struct Dictionary::Impl {
-  Impl() {
-    ctx = duk_create_heap_default();
+  Impl()
+      : ctx(nullptr),
+        scripted(false),
+        dom(nullptr),
+        staged(nullptr),
+        heapLimit(0) {
+    reset();
+  }
+
+  ~Impl() {
+    delete staged;
+    destroyContext();
+    delete dom;
+  }
+
+  duk_context *ctx;    // Created once something needs to modify or script
+  bool scripted;       // Whether ctx has been handed out via getContext()
+  DictionaryDOM *dom;  // Native tree, if decoded natively
+  Vector<DOMSelection> selection;  // Selects into dom, until ctx exists
+  Impl *staged;  // Heap decoded by prepareLoad(), waiting on finishLoad()
+  size_t heapLimit;
+
+  void createContext() {
+    ctx = acquireHeap();
+    DuktapeAllocator::get(ctx)->setLimit(heapLimit);
     duk_push_bare_object(ctx);
     duk_set_global_object(ctx);
     duk_push_global_object(ctx);
   }
 
-  ~Impl() {
-    duk_set_top(ctx, 0);
-    duk_destroy_heap(ctx);
+  void destroyContext() {
+    if (!ctx) return;
+    releaseHeap(ctx, !scripted);
+    ctx = nullptr;
+    scripted = false;
   }
 
-  duk_context *ctx;
-};
+  // Start over with an empty object in whichever backend is preferred
+  void reset() {
+    destroyContext();
+    delete dom;
+    dom = nullptr;
+    selection.clear();
+    if (nativeDecoding) {
+      dom = new DictionaryDOM();
+      selection.push_back({dom->getRoot(), nullptr, 0});
+    } else {
+      createContext();
+    }
+  }
 
-RENITY_API Dictionary::Dictionary() { pimpl_ = new Impl(); }
+  void pushNode(const DOMNode &node) {
+    duk_require_stack(ctx, 2);
+    switch (node.type) {
+      case DOMType::Null:
+        duk_push_null(ctx);
+        break;
+      case DOMType::Boolean:
+        duk_push_boolean(ctx, node.boolean);
+        break;
+      case DOMType::Number:
+        duk_push_number(ctx, node.number);
+        break;
+      case DOMType::String:
+        duk_push_lstring(ctx, node.string, node.length);
+        break;
+      case DOMType::Bytes:
+        SDL_memcpy(duk_push_fixed_buffer(ctx, node.length), node.bytes,
+                   node.length);
+        break;
+      case DOMType::Array:
+        duk_push_array(ctx);
+        for (Uint32 i = 0; i < node.length; ++i) {
+          pushNode(node.items[i]);
+          duk_put_prop_index(ctx, -2, i);
+        }
+        break;
+      case DOMType::Object:
+        duk_push_object(ctx);
+        for (Uint32 i = 0; i < node.length; ++i) {
+          const DOMMember &member = node.members[i];
+          pushNode(member.value);
+          duk_put_prop_lstring(ctx, -2, member.key, member.keyLength);
+        }
+        break;
+    }
+  }
 
-RENITY_API Dictionary::~Dictionary() { delete this->pimpl_; }
+  // Encode the Dictionary (or the selection) as JSON or CBOR, and hand the
+  // encoding to write() before discarding it
+  bool encode(const char *caller, const char *destPath, bool json,
+              bool selectionOnly,
+              const FuncPtr<bool(const Uint8 *, size_t)> &write) {
+    // Encoders replace the stack top in-place with the encoded value, so we
+    // have to duplicate something, encode it, and then discard the encoding.
+    requireContext();
+    duk_require_stack(ctx, 1);
+    if (selectionOnly) {
+      if (!duk_is_object(ctx, -1)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Dictionary::%s: Tried to save a non-object/non-array "
+                     "to '%s'.\n",
+                     caller, destPath);
+        return false;
+      }
+      duk_dup_top(ctx);
+    } else {
+      duk_push_global_object(ctx);
+    }
 
-RENITY_API void Dictionary::load(SDL_RWops *src) {
-  // Delete the current object (whether a default one or a loaded one) by
-  // clearing the stack
-  duk_idx_t origTop = duk_get_top(pimpl_->ctx);
-  duk_set_top(pimpl_->ctx, 0);
-  duk_require_stack(pimpl_->ctx, 1);
-  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
-                 "Dictionary::load: Collapsed stack of %lu down to %lu.\n",
-                 origTop, duk_get_top(pimpl_->ctx));
+    try {
+      const Uint8 *buf;
+      duk_size_t bufLen;
+      if (json) {
+        buf = (const Uint8 *)duk_json_encode(ctx, -1);
+        bufLen = SDL_strlen((const char *)buf);
+      } else {
+        duk_cbor_encode(ctx, -1, 0);
+        buf = (const Uint8 *)duk_get_buffer_data(ctx, -1, &bufLen);
+      }
+      bool success = write(buf, bufLen);
+      duk_pop(ctx);
+      return success;
+    } catch (...) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Dictionary::%s: Error while encoding dictionary to '%s'.",
+                   caller, destPath);
+    }
+    return false;
+  }
 
-  char *buf;
-  Sint64 bufSize = RENITY_ReadCharBuffer(src, &buf);
-  if (bufSize < 1) {
-    SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
-                 "Dictionary::load: Invalid RWops (%s, error %li).\n",
-                 src ? "non-null" : "null", bufSize);
-    duk_push_bare_object(pimpl_->ctx);
-    duk_set_global_object(pimpl_->ctx);
-    duk_push_global_object(pimpl_->ctx);
-    return;
-  }
-
-  duk_push_external_buffer(pimpl_->ctx);
-  duk_config_buffer(pimpl_->ctx, -1, buf, bufSize);
-  try {
-    duk_cbor_decode(pimpl_->ctx, -1, 0);
-  } catch (const std::runtime_error &e) {
-    // Yes, we're continuing after an otherwise "fatal" Duktape error...
-    // However, it should be safe since we're doing simple operations, not
-    // executing Javascript, and know exactly what the context stack looks like.
+  // Convert the native tree into a Duktape heap, replaying any selects, so it
+  // can be modified or scripted. The tree itself is kept, since get() may have
+  // handed out pointers to its strings.
+  duk_context *requireContext() {
+    if (ctx) return ctx;
+    ctx = acquireHeap();
+    DuktapeAllocator::get(ctx)->setLimit(heapLimit);
+    pushNode(*dom->getRoot());
+    duk_set_global_object(ctx);
+    duk_push_global_object(ctx);
+    for (size_t i = 1; i < selection.size(); ++i) {
+      const DOMSelection &sel = selection[i];
+      duk_require_stack(ctx, 1);
+      if (!sel.node) {
+        duk_push_undefined(ctx);
+      } else if (sel.member) {
+        duk_get_prop_lstring(ctx, -1, sel.member->key, sel.member->keyLength);
+      } else {
+        duk_get_prop_index(ctx, -1, sel.index);
+      }
+    }
     SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
-                   "Dictionary::load: Failed to decode RWops as CBOR - "
-                   "attempting JSON decode at stack=%lu.\n",
-                   duk_get_top(pimpl_->ctx));
-    try {
-      duk_set_top(pimpl_->ctx, 0);
-      duk_require_stack(pimpl_->ctx, 1);
-      duk_push_lstring(pimpl_->ctx, (const char *)buf, bufSize);
-      duk_json_decode(pimpl_->ctx, -1);
+                   "Dictionary: Converted native tree to a Duktape heap at "
+                   "depth %lu.\n",
+                   selection.size() - 1);
+    selection.clear();
+    return ctx;
+  }
+
+  // Selection helpers that work with either backend
+  size_t depth() const {
+    return ctx ? duk_get_top(ctx) - 1 : selection.size() - 1;
+  }
+
+  void setDepth(size_t depth) {
+    if (ctx) {
+      duk_set_top(ctx, (duk_idx_t)depth + 1);
+    } else {
+      selection.resize(depth + 1);
+    }
+  }
+
+  void pushKey(const char *key, size_t length) {
+    if (ctx) {
+      duk_require_stack(ctx, 1);
+      duk_get_prop_lstring(ctx, -1, key, length);
+      return;
+    }
+    DOMSelection sel = {nullptr, nullptr, 0};
+    sel.node = top()->child(key, length, &sel.member, &sel.index);
+    selection.push_back(sel);
+  }
+
+  // Like pushKey(), but skips parsing keys that are array indices
+  void pushSegment(const DictionaryPath::Segment &segment) {
+    if (segment.isIndex && (ctx || isType(DOMType::Array))) {
+      pushIndex(segment.index);
+    } else {
+      pushKey(segment.key, segment.length);
+    }
+  }
+
+  // Store the stack top into the object below it, and select it again
+  void putSegment(const DictionaryPath::Segment &segment) {
+    if (segment.isIndex) {
+      duk_put_prop_index(ctx, -2, segment.index);
+      duk_get_prop_index(ctx, -1, segment.index);
+    } else {
+      duk_put_prop_lstring(ctx, -2, segment.key, segment.length);
+      duk_get_prop_lstring(ctx, -1, segment.key, segment.length);
+    }
+  }
+
+  bool pushIndex(Uint32 index) {
+    if (ctx) {
+      duk_require_stack(ctx, 1);
+      return !!duk_get_prop_index(ctx, -1, index);
+    }
+    DOMSelection sel = {nullptr, nullptr, index};
+    sel.node = top()->child(index, &sel.member);
+    selection.push_back(sel);
+    return !!sel.node;
+  }
+
+  // Accessors for the current selection, like their duk_*(ctx, -1) versions
+  const DOMNode *top() const { return selection.back().node; }
+
+  bool isType(DOMType type) const { return top() && top()->type == type; }
+
+  bool isObject() const {
+    return ctx ? !!duk_is_object(ctx, -1) : top() && top()->isContainer();
+  }
+
+  bool isArray() const {
+    return ctx ? !!duk_is_array(ctx, -1) : isType(DOMType::Array);
+  }
+
+  bool isBoolean() const {
+    return ctx ? !!duk_is_boolean(ctx, -1) : isType(DOMType::Boolean);
+  }
+
+  bool isString() const {
+    return ctx ? !!duk_is_string(ctx, -1) : isType(DOMType::String);
+  }
+
+  bool isNumber() const {
+    return ctx ? !!duk_is_number(ctx, -1) : isType(DOMType::Number);
+  }
+
+  bool isNullOrUndefined() const {
+    return ctx ? !!duk_is_null_or_undefined(ctx, -1)
+               : !top() || top()->type == DOMType::Null;
+  }
+
+  bool getBoolean() const {
+    return ctx ? !!duk_get_boolean(ctx, -1) : top()->boolean;
+  }
+
+  const char *getString() const {
+    return ctx ? duk_get_string(ctx, -1) : top()->string;
+  }
+
+  double getNumber() const {
+    return ctx ? duk_get_number(ctx, -1) : top()->number;
+  }
+
+  duk_uint_t getUint() const {
+    return ctx ? duk_get_uint(ctx, -1) : clampUint(top()->number);
+  }
+
+  duk_int_t getInt() const {
+    return ctx ? duk_get_int(ctx, -1) : clampInt(top()->number);
+  }
+
+  Uint32 getLength() const {
+    return ctx ? (Uint32)duk_get_length(ctx, -1) : top()->length;
+  }
+
+  // Convert the selected array (or byte string) in one go
+  template <typename T>
+  bool readArray(Vector<T> &valsOut, T (*convert)(double)) const {
+    valsOut.clear();
+    if (ctx) {
+      if (duk_is_array(ctx, -1)) {
+        valsOut.resize(duk_get_length(ctx, -1));
+        duk_require_stack(ctx, 1);
+        for (size_t i = 0; i < valsOut.size(); ++i) {
+          duk_get_prop_index(ctx, -1, (duk_uarridx_t)i);
+          if (duk_is_number(ctx, -1)) {
+            valsOut[i] = convert(duk_get_number(ctx, -1));
+          }
+          duk_pop(ctx);
+        }
+        return true;
+      }
+      if (duk_is_buffer_data(ctx, -1)) {
+        duk_size_t size;
+        const Uint8 *bytes = (const Uint8 *)duk_get_buffer_data(ctx, -1, &size);
+        valsOut.resize(size);
+        for (size_t i = 0; i < size; ++i) {
+          valsOut[i] = convert(bytes[i]);
+        }
+        return true;
+      }
+      return false;
+    }
+
+    const DOMNode *node = top();
+    if (!node) return false;
+    if (node->type == DOMType::Array) {
+      valsOut.resize(node->length);
+      for (Uint32 i = 0; i < node->length; ++i) {
+        const DOMNode &item = node->items[i];
+        if (item.type == DOMType::Number) valsOut[i] = convert(item.number);
+      }
+      return true;
+    }
+    if (node->type == DOMType::Bytes) {
+      valsOut.resize(node->elementCount());
+      for (Uint32 i = 0; i < valsOut.size(); ++i) {
+        valsOut[i] = convert(node->element(i));
+      }
+      return true;
+    }
+    return false;
+  }
+
+  template <typename T>
+  Span<const T> viewArray(Vector<T> &scratch, T (*convert)(double)) const {
+    // Typed arrays that already hold host-endian Ts can be used as-is, since
+    // the arena keeps them 8-byte aligned
+    const DOMNode *node = ctx ? nullptr : top();
+    if (node && node->type == DOMType::Bytes) {
+      const Uint8 tag = node->typedArrayTag;
+      const bool isUint8 = std::is_same<T, Uint8>::value;
+      const bool plainBytes = !tag || tag == CLAMPED_UINT8_ARRAY_TAG;
+      if (tag == typedArrayTag<T>() || (isUint8 && plainBytes)) {
+        return {(const T *)node->bytes, node->length / sizeof(T)};
+      }
+    }
+    readArray(scratch, convert);
+    return {scratch.data(), scratch.size()};
+  }
+
+  void decode(SDL_RWops *src) {
+    // Delete the current object (whether a default one or a loaded one)
+    reset();
+
+    // Mapped files can be decoded in-place, rather than copied out first
+    Sint64 bufSize = 0;
+    char *buf = (char *)RENITY_GetMappedBuffer(src, &bufSize);
+    SDL_RWops *mapped = buf ? src : nullptr;
+    if (!mapped) bufSize = RENITY_ReadCharBuffer(src, &buf);
+    auto release = [&]() {
+      if (mapped) {
+        SDL_RWclose(mapped);
+      } else {
+        SDL_free(buf);
+      }
+    };
+    if (bufSize < 1) {
+      SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
+                   "Dictionary::load: Invalid RWops (%s, error %li).\n",
+                   src ? "non-null" : "null", bufSize);
+      return;
+    }
+
+    if (dom) {
+      if (dom->decode(buf, (size_t)bufSize)) {
+        release();
+        if (dom->getRoot()->type != DOMType::Object) {
+          SDL_LogError(
+              SDL_LOG_CATEGORY_APPLICATION,
+              "Dictionary::load: Decoded file is an array or not an object - "
+              "replacing with empty object.\n");
+          dom->clear();
+        }
+        SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                       "Dictionary::load: Decoded RWops natively into %lu "
+                       "bytes.\n",
+                       dom->getArenaBytes());
+        return;
+      }
+
+      // Let Duktape have a go too, if only for consistent error handling
       SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
-                     "Dictionary::load: Decoded RWops as JSON at stack=%lu.\n",
-                     duk_get_top(pimpl_->ctx));
+                     "Dictionary::load: Failed to decode RWops natively - "
+                     "falling back to Duktape.\n");
+      delete dom;
+      dom = nullptr;
+      selection.clear();
+      createContext();
+    }
+
+    duk_set_top(ctx, 0);
+    duk_require_stack(ctx, 1);
+    duk_push_external_buffer(ctx);
+    duk_config_buffer(ctx, -1, buf, bufSize);
+    try {
+      duk_cbor_decode(ctx, -1, 0);
     } catch (const std::runtime_error &e) {
-      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                   "Dictionary::load: Failed to decode RWops as JSON or CBOR - "
-                   "falling through at stack=%lu.\n",
-                   duk_get_top(pimpl_->ctx));
+      // Yes, we're continuing after an otherwise "fatal" Duktape error...
+      // However, it should be safe since we're doing simple operations, not
+      // executing Javascript, and know exactly what the context stack looks
+      // like.
+      SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                     "Dictionary::load: Failed to decode RWops as CBOR - "
+                     "attempting JSON decode at stack=%lu.\n",
+                     duk_get_top(ctx));
+      try {
+        duk_set_top(ctx, 0);
+        duk_require_stack(ctx, 1);
+        duk_push_lstring(ctx, (const char *)buf, bufSize);
+        duk_json_decode(ctx, -1);
+        SDL_LogVerbose(
+            SDL_LOG_CATEGORY_APPLICATION,
+            "Dictionary::load: Decoded RWops as JSON at stack=%lu.\n",
+            duk_get_top(ctx));
+      } catch (const std::runtime_error &e) {
+        SDL_LogError(
+            SDL_LOG_CATEGORY_APPLICATION,
+            "Dictionary::load: Failed to decode RWops as JSON or CBOR - "
+            "falling through at stack=%lu.\n",
+            duk_get_top(ctx));
+      }
+    }
+    release();
+
+    if (duk_is_array(ctx, -1) || !duk_is_object(ctx, -1)) {
+      SDL_LogError(
+          SDL_LOG_CATEGORY_APPLICATION,
+          "Dictionary::load: Decoded file is an array or not an object - "
+          "replacing with empty object.\n");
+      duk_set_top(ctx, 0);
+      duk_require_stack(ctx, 1);
+      duk_push_bare_object(ctx);
     }
+
+    duk_set_global_object(ctx);
+    duk_push_global_object(ctx);
   }
-  SDL_free(buf);
+};
 
-  if (duk_is_array(pimpl_->ctx, -1) || !duk_is_object(pimpl_->ctx, -1)) {
-    SDL_LogError(
-        SDL_LOG_CATEGORY_APPLICATION,
-        "Dictionary::load: Decoded file is an array or not an object - "
-        "replacing with empty object.\n");
-    duk_set_top(pimpl_->ctx, 0);
-    duk_require_stack(pimpl_->ctx, 1);
-    duk_push_bare_object(pimpl_->ctx);
+RENITY_API Dictionary::Dictionary() { pimpl_ = new Impl(); }
+
+RENITY_API Dictionary::~Dictionary() { delete this->pimpl_; }
+
+RENITY_API void Dictionary::load(SDL_RWops *src) { pimpl_->decode(src); }
+
+RENITY_API size_t Dictionary::getCpuBytes() const {
+  size_t bytes = sizeof(Impl);
+  if (pimpl_->ctx) {
+    bytes += DuktapeAllocator::get(pimpl_->ctx)->getBytesInUse();
+  }
+  if (pimpl_->dom) bytes += pimpl_->dom->getArenaBytes();
+  return bytes;
+}
+
+RENITY_API void Dictionary::setNativeDecoding(bool enable) {
+  nativeDecoding = enable;
+}
+
+RENITY_API Dictionary::HeapStats Dictionary::getHeapStats() const {
+  HeapStats stats = {0, 0, 0};
+  if (pimpl_->ctx) {
+    const DuktapeAllocator *allocator = DuktapeAllocator::get(pimpl_->ctx);
+    stats.bytesInUse = allocator->getBytesInUse();
+    stats.peakBytes = allocator->getPeakBytes();
+    stats.allocations = allocator->getAllocCount();
   }
+  return stats;
+}
 
-  duk_set_global_object(pimpl_->ctx);
-  duk_push_global_object(pimpl_->ctx);
+RENITY_API void Dictionary::setHeapLimit(size_t maxBytes) {
+  pimpl_->heapLimit = maxBytes;
+  if (pimpl_->ctx) DuktapeAllocator::get(pimpl_->ctx)->setLimit(maxBytes);
+}
+
+RENITY_API bool Dictionary::prepareLoad(SDL_RWops *src) {
+  // Decode into a separate heap, so the current one stays usable meanwhile
+  delete pimpl_->staged;
+  pimpl_->staged = new Impl();
+  pimpl_->staged->decode(src);
+  return true;
+}
+
+RENITY_API void Dictionary::finishLoad() {
+  Impl *staged = pimpl_->staged;
+  if (!staged) return;
+  pimpl_->staged = nullptr;
+  staged->heapLimit = pimpl_->heapLimit;
+  if (staged->ctx) {
+    DuktapeAllocator::get(staged->ctx)->setLimit(staged->heapLimit);
+  }
+  delete pimpl_;
+  pimpl_ = staged;
+}
+
+// Whether save() and saveAsync() should use JSON for a path, or else CBOR
+static bool isJSONPath(const char *destPath) {
+  return endsWith(toLower(String(destPath)), String(".json"));
 }
 
 RENITY_API bool Dictionary::save(const char *destPath, bool selectionOnly) {
   if (!destPath) return false;
-  if (endsWith(toLower(String(destPath)), String(".json"))) {
+  if (isJSONPath(destPath)) {
     return saveJSON(destPath, selectionOnly);
   }
   return saveCBOR(destPath, selectionOnly);
 }
 
 RENITY_API bool Dictionary::saveJSON(const char *destPath, bool selectionOnly) {
-  // Encoders replace the stack top in-place with the encoded value, so we
-  // have to duplicate something, encode it, and then discard the encoding.
-  duk_require_stack(pimpl_->ctx, 1);
-  if (selectionOnly) {
-    if (!duk_is_object(pimpl_->ctx, -1)) {
-      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                   "Dictionary::saveJSON: Tried to save a non-object/non-array "
-                   "to '%s'.\n",
-                   destPath);
-      return false;
-    }
-    duk_dup_top(pimpl_->ctx);
-  } else {
-    duk_push_global_object(pimpl_->ctx);
-  }
-
-  try {
-    const char *buf = duk_json_encode(pimpl_->ctx, -1);
-    Uint32 bufLen = SDL_strlen(buf);
-    bool success = RENITY_WriteBufferToPath(destPath, (const Uint8 *)buf,
-                                            bufLen) == bufLen;
-    duk_pop(pimpl_->ctx);
-    return success;
-  } catch (...) {
-    SDL_LogError(
-        SDL_LOG_CATEGORY_APPLICATION,
-        "Dictionary::saveJSON: Error while encoding dictionary to '%s'.",
-        destPath);
-  }
-  return false;
+  return pimpl_->encode(
+      "saveJSON", destPath, true, selectionOnly,
+      [destPath](const Uint8 *buf, size_t bufLen) {
+        return (size_t)RENITY_WriteBufferToPath(destPath, buf, bufLen) ==
+               bufLen;
+      });
 }
 
 RENITY_API bool Dictionary::saveCBOR(const char *destPath, bool selectionOnly) {
-  // Encoders replace the stack top in-place with the encoded value, so we
-  // have to duplicate something, encode it, and then discard the encoding.
-  duk_require_stack(pimpl_->ctx, 1);
-  if (selectionOnly) {
-    if (!duk_is_object(pimpl_->ctx, -1)) {
-      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                   "Dictionary::saveCBOR: Tried to save a non-object/non-array "
-                   "to '%s'.\n",
-                   destPath);
-      return false;
-    }
-    duk_dup_top(pimpl_->ctx);
-  } else {
-    duk_push_global_object(pimpl_->ctx);
-  }
+  return pimpl_->encode(
+      "saveCBOR", destPath, false, selectionOnly,
+      [destPath](const Uint8 *buf, size_t bufLen) {
+        return (size_t)RENITY_WriteBufferToPath(destPath, buf, bufLen) ==
+               bufLen;
+      });
+}
 
-  try {
-    duk_cbor_encode(pimpl_->ctx, -1, 0);
-    duk_size_t bufLen;
-    const Uint8 *buf =
-        (const Uint8 *)duk_get_buffer_data(pimpl_->ctx, -1, &bufLen);
-    bool success =
-        (duk_size_t)RENITY_WriteBufferToPath(destPath, buf, bufLen) == bufLen;
-    duk_pop(pimpl_->ctx);
-    return success;
-  } catch (...) {
-    SDL_LogError(
-        SDL_LOG_CATEGORY_APPLICATION,
-        "Dictionary::saveCBOR: Error while encoding dictionary to '%s'.",
-        destPath);
-  }
-  return false;
+RENITY_API bool Dictionary::saveAsync(const char *destPath,
+                                      bool selectionOnly) {
+  if (!destPath) return false;
+  return pimpl_->encode("saveAsync", destPath, isJSONPath(destPath),
+                        selectionOnly,
+                        [destPath](const Uint8 *buf, size_t bufLen) {
+                          return AsyncFileWriter::queue(
+                              destPath, Vector<Uint8>(buf, buf + bufLen));
+                        });
+}
+
+RENITY_API void Dictionary::flushSaves() { AsyncFileWriter::flush(); }
+
+RENITY_API Uint64 Dictionary::getSavesWritten() {
+  return AsyncFileWriter::getWriteCount();
 }
 
 RENITY_API size_t Dictionary::select(const char *path, bool autoCreate,
                                      bool loadValue) {
+  // Only plain lookups can be done in the native tree
+  if (autoCreate || !loadValue) pimpl_->requireContext();
   SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
                  "Dictionary::select: %lu deep before selecting '%s'.\n",
-                 duk_get_top(pimpl_->ctx) - 1, path);
+                 pimpl_->depth(), path);
 
   // Short-circuit on invalid path or if an edge value is already selected -
   // caller needs to unwind or otherwise handle this themselves.
-  if (!path || !duk_is_object(pimpl_->ctx, -1)) return 0;
+  if (!path || !pimpl_->isObject()) return 0;
 
   const char separator = '.';
+  if (!pimpl_->ctx) {
+    // Walk the tree in-place, without copying out each path segment
+    size_t depth = 0;
+    const char *token = path;
+    for (;;) {
+      const char *sep = SDL_strchr(token, separator);
+      const size_t length = sep ? (size_t)(sep - token) : SDL_strlen(token);
+      if (sep && !length) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Dictionary::select: Invalid path '%s' at index %li.\n",
+                     path, sep - path);
+        unwind(depth);
+        return 0;
+      }
+      pimpl_->pushKey(token, length);
+      ++depth;
+      if (!sep) break;
+      if (!pimpl_->isObject()) {
+        SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                       "Dictionary::select: Not autocreating missing subkey "
+                       "%.*s of '%s'.\n",
+                       (int)length, token, path);
+        unwind(depth);
+        return 0;
+      }
+      token = sep + 1;
+    }
+    SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                   "Dictionary::select: '%s' -> %u deep.\n", path, depth);
+    return depth;
+  }
+
   String key(path);
   String token(path);
   size_t pos = key.find(separator), lastPos = 0, depth = 0;
@@ -247,19 +755,71 @@ RENITY_API size_t Dictionary::select(const char *path, bool autoCreate,
   return ++depth;
 }
 
+RENITY_API size_t Dictionary::select(const DictionaryPath &path,
+                                     bool autoCreate, bool loadValue) {
+  if (autoCreate || !loadValue) pimpl_->requireContext();
+  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                 "Dictionary::select: %lu deep before selecting '%s'.\n",
+                 pimpl_->depth(), path.c_str());
+
+  // Short-circuit on invalid path or if an edge value is already selected -
+  // caller needs to unwind or otherwise handle this themselves.
+  const size_t segments = path.size();
+  if (!segments || !pimpl_->isObject()) return 0;
+
+  size_t depth = 0;
+  for (; depth < segments - 1; ++depth) {
+    pimpl_->pushSegment(path[depth]);
+    if (pimpl_->isObject()) continue;
+    if (!autoCreate) {
+      SDL_LogVerbose(
+          SDL_LOG_CATEGORY_APPLICATION,
+          "Dictionary::select: Not autocreating missing subkey %s of '%s'.\n",
+          path[depth].key, path.c_str());
+      unwind(depth + 1);
+      return 0;
+    }
+    duk_pop(pimpl_->ctx);
+    duk_push_bare_object(pimpl_->ctx);
+    pimpl_->putSegment(path[depth]);
+  }
+
+  const DictionaryPath::Segment &edge = path[depth];
+  if (loadValue) {
+    pimpl_->pushSegment(edge);
+    if (autoCreate && duk_is_undefined(pimpl_->ctx, -1)) {
+      SDL_LogVerbose(
+          SDL_LOG_CATEGORY_APPLICATION,
+          "Dictionary::select: Autocreating edge subkey %s of '%s'.\n",
+          edge.key, path.c_str());
+      duk_pop(pimpl_->ctx);
+      duk_push_bare_object(pimpl_->ctx);
+      pimpl_->putSegment(edge);
+    }
+  } else {
+    duk_require_stack(pimpl_->ctx, 1);
+    duk_push_lstring(pimpl_->ctx, edge.key, edge.length);
+  }
+
+  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                 "Dictionary::select: '%s' -> %u deep.\n", path.c_str(),
+                 depth + 1);
+  return ++depth;
+}
+
 RENITY_API size_t Dictionary::selectIndex(Uint32 index, bool autoCreate) {
+  if (autoCreate) pimpl_->requireContext();
   SDL_LogVerbose(
       SDL_LOG_CATEGORY_APPLICATION,
       "Dictionary::select: %lu deep past obj before selecting idx %lu.\n",
-      duk_get_top(pimpl_->ctx) - 1, index);
+      pimpl_->depth(), index);
 
   // Short-circuit if an edge value is already selected -
   // caller needs to unwind or replace it with an object first
-  if (!duk_is_object(pimpl_->ctx, -1)) return 0;
+  if (!pimpl_->isObject()) return 0;
 
-  duk_require_stack(pimpl_->ctx, 1);
-  if (duk_get_prop_index(pimpl_->ctx, -1, index)) return 1;
-  duk_pop(pimpl_->ctx);
+  if (pimpl_->pushIndex(index)) return 1;
+  pimpl_->setDepth(pimpl_->depth() - 1);
   if (!autoCreate) return 0;
   duk_push_bare_object(pimpl_->ctx);
   duk_put_prop_index(pimpl_->ctx, -2, index);
@@ -268,25 +828,21 @@ RENITY_API size_t Dictionary::selectIndex(Uint32 index, bool autoCreate) {
 
 RENITY_API void Dictionary::unwind(size_t depth) {
   // The base object should always be the first item on the stack
-  const size_t maxDepth = duk_get_top(pimpl_->ctx) - 1;
+  const size_t maxDepth = pimpl_->depth();
   SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION, "Dictionary::unwind: %u - %u\n",
                  maxDepth, depth);
 
   // Short-circuit for e.g. invalid selects
   if (depth == 0) return;
 
-  if (depth >= maxDepth) {
-    // Clear the stack down to the base object, unwinding all selects
-    duk_set_top(pimpl_->ctx, 1);
-  } else {
-    duk_set_top(pimpl_->ctx, -(duk_idx_t)depth);
-  }
+  // Clear the stack down to the base object at most, unwinding all selects
+  pimpl_->setDepth(depth >= maxDepth ? 0 : maxDepth - depth);
 }
 
 RENITY_API Uint32 Dictionary::begin(const char *key) {
   Uint32 index = 0;
   size_t depth = select(key, false, true);
-  if (!duk_is_array(pimpl_->ctx, -1)) {
+  if (!pimpl_->isArray()) {
     SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
                  "Dictionary::begin: Selection is not an Array\n");
     index = UINT32_MAX;
@@ -298,8 +854,8 @@ RENITY_API Uint32 Dictionary::begin(const char *key) {
 RENITY_API Uint32 Dictionary::end(const char *key) {
   Uint32 index = UINT32_MAX;
   size_t depth = select(key, false, true);
-  if (duk_is_array(pimpl_->ctx, -1)) {
-    index = duk_get_length(pimpl_->ctx, -1);
+  if (pimpl_->isArray()) {
+    index = pimpl_->getLength();
   } else {
     SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
                  "Dictionary::end: Selection is not an Array\n");
@@ -310,7 +866,7 @@ RENITY_API Uint32 Dictionary::end(const char *key) {
 
 RENITY_API bool Dictionary::isArray(const char *path) {
   size_t depth = select(path, false, true);
-  bool isArray = !!duk_is_array(pimpl_->ctx, -1);
+  bool isArray = pimpl_->isArray();
   unwind(depth);
   return isArray;
 }
@@ -320,7 +876,7 @@ RENITY_API Uint32 Dictionary::enumerate(
     const FuncPtr<bool(Dictionary &, const String &)> &callback) {
   Uint32 props = 0;
   const size_t selectDepth = select(path, false, true);
-  if ((path && !selectDepth) || !duk_is_object(pimpl_->ctx, -1)) {
+  if ((path && !selectDepth) || !pimpl_->isObject()) {
     SDL_LogError(
         SDL_LOG_CATEGORY_APPLICATION,
         "Dictionary::enumerate: Could not enumerate a non-object in '%s'.\n",
@@ -329,6 +885,57 @@ RENITY_API Uint32 Dictionary::enumerate(
     return 0;
   }
 
+  if (!pimpl_->ctx) {
+    // Walk the tree directly; this keeps working even if the callback
+    // converts to a Duktape heap, since the tree outlives that
+    const DOMNode *node = pimpl_->top();
+    const Uint32 count = node->type == DOMType::Bytes ? 0 : node->length;
+    const size_t enumDepth = pimpl_->depth();
+    bool keepGoing = true;
+    for (Uint32 i = 0; keepGoing && i < count; ++i) {
+      String key;
+      if (node->type == DOMType::Object) {
+        // Skip keys overridden by a later duplicate, like a JS object would
+        const DOMMember &member = node->members[i];
+        if (node->child(member.key, member.keyLength) != &member.value) {
+          continue;
+        }
+        key.assign(member.key, member.keyLength);
+        pimpl_->pushKey(member.key, member.keyLength);
+      } else {
+        char index[12];
+        SDL_snprintf(index, sizeof(index), "%u", i);
+        key = index;
+        pimpl_->pushIndex(i);
+      }
+
+      if (pimpl_->isNullOrUndefined()) {
+        pimpl_->setDepth(enumDepth);
+        continue;
+      }
+      keepGoing = callback(*this, key);
+      ++props;
+
+      // Bail out if the callback was naughty and unwound past its start point
+      const size_t currentDepth = pimpl_->depth();
+      if (currentDepth < enumDepth) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Dictionary::enumerate: Callback unwound past :%lu to "
+                    ":%lu - cancelling enumeration.\n",
+                    enumDepth, currentDepth);
+        const size_t origDepth = enumDepth - selectDepth;
+        if (currentDepth > origDepth) pimpl_->setDepth(origDepth);
+        return props;
+      }
+      pimpl_->setDepth(enumDepth);
+    }
+    unwind(selectDepth);
+    SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                   "Dictionary::enumerate: Finished after %lu native props.\n",
+                   props);
+    return props;
+  }
+
   duk_require_stack(pimpl_->ctx, 3);
   duk_enum(pimpl_->ctx, -1, DUK_ENUM_OWN_PROPERTIES_ONLY);
 
@@ -392,7 +999,7 @@ RENITY_API Uint32 Dictionary::enumerateArray(
     const FuncPtr<bool(Dictionary &, const Uint32 &)> &callback) {
   Uint32 props = 0;
   const size_t selectDepth = select(path, false, true);
-  if ((path && !selectDepth) || !duk_is_object(pimpl_->ctx, -1)) {
+  if ((path && !selectDepth) || !pimpl_->isObject()) {
     SDL_LogError(
         SDL_LOG_CATEGORY_APPLICATION,
         "Dictionary::enumerateArray: Could not enumerate a non-indexable "
@@ -402,6 +1009,55 @@ RENITY_API Uint32 Dictionary::enumerateArray(
     return 0;
   }
 
+  if (!pimpl_->ctx) {
+    // Walk the tree directly; this keeps working even if the callback
+    // converts to a Duktape heap, since the tree outlives that
+    const DOMNode *node = pimpl_->top();
+    const Uint32 count = node->type == DOMType::Bytes ? 0 : node->length;
+    const size_t enumDepth = pimpl_->depth();
+    bool keepGoing = true;
+    for (Uint32 i = 0; keepGoing && i < count; ++i) {
+      Uint32 key = i;
+      if (node->type == DOMType::Object) {
+        // Only take index-like keys, skipping any overridden by a duplicate
+        const DOMMember &member = node->members[i];
+        if (!parseArrayIndex(member.key, member.keyLength, &key) ||
+            node->child(member.key, member.keyLength) != &member.value) {
+          continue;
+        }
+        pimpl_->pushKey(member.key, member.keyLength);
+      } else {
+        pimpl_->pushIndex(i);
+      }
+
+      if (pimpl_->isNullOrUndefined()) {
+        pimpl_->setDepth(enumDepth);
+        continue;
+      }
+      keepGoing = callback(*this, key);
+      ++props;
+
+      // Bail out if the callback was naughty and unwound past its start point
+      const size_t currentDepth = pimpl_->depth();
+      if (currentDepth < enumDepth) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Dictionary::enumerateArray: Callback unwound past :%lu "
+                    "to :%lu - cancelling enumeration.\n",
+                    enumDepth, currentDepth);
+        const size_t origDepth = enumDepth - selectDepth;
+        if (currentDepth > origDepth) pimpl_->setDepth(origDepth);
+        return props;
+      }
+      pimpl_->setDepth(enumDepth);
+    }
+    unwind(selectDepth);
+    SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                   "Dictionary::enumerateArray: Finished after %lu native "
+                   "props.\n",
+                   props);
+    return props;
+  }
+
   duk_require_stack(pimpl_->ctx, 3);
   duk_enum(pimpl_->ctx, -1,
            DUK_ENUM_OWN_PROPERTIES_ONLY | DUK_ENUM_ARRAY_INDICES_ONLY);
@@ -498,13 +1154,16 @@ RENITY_API bool Dictionary::putObject(const char *key) {
 }
 */
 
-RENITY_API duk_context *Dictionary::getContext() { return pimpl_->ctx; }
+RENITY_API duk_context *Dictionary::getContext() {
+  pimpl_->scripted = true;
+  return pimpl_->requireContext();
+}
 
-#define DICT_IMPL_BASE(T, dukExt, dukInt, printSpec, printAdd)                \
+#define DICT_IMPL_BASE(T, dukExt, getter, checker, printSpec, printAdd)       \
   template <>                                                                 \
   RENITY_API bool Dictionary::get<T>(const char *key, T *valOut) {            \
     size_t depth = select(key, false, true);                                  \
-    if (!duk_is_##dukInt(pimpl_->ctx, -1)) {                                  \
+    if (!pimpl_->is##checker()) {                                             \
       SDL_LogDebug(                                                           \
           SDL_LOG_CATEGORY_APPLICATION,                                       \
           "Dictionary::get: Key or correct-type value not found for '%s'\n",  \
@@ -513,7 +1172,7 @@ RENITY_API duk_context *Dictionary::getContext() { return pimpl_->ctx; }
       return false;                                                           \
     }                                                                         \
     if (valOut) {                                                             \
-      *valOut = (T)duk_get_##dukExt(pimpl_->ctx, -1);                         \
+      *valOut = (T)pimpl_->get##getter();                                     \
       SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,                            \
                      "Dictionary::get: '%s': " printSpec "\n", key,           \
                      *valOut printAdd);                                       \
@@ -523,9 +1182,30 @@ RENITY_API duk_context *Dictionary::getContext() { return pimpl_->ctx; }
   }                                                                           \
                                                                               \
   template <>                                                                 \
+  RENITY_API bool Dictionary::get<T>(const DictionaryPath &path, T *valOut) { \
+    size_t depth = select(path, false, true);                                 \
+    if (!depth || !pimpl_->is##checker()) {                                   \
+      SDL_LogDebug(                                                           \
+          SDL_LOG_CATEGORY_APPLICATION,                                       \
+          "Dictionary::get: Key or correct-type value not found for '%s'\n",  \
+          path.c_str());                                                      \
+      unwind(depth);                                                          \
+      return false;                                                           \
+    }                                                                         \
+    if (valOut) {                                                             \
+      *valOut = (T)pimpl_->get##getter();                                     \
+      SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,                            \
+                     "Dictionary::get: '%s': " printSpec "\n", path.c_str(),  \
+                     *valOut printAdd);                                       \
+    }                                                                         \
+    unwind(depth);                                                            \
+    return true;                                                              \
+  }                                                                           \
+                                                                              \
+  template <>                                                                 \
   RENITY_API bool Dictionary::getIndex<T>(Uint32 index, T * valOut) {         \
     size_t depth = selectIndex(index, false);                                 \
-    if (!depth || !duk_is_##dukInt(pimpl_->ctx, -1)) {                        \
+    if (!depth || !pimpl_->is##checker()) {                                   \
       SDL_LogDebug(                                                           \
           SDL_LOG_CATEGORY_APPLICATION,                                       \
           "Dictionary::get: Correct-type value not found at index %u\n",      \
@@ -534,7 +1214,7 @@ RENITY_API duk_context *Dictionary::getContext() { return pimpl_->ctx; }
       return false;                                                           \
     }                                                                         \
     if (valOut) {                                                             \
-      *valOut = (T)duk_get_##dukExt(pimpl_->ctx, -1);                         \
+      *valOut = (T)pimpl_->get##getter();                                     \
       SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,                            \
                      "Dictionary::get: [%u]: " printSpec "\n", index,         \
                      *valOut printAdd);                                       \
@@ -545,6 +1225,7 @@ RENITY_API duk_context *Dictionary::getContext() { return pimpl_->ctx; }
                                                                               \
   template <>                                                                 \
   RENITY_API bool Dictionary::push<T>(T val) {                                \
+    pimpl_->requireContext();                                                 \
     if (!duk_is_object(pimpl_->ctx, -1)) {                                    \
       SDL_LogError(                                                           \
           SDL_LOG_CATEGORY_APPLICATION,                                       \
@@ -562,6 +1243,7 @@ RENITY_API duk_context *Dictionary::getContext() { return pimpl_->ctx; }
                                                                               \
   template <>                                                                 \
   RENITY_API bool Dictionary::pop<T>(T * valOut) {                            \
+    pimpl_->requireContext();                                                 \
     if (!duk_is_object(pimpl_->ctx, -1)) {                                    \
       SDL_LogError(                                                           \
           SDL_LOG_CATEGORY_APPLICATION,                                       \
@@ -569,7 +1251,7 @@ RENITY_API duk_context *Dictionary::getContext() { return pimpl_->ctx; }
       return false;                                                           \
     }                                                                         \
     if (!duk_get_prop_index(pimpl_->ctx, -1, -1) ||                           \
-        !duk_is_##dukInt(pimpl_->ctx, -1)) {                                  \
+        !pimpl_->is##checker()) {                                             \
       SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,                              \
                    "Dictionary::pop: Correct-type value not found at end of " \
                    "current selection");                                      \
@@ -577,7 +1259,7 @@ RENITY_API duk_context *Dictionary::getContext() { return pimpl_->ctx; }
       return false;                                                           \
     }                                                                         \
     if (valOut) {                                                             \
-      *valOut = (T)duk_get_##dukExt(pimpl_->ctx, -1);                         \
+      *valOut = (T)pimpl_->get##getter();                                     \
       SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,                            \
                      "Dictionary::pop: " printSpec "\n", *valOut printAdd);   \
     }                                                                         \
@@ -603,10 +1285,27 @@ RENITY_API duk_context *Dictionary::getContext() { return pimpl_->ctx; }
   }                                                                           \
                                                                               \
   template <>                                                                 \
+  RENITY_API bool Dictionary::put<T>(const DictionaryPath &path, T val) {     \
+    size_t depth = select(path, true, false);                                 \
+    SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,                              \
+                   "Dictionary::put: '%s' (%lu)=" printSpec "\n",             \
+                   path.c_str(), depth, val printAdd);                        \
+    if (!depth) {                                                             \
+      return false;                                                           \
+    }                                                                         \
+    duk_require_stack(pimpl_->ctx, 1);                                        \
+    duk_push_##dukExt(pimpl_->ctx, val);                                      \
+    duk_bool_t success = duk_put_prop(pimpl_->ctx, -3);                       \
+    unwind(depth - 1);                                                        \
+    return !!success;                                                         \
+  }                                                                           \
+                                                                              \
+  template <>                                                                 \
   RENITY_API bool Dictionary::putIndex<T>(Uint32 index, T val) {              \
     SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,                              \
                    "Dictionary::put: [%u]=" printSpec "\n", index,            \
                    val printAdd);                                             \
+    pimpl_->requireContext();                                                 \
     if (!duk_is_object(pimpl_->ctx, -1)) {                                    \
       SDL_LogError(                                                           \
           SDL_LOG_CATEGORY_APPLICATION,                                       \
@@ -617,20 +1316,55 @@ RENITY_API duk_context *Dictionary::getContext() { return pimpl_->ctx; }
     duk_push_##dukExt(pimpl_->ctx, val);                                      \
     return !!duk_put_prop_index(pimpl_->ctx, -2, index);                      \
   }
-#define DICT_IMPL(T, dukExt, dukInt, printSpec) \
-  DICT_IMPL_BASE(T, dukExt, dukInt, printSpec, )
+#define DICT_IMPL(T, dukExt, getter, checker, printSpec) \
+  DICT_IMPL_BASE(T, dukExt, getter, checker, printSpec, )
+
+#define DICT_ARRAY_IMPL(T, getter)                                            \
+  template <>                                                                 \
+  RENITY_API bool Dictionary::getArray<T>(const char *path,                   \
+                                          Vector<T> &valsOut) {               \
+    valsOut.clear();                                                          \
+    size_t depth = select(path, false, true);                                 \
+    bool found = false;                                                       \
+    if (!path || depth) found = pimpl_->readArray(valsOut, &to##getter<T>);   \
+    unwind(depth);                                                            \
+    return found;                                                             \
+  }                                                                           \
+                                                                              \
+  template <>                                                                 \
+  RENITY_API Span<const T> Dictionary::getArraySpan<T>(const char *path,      \
+                                                       Vector<T> &scratch) {  \
+    size_t depth = select(path, false, true);                                 \
+    Span<const T> vals;                                                       \
+    if (!path || depth) vals = pimpl_->viewArray(scratch, &to##getter<T>);    \
+    unwind(depth);                                                            \
+    return vals;                                                              \
+  }
 
 // Supported dictionary/duktape types
-DICT_IMPL_BASE(bool, boolean, boolean, "%s", ? "true" : "false")
-DICT_IMPL(const char *, string, string, "%s")
-DICT_IMPL(Uint8, uint, number, "%u")
-DICT_IMPL(Uint16, uint, number, "%u")
-DICT_IMPL(Uint32, uint, number, "%u")
-DICT_IMPL(Uint64, uint, number, "%u")
-DICT_IMPL(Sint8, int, number, "%i")
-DICT_IMPL(Sint16, int, number, "%i")
-DICT_IMPL(Sint32, int, number, "%i")
-DICT_IMPL(Sint64, int, number, "%li")
-DICT_IMPL(float, number, number, "%f")
-DICT_IMPL(double, number, number, "%f")
+DICT_IMPL_BASE(bool, boolean, Boolean, Boolean, "%s", ? "true" : "false")
+DICT_IMPL(const char *, string, String, String, "%s")
+DICT_IMPL(Uint8, uint, Uint, Number, "%u")
+DICT_IMPL(Uint16, uint, Uint, Number, "%u")
+DICT_IMPL(Uint32, uint, Uint, Number, "%u")
+DICT_IMPL(Uint64, uint, Uint, Number, "%u")
+DICT_IMPL(Sint8, int, Int, Number, "%i")
+DICT_IMPL(Sint16, int, Int, Number, "%i")
+DICT_IMPL(Sint32, int, Int, Number, "%i")
+DICT_IMPL(Sint64, int, Int, Number, "%li")
+DICT_IMPL(float, number, Number, Number, "%f")
+DICT_IMPL(double, number, Number, Number, "%f")
+
+// Supported numeric array types
+DICT_ARRAY_IMPL(Uint8, Uint)
+DICT_ARRAY_IMPL(Uint16, Uint)
+DICT_ARRAY_IMPL(Uint32, Uint)
+DICT_ARRAY_IMPL(Uint64, Uint)
+DICT_ARRAY_IMPL(Sint8, Int)
+DICT_ARRAY_IMPL(Sint16, Int)
+DICT_ARRAY_IMPL(Sint32, Int)
+DICT_ARRAY_IMPL(Sint64, Int)
+DICT_ARRAY_IMPL(float, Number)
+DICT_ARRAY_IMPL(double, Number)
 }  // namespace renity
+
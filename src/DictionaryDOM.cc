@@ -0,0 +1,730 @@
+/****************************************************
+ * DictionaryDOM.cc: Native JSON/CBOR document tree *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+
+#include "DictionaryDOM.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include <cmath>
+
+namespace renity {
+// Nesting limit, so hostile files can't overflow the stack
+static const int MAX_DEPTH = 512;
+static const size_t MIN_BLOCK_SIZE = 4096;
+
+static double halfToDouble(Uint16 half) {
+  const int exponent = (half >> 10) & 0x1f;
+  const double mantissa = half & 0x3ff;
+  double val;
+  if (exponent == 0) {
+    val = SDL_scalbn(mantissa, -24);
+  } else if (exponent == 31) {
+    val = mantissa == 0 ? INFINITY : NAN;
+  } else {
+    val = SDL_scalbn(mantissa + 1024, exponent - 25);
+  }
+  return (half & 0x8000) ? -val : val;
+}
+
+static inline bool isDigit(Uint8 c) { return c >= '0' && c <= '9'; }
+
+bool parseArrayIndex(const char *key, size_t keyLength, Uint32 *indexOut) {
+  if (keyLength == 0 || keyLength > 10) return false;
+  if (key[0] == '0' && keyLength > 1) return false;
+  Uint64 index = 0;
+  for (size_t i = 0; i < keyLength; ++i) {
+    if (!isDigit(key[i])) return false;
+    index = index * 10 + (key[i] - '0');
+  }
+  // 2^32 - 1 is a plain property name in JS, not an array index
+  if (index >= UINT32_MAX) return false;
+  *indexOut = (Uint32)index;
+  return true;
+}
+
+const DOMNode *DOMNode::child(const char *key, size_t keyLength,
+                              const DOMMember **memberOut,
+                              Uint32 *indexOut) const {
+  if (type == DOMType::Object) {
+    for (Uint32 i = length; i > 0; --i) {
+      const DOMMember &member = members[i - 1];
+      if (member.keyLength == keyLength &&
+          SDL_memcmp(member.key, key, keyLength) == 0) {
+        if (memberOut) *memberOut = &member;
+        return &member.value;
+      }
+    }
+    return nullptr;
+  }
+
+  Uint32 index;
+  if (type == DOMType::Array && parseArrayIndex(key, keyLength, &index) &&
+      index < length) {
+    if (memberOut) *memberOut = nullptr;
+    if (indexOut) *indexOut = index;
+    return &items[index];
+  }
+  return nullptr;
+}
+
+const DOMNode *DOMNode::child(Uint32 index,
+                              const DOMMember **memberOut) const {
+  if (type == DOMType::Array) {
+    if (index >= length) return nullptr;
+    if (memberOut) *memberOut = nullptr;
+    return &items[index];
+  }
+  if (type == DOMType::Object) {
+    char key[12];
+    const int keyLength = SDL_snprintf(key, sizeof(key), "%u", index);
+    return child(key, keyLength, memberOut);
+  }
+  return nullptr;
+}
+
+// Bytes per element for a typed array tag
+static size_t elementSize(Uint8 tag) {
+  return (tag & 0x10) ? (size_t)2 << (tag & 0x03) : (size_t)1 << (tag & 0x03);
+}
+
+Uint32 DOMNode::elementCount() const {
+  if (type != DOMType::Bytes) return 0;
+  return typedArrayTag ? length / (Uint32)elementSize(typedArrayTag) : length;
+}
+
+double DOMNode::element(Uint32 index) const {
+  if (!typedArrayTag) return bytes[index];
+
+  const size_t size = elementSize(typedArrayTag);
+  const Uint8 *src = bytes + index * size;
+  Uint64 raw = 0;
+  for (size_t i = 0; i < size; ++i) {
+    const size_t byte = (typedArrayTag & 0x04) ? i : size - 1 - i;
+    raw |= (Uint64)src[i] << (byte * 8);
+  }
+
+  if (typedArrayTag & 0x10) {
+    if (size == 2) return halfToDouble((Uint16)raw);
+    if (size == 4) {
+      const Uint32 raw32 = (Uint32)raw;
+      float val;
+      SDL_memcpy(&val, &raw32, sizeof(val));
+      return val;
+    }
+    double val;
+    SDL_memcpy(&val, &raw, sizeof(val));
+    return val;
+  }
+  if ((typedArrayTag & 0x08) && size < 8) {
+    // Sign-extend from the element size
+    const Uint64 signBit = (Uint64)1 << (size * 8 - 1);
+    return (double)(Sint64)((raw ^ signBit) - signBit);
+  }
+  return (typedArrayTag & 0x08) ? (double)(Sint64)raw : (double)raw;
+}
+
+/** Recursive-descent decoder that fills a DictionaryDOM arena.
+ * Children are gathered on scratch stacks and copied out once their container
+ * closes, so each Array/Object ends up as one contiguous arena allocation.
+ */
+struct DOMParser {
+  DOMParser(DictionaryDOM &target, const char *buf, size_t size)
+      : dom(target),
+        start((const Uint8 *)buf),
+        pos(start),
+        end(start + size) {}
+
+  DictionaryDOM &dom;
+  const Uint8 *start, *pos, *end;
+  Vector<DOMNode> items;      // Children of unfinished Arrays
+  Vector<DOMMember> members;  // Children of unfinished Objects
+  String text;                // Scratch for escaped or chunked strings
+
+  void rewind() {
+    pos = start;
+    items.clear();
+    members.clear();
+  }
+
+  bool finishArray(DOMNode &out, size_t first) {
+    out.type = DOMType::Array;
+    out.length = (Uint32)(items.size() - first);
+    DOMNode *copy = (DOMNode *)dom.allocate(sizeof(DOMNode) * out.length);
+    if (out.length) {
+      if (!copy) return false;
+      SDL_memcpy(copy, &items[first], sizeof(DOMNode) * out.length);
+    }
+    items.resize(first);
+    out.items = copy;
+    return true;
+  }
+
+  bool finishObject(DOMNode &out, size_t first) {
+    out.type = DOMType::Object;
+    out.length = (Uint32)(members.size() - first);
+    DOMMember *copy =
+        (DOMMember *)dom.allocate(sizeof(DOMMember) * out.length);
+    if (out.length) {
+      if (!copy) return false;
+      SDL_memcpy(copy, &members[first], sizeof(DOMMember) * out.length);
+    }
+    members.resize(first);
+    out.members = copy;
+    return true;
+  }
+
+  bool setString(DOMNode &out, const char *str, size_t length) {
+    out.type = DOMType::String;
+    out.length = (Uint32)length;
+    out.string = dom.copyString(str, length);
+    return out.string != nullptr;
+  }
+
+  // --- CBOR (RFC 8949) ---
+
+  bool readCBORArgument(Uint8 info, Uint64 *valOut) {
+    if (info < 24) {
+      *valOut = info;
+      return true;
+    }
+    size_t bytes;
+    switch (info) {
+      case 24:
+        bytes = 1;
+        break;
+      case 25:
+        bytes = 2;
+        break;
+      case 26:
+        bytes = 4;
+        break;
+      case 27:
+        bytes = 8;
+        break;
+      default:
+        return false;
+    }
+    if ((size_t)(end - pos) < bytes) return false;
+    Uint64 val = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+      val = (val << 8) | *pos++;
+    }
+    *valOut = val;
+    return true;
+  }
+
+  // Check for the break code ending an indefinite-length item
+  bool atBreak(bool *brokeOut) {
+    if (pos >= end) return false;
+    *brokeOut = *pos == 0xff;
+    if (*brokeOut) ++pos;
+    return true;
+  }
+
+  bool readCBORString(DOMNode &out, Uint8 major, Uint64 length,
+                      bool indefinite) {
+    const char *data;
+    size_t size;
+    if (!indefinite) {
+      if (length > (Uint64)(end - pos)) return false;
+      data = (const char *)pos;
+      size = (size_t)length;
+      pos += size;
+    } else {
+      text.clear();
+      for (;;) {
+        bool broke;
+        if (!atBreak(&broke)) return false;
+        if (broke) break;
+        const Uint8 chunk = *pos++;
+        Uint64 chunkLength;
+        if ((chunk >> 5) != major ||
+            !readCBORArgument(chunk & 0x1f, &chunkLength) ||
+            chunkLength > (Uint64)(end - pos)) {
+          return false;
+        }
+        text.append((const char *)pos, (size_t)chunkLength);
+        pos += chunkLength;
+      }
+      data = text.data();
+      size = text.size();
+    }
+    if (size >= UINT32_MAX) return false;
+
+    if (major == 3) return setString(out, data, size);
+    out.type = DOMType::Bytes;
+    out.length = (Uint32)size;
+    out.bytes = (const Uint8 *)dom.copyString(data, size);
+    return out.bytes != nullptr;
+  }
+
+  bool readCBORSimple(DOMNode &out, Uint8 info) {
+    Uint64 bits;
+    switch (info) {
+      case 20:
+      case 21:
+        out.type = DOMType::Boolean;
+        out.boolean = info == 21;
+        return true;
+      case 22:  // null
+      case 23:  // undefined
+        out.type = DOMType::Null;
+        return true;
+      case 25:
+        if (!readCBORArgument(info, &bits)) return false;
+        out.type = DOMType::Number;
+        out.number = halfToDouble((Uint16)bits);
+        return true;
+      case 26: {
+        if (!readCBORArgument(info, &bits)) return false;
+        const Uint32 bits32 = (Uint32)bits;
+        float val;
+        SDL_memcpy(&val, &bits32, sizeof(val));
+        out.type = DOMType::Number;
+        out.number = val;
+        return true;
+      }
+      case 27:
+        if (!readCBORArgument(info, &bits)) return false;
+        out.type = DOMType::Number;
+        SDL_memcpy(&out.number, &bits, sizeof(out.number));
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Map keys become strings, like Duktape's property key coercion
+  bool readCBORKey(DOMMember &member, int depth) {
+    DOMNode key;
+    if (!readCBOR(key, depth)) return false;
+    if (key.type == DOMType::String) {
+      member.key = key.string;
+      member.keyLength = key.length;
+      return true;
+    }
+    if (key.type == DOMType::Number && key.number >= -9007199254740992.0 &&
+        key.number <= 9007199254740992.0 &&
+        (double)(Sint64)key.number == key.number) {
+      char buf[24];
+      const int length = SDL_snprintf(buf, sizeof(buf), "%" SDL_PRIs64,
+                                      (Sint64)key.number);
+      member.key = dom.copyString(buf, length);
+      member.keyLength = (Uint32)length;
+      return member.key != nullptr;
+    }
+    return false;
+  }
+
+  bool readCBOR(DOMNode &out, int depth) {
+    if (pos >= end || depth > MAX_DEPTH) return false;
+    out.typedArrayTag = 0;
+    const Uint8 initial = *pos++;
+    const Uint8 major = initial >> 5, info = initial & 0x1f;
+    const bool indefinite = info == 31;
+    Uint64 arg = 0;
+    if (indefinite) {
+      if (major < 2 || major > 5) return false;
+    } else if (major != 7 && !readCBORArgument(info, &arg)) {
+      return false;
+    }
+
+    switch (major) {
+      case 0:
+        out.type = DOMType::Number;
+        out.number = (double)arg;
+        return true;
+      case 1:
+        out.type = DOMType::Number;
+        out.number = -1.0 - (double)arg;
+        return true;
+      case 2:
+      case 3:
+        return readCBORString(out, major, arg, indefinite);
+      case 4: {
+        const size_t first = items.size();
+        for (Uint64 i = 0; indefinite || i < arg; ++i) {
+          bool broke;
+          if (!atBreak(&broke)) return false;
+          if (broke) {
+            if (!indefinite) return false;
+            break;
+          }
+          // Recursion can grow the scratch stack, so don't decode in-place
+          DOMNode item;
+          if (!readCBOR(item, depth + 1)) return false;
+          items.push_back(item);
+        }
+        return finishArray(out, first);
+      }
+      case 5: {
+        const size_t first = members.size();
+        for (Uint64 i = 0; indefinite || i < arg; ++i) {
+          bool broke;
+          if (!atBreak(&broke)) return false;
+          if (broke) {
+            if (!indefinite) return false;
+            break;
+          }
+          DOMMember member;
+          if (!readCBORKey(member, depth + 1) ||
+              !readCBOR(member.value, depth + 1)) {
+            return false;
+          }
+          members.push_back(member);
+        }
+        return finishObject(out, first);
+      }
+      case 6:
+        if (!readCBOR(out, depth + 1)) return false;
+        // Keep typed array tags (RFC 8746) besides 128-bit floats, which
+        // have no C++ type; other tags carry no meaning here
+        if (arg >= 64 && arg <= 87 && arg != 76 && arg != 83 && arg != 87 &&
+            out.type == DOMType::Bytes) {
+          out.typedArrayTag = (Uint8)arg;
+        }
+        return true;
+      default:
+        return readCBORSimple(out, info);
+    }
+  }
+
+  // --- JSON (RFC 8259) ---
+
+  void skipWhitespace() {
+    while (pos < end &&
+           (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')) {
+      ++pos;
+    }
+  }
+
+  bool readLiteral(const char *literal, size_t length) {
+    if ((size_t)(end - pos) < length || SDL_memcmp(pos, literal, length)) {
+      return false;
+    }
+    pos += length;
+    return true;
+  }
+
+  bool readHex4(Uint32 *valOut) {
+    if (end - pos < 4) return false;
+    Uint32 val = 0;
+    for (int i = 0; i < 4; ++i) {
+      const Uint8 c = *pos++;
+      val <<= 4;
+      if (isDigit(c)) {
+        val |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        val |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        val |= c - 'A' + 10;
+      } else {
+        return false;
+      }
+    }
+    *valOut = val;
+    return true;
+  }
+
+  void appendUTF8(Uint32 codepoint) {
+    if (codepoint < 0x80) {
+      text += (char)codepoint;
+    } else if (codepoint < 0x800) {
+      text += (char)(0xc0 | (codepoint >> 6));
+      text += (char)(0x80 | (codepoint & 0x3f));
+    } else if (codepoint < 0x10000) {
+      text += (char)(0xe0 | (codepoint >> 12));
+      text += (char)(0x80 | ((codepoint >> 6) & 0x3f));
+      text += (char)(0x80 | (codepoint & 0x3f));
+    } else {
+      text += (char)(0xf0 | (codepoint >> 18));
+      text += (char)(0x80 | ((codepoint >> 12) & 0x3f));
+      text += (char)(0x80 | ((codepoint >> 6) & 0x3f));
+      text += (char)(0x80 | (codepoint & 0x3f));
+    }
+  }
+
+  bool readJSONString(const char **strOut, Uint32 *lengthOut) {
+    ++pos;  // Opening quote
+
+    // Fast path: copy straight from the buffer if nothing needs unescaping
+    const Uint8 *first = pos;
+    while (pos < end && *pos != '"' && *pos != '\\' && *pos >= 0x20) ++pos;
+    if (pos >= end || *pos < 0x20) return false;
+    if (*pos == '"') {
+      *lengthOut = (Uint32)(pos - first);
+      *strOut = dom.copyString((const char *)first, pos - first);
+      ++pos;
+      return *strOut != nullptr;
+    }
+
+    text.assign((const char *)first, pos - first);
+    for (;;) {
+      if (pos >= end) return false;
+      const Uint8 c = *pos++;
+      if (c == '"') break;
+      if (c < 0x20) return false;
+      if (c != '\\') {
+        text += (char)c;
+        continue;
+      }
+      if (pos >= end) return false;
+      switch (*pos++) {
+        case '"':
+          text += '"';
+          break;
+        case '\\':
+          text += '\\';
+          break;
+        case '/':
+          text += '/';
+          break;
+        case 'b':
+          text += '\b';
+          break;
+        case 'f':
+          text += '\f';
+          break;
+        case 'n':
+          text += '\n';
+          break;
+        case 'r':
+          text += '\r';
+          break;
+        case 't':
+          text += '\t';
+          break;
+        case 'u': {
+          Uint32 codepoint;
+          if (!readHex4(&codepoint)) return false;
+          // Join surrogate pairs; lone surrogates pass through as-is
+          if (codepoint >= 0xd800 && codepoint < 0xdc00 && end - pos >= 6 &&
+              pos[0] == '\\' && pos[1] == 'u') {
+            Uint32 low;
+            pos += 2;
+            if (!readHex4(&low)) return false;
+            if (low >= 0xdc00 && low < 0xe000) {
+              codepoint = 0x10000 + ((codepoint - 0xd800) << 10) +
+                          (low - 0xdc00);
+            } else {
+              appendUTF8(codepoint);
+              codepoint = low;
+            }
+          }
+          appendUTF8(codepoint);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    if (text.size() >= UINT32_MAX) return false;
+    *lengthOut = (Uint32)text.size();
+    *strOut = dom.copyString(text.data(), text.size());
+    return *strOut != nullptr;
+  }
+
+  bool readJSONNumber(DOMNode &out) {
+    const Uint8 *first = pos;
+    const bool negative = pos < end && *pos == '-';
+    if (negative) ++pos;
+    if (pos >= end || !isDigit(*pos)) return false;
+
+    Uint64 mantissa = 0;
+    int digits = 0;
+    if (*pos == '0') {
+      ++pos;
+    } else {
+      while (pos < end && isDigit(*pos)) {
+        if (digits < 19) mantissa = mantissa * 10 + (*pos - '0');
+        ++digits;
+        ++pos;
+      }
+    }
+
+    bool integral = true;
+    if (pos < end && *pos == '.') {
+      ++pos;
+      if (pos >= end || !isDigit(*pos)) return false;
+      while (pos < end && isDigit(*pos)) ++pos;
+      integral = false;
+    }
+    if (pos < end && (*pos == 'e' || *pos == 'E')) {
+      ++pos;
+      if (pos < end && (*pos == '+' || *pos == '-')) ++pos;
+      if (pos >= end || !isDigit(*pos)) return false;
+      while (pos < end && isDigit(*pos)) ++pos;
+      integral = false;
+    }
+
+    out.type = DOMType::Number;
+    if (integral && digits <= 15) {
+      // Exact in a double, which covers nearly every value in a map
+      out.number = negative ? -(double)mantissa : (double)mantissa;
+    } else {
+      // Leave anything else to strtod, which rounds correctly
+      text.assign((const char *)first, pos - first);
+      out.number = SDL_strtod(text.c_str(), nullptr);
+    }
+    return true;
+  }
+
+  bool readJSON(DOMNode &out, int depth) {
+    if (depth > MAX_DEPTH) return false;
+    out.typedArrayTag = 0;
+    skipWhitespace();
+    if (pos >= end) return false;
+    switch (*pos) {
+      case '{':
+        return readJSONObject(out, depth);
+      case '[':
+        return readJSONArray(out, depth);
+      case '"':
+        out.type = DOMType::String;
+        return readJSONString(&out.string, &out.length);
+      case 't':
+        out.type = DOMType::Boolean;
+        out.boolean = true;
+        return readLiteral("true", 4);
+      case 'f':
+        out.type = DOMType::Boolean;
+        out.boolean = false;
+        return readLiteral("false", 5);
+      case 'n':
+        out.type = DOMType::Null;
+        return readLiteral("null", 4);
+      default:
+        return readJSONNumber(out);
+    }
+  }
+
+  bool readJSONArray(DOMNode &out, int depth) {
+    ++pos;  // '['
+    const size_t first = items.size();
+    skipWhitespace();
+    if (pos < end && *pos == ']') {
+      ++pos;
+      return finishArray(out, first);
+    }
+    for (;;) {
+      DOMNode item;
+      if (!readJSON(item, depth + 1)) return false;
+      items.push_back(item);
+      skipWhitespace();
+      if (pos >= end) return false;
+      const Uint8 c = *pos++;
+      if (c == ']') break;
+      if (c != ',') return false;
+    }
+    return finishArray(out, first);
+  }
+
+  bool readJSONObject(DOMNode &out, int depth) {
+    ++pos;  // '{'
+    const size_t first = members.size();
+    skipWhitespace();
+    if (pos < end && *pos == '}') {
+      ++pos;
+      return finishObject(out, first);
+    }
+    for (;;) {
+      DOMMember member;
+      skipWhitespace();
+      if (pos >= end || *pos != '"' ||
+          !readJSONString(&member.key, &member.keyLength)) {
+        return false;
+      }
+      skipWhitespace();
+      if (pos >= end || *pos != ':') return false;
+      ++pos;
+      if (!readJSON(member.value, depth + 1)) return false;
+      members.push_back(member);
+      skipWhitespace();
+      if (pos >= end) return false;
+      const Uint8 c = *pos++;
+      if (c == '}') break;
+      if (c != ',') return false;
+    }
+    return finishObject(out, first);
+  }
+};
+
+DictionaryDOM::DictionaryDOM()
+    : blockUsed_(0), blockSize_(0), arenaBytes_(0) {
+  clear();
+}
+
+DictionaryDOM::~DictionaryDOM() { clear(); }
+
+bool DictionaryDOM::decode(const char *buf, size_t size) {
+  clear();
+  if (!buf || !size) return false;
+
+  // Nodes usually take a few times the space of their source text
+  blockSize_ = size;
+  DOMParser parser(*this, buf, size);
+  if (parser.readCBOR(root_, 0) && parser.pos == parser.end) return true;
+
+  // Text formats almost always fail CBOR within the first few bytes
+  clear();
+  blockSize_ = size;
+  parser.rewind();
+  if (parser.readJSON(root_, 0)) {
+    parser.skipWhitespace();
+    if (parser.pos == parser.end) return true;
+  }
+  clear();
+  return false;
+}
+
+void DictionaryDOM::clear() {
+  for (Uint8 *block : blocks_) {
+    SDL_free(block);
+  }
+  blocks_.clear();
+  blockUsed_ = blockSize_ = arenaBytes_ = 0;
+  root_.type = DOMType::Object;
+  root_.typedArrayTag = 0;
+  root_.length = 0;
+  root_.members = nullptr;
+}
+
+void *DictionaryDOM::allocate(size_t bytes) {
+  // Keep everything 8-byte aligned for the doubles and pointers in nodes
+  bytes = (bytes + 7) & ~(size_t)7;
+  if (!bytes) return nullptr;
+  if (blocks_.empty() || blockUsed_ + bytes > blockSize_) {
+    blockSize_ = SDL_max(SDL_max(blockSize_ * 2, MIN_BLOCK_SIZE), bytes);
+    Uint8 *block = (Uint8 *)SDL_malloc(blockSize_);
+    if (!block) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "DictionaryDOM::allocate: Could not allocate a %zu-byte "
+                   "block.\n",
+                   blockSize_);
+      return nullptr;
+    }
+    blocks_.push_back(block);
+    blockUsed_ = 0;
+    arenaBytes_ += blockSize_;
+  }
+  void *mem = blocks_.back() + blockUsed_;
+  blockUsed_ += bytes;
+  return mem;
+}
+
+const char *DictionaryDOM::copyString(const char *str, size_t length) {
+  char *copy = (char *)allocate(length + 1);
+  if (!copy) return nullptr;
+  SDL_memcpy(copy, str, length);
+  copy[length] = '\0';
+  return copy;
+}
+}  // namespace renity
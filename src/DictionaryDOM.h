@@ -0,0 +1,138 @@
+/****************************************************
+ * DictionaryDOM.h: Native JSON/CBOR document tree  *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+#pragma once
+
+#include <SDL3/SDL_endian.h>
+
+#include "types.h"
+
+namespace renity {
+/** Value types in a DictionaryDOM; CBOR undefined is stored as Null. */
+enum class DOMType : Uint8 {
+  Null,
+  Boolean,
+  Number,
+  String,
+  Bytes,
+  Array,
+  Object
+};
+
+struct DOMMember;
+
+/** A single decoded value. Arrays and objects point to contiguous runs of
+ * children, so lookups are just pointer walks.
+ */
+struct DOMNode {
+  DOMType type;
+  Uint8 typedArrayTag;  // CBOR typed array tag (RFC 8746) for Bytes, or 0
+  Uint32 length;  // Bytes in a String (excluding the NUL) or Bytes, or
+                  // children in an Array or Object
+  union {
+    bool boolean;
+    double number;
+    const char *string;  // NUL-terminated
+    const Uint8 *bytes;
+    const DOMNode *items;
+    const DOMMember *members;
+  };
+
+  /** Whether this is an Array, Object or Bytes, like duk_is_object(). */
+  bool isContainer() const {
+    return type == DOMType::Array || type == DOMType::Object ||
+           type == DOMType::Bytes;
+  }
+
+  /** Find an Object member, or an Array item given a canonical index key.
+   * Duplicate keys resolve to the last one, as in a decoded JS object.
+   * @return The child's member (nullptr for Array items) and value, if found.
+   */
+  const DOMNode *child(const char *key, size_t keyLength,
+                       const DOMMember **memberOut = nullptr,
+                       Uint32 *indexOut = nullptr) const;
+
+  /** Find an Array item, or an Object member keyed by a canonical index. */
+  const DOMNode *child(Uint32 index,
+                       const DOMMember **memberOut = nullptr) const;
+
+  /** Count the elements in Bytes, sized per its typed array tag. */
+  Uint32 elementCount() const;
+
+  /** Read an element of Bytes, which are Uint8s unless tagged otherwise. */
+  double element(Uint32 index) const;
+};
+
+/** Get the CBOR typed array tag for host-endian elements of type T.
+ * Tags are laid out as 0b010fsell - float, signed, little-endian, and the
+ * element size (log2 of its bytes, minus one for floats).
+ */
+template <typename T>
+constexpr Uint8 typedArrayTag() {
+  static_assert(std::is_arithmetic<T>::value, "Not a numeric element type");
+  const bool isFloat = std::is_floating_point<T>::value;
+  const Uint8 sizeLog2 =
+      sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : 3;
+  return 0x40 | (isFloat ? 0x10 : 0) |
+         (!isFloat && std::is_signed<T>::value ? 0x08 : 0) |
+         (sizeof(T) > 1 && SDL_BYTEORDER == SDL_LIL_ENDIAN ? 0x04 : 0) |
+         (isFloat ? sizeLog2 - 1 : sizeLog2);
+}
+
+/** CBOR tag for a Uint8 typed array with clamped (Uint8ClampedArray) values. */
+constexpr Uint8 CLAMPED_UINT8_ARRAY_TAG = 68;
+
+/** An Object's key and value. */
+struct DOMMember {
+  const char *key;  // NUL-terminated
+  Uint32 keyLength;
+  DOMNode value;
+};
+
+/** Parse a canonical array index ("0", "12", but not "012" or "-1").
+ * @return True if key was an index, stored into indexOut.
+ */
+bool parseArrayIndex(const char *key, size_t keyLength, Uint32 *indexOut);
+
+/** Read-only document tree decoded from JSON or CBOR.
+ * Every node and string comes from a single arena, which is freed in one go,
+ * so decoding is just a couple of passes over the file with few allocations.
+ */
+class DictionaryDOM {
+ public:
+  DictionaryDOM();
+  ~DictionaryDOM();
+
+  DictionaryDOM(const DictionaryDOM &other) = delete;
+  DictionaryDOM &operator=(const DictionaryDOM &other) = delete;
+
+  /** Decode a buffer as CBOR, or failing that as JSON, like Duktape does.
+   * @return True on success. On failure, the root is left an empty Object.
+   */
+  bool decode(const char *buf, size_t size);
+
+  /** Free everything, leaving the root an empty Object. */
+  void clear();
+
+  /** Get the root value. */
+  const DOMNode *getRoot() const { return &root_; }
+
+  /** Get the bytes allocated for nodes and strings. */
+  size_t getArenaBytes() const { return arenaBytes_; }
+
+ private:
+  friend struct DOMParser;
+  void *allocate(size_t bytes);
+  const char *copyString(const char *str, size_t length);
+
+  DOMNode root_;
+  Vector<Uint8 *> blocks_;
+  size_t blockUsed_, blockSize_, arenaBytes_;
+};
+}  // namespace renity
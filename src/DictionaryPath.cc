@@ -0,0 +1,48 @@
+/****************************************************
+ * DictionaryPath.cc: Pre-split Dictionary keys     *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+
+#include "DictionaryPath.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "DictionaryDOM.h"
+#include "ResourcePath.h"
+
+namespace renity {
+RENITY_API DictionaryPath::DictionaryPath(const char *path)
+    : path_(path ? path : "") {
+  const char separator = '.';
+  size_t pos = 0;
+  for (;;) {
+    const size_t sep = path_.find(separator, pos);
+    const size_t length =
+        (sep == String::npos ? path_.length() : sep) - pos;
+    if (!length) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "DictionaryPath: Invalid path '%s' at index %lu.\n",
+                   path_.c_str(), pos);
+      segments_.clear();
+      return;
+    }
+
+    // Share segment strings between paths, since many have the same keys
+    Segment segment;
+    segment.key = ResourcePath::intern(path_.substr(pos, length)).c_str();
+    segment.length = (Uint32)length;
+    segment.index = 0;
+    segment.isIndex = parseArrayIndex(segment.key, length, &segment.index);
+    segments_.push_back(segment);
+
+    if (sep == String::npos) break;
+    pos = sep + 1;
+  }
+}
+}  // namespace renity
@@ -0,0 +1,231 @@
+/****************************************************
+ * DuktapeAllocator.cc: Pooled Duktape heap memory  *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+
+#include "DuktapeAllocator.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include <algorithm>
+
+namespace renity {
+/* Every block starts with its payload size, so frees and reallocs can find
+ * their size class. Block sizes are multiples of BLOCK_ALIGN, which keeps
+ * payloads at the 8-byte alignment Duktape is configured for.
+ */
+static const size_t HEADER_SIZE = 8;
+static const size_t BLOCK_ALIGN = 16;
+static const size_t MAX_POOLED_BLOCK = 256;
+static const size_t CHUNK_SIZE = 16384;
+
+static size_t blockSize(size_t size) {
+  return (size + HEADER_SIZE + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1);
+}
+
+static size_t &payloadSize(void *ptr) {
+  return *(size_t *)((Uint8 *)ptr - HEADER_SIZE);
+}
+
+DuktapeAllocator::DuktapeAllocator()
+    : freeLists_(MAX_POOLED_BLOCK / BLOCK_ALIGN, nullptr),
+      bytesInUse_(0),
+      peakBytes_(0),
+      limit_(0),
+      allocCount_(0) {}
+
+DuktapeAllocator::~DuktapeAllocator() {
+  for (auto chunk : chunks_) {
+    SDL_free(chunk);
+  }
+}
+
+duk_context *DuktapeAllocator::createHeap() {
+  DuktapeAllocator *allocator = new DuktapeAllocator();
+  duk_context *ctx = duk_create_heap(allocFunc, reallocFunc, freeFunc,
+                                     allocator, nullptr);
+  if (!ctx) delete allocator;
+  return ctx;
+}
+
+void DuktapeAllocator::destroyHeap(duk_context *ctx) {
+  DuktapeAllocator *allocator = get(ctx);
+  duk_destroy_heap(ctx);
+  delete allocator;
+}
+
+DuktapeAllocator *DuktapeAllocator::get(duk_context *ctx) {
+  duk_memory_functions funcs;
+  duk_get_memory_functions(ctx, &funcs);
+  return (DuktapeAllocator *)funcs.udata;
+}
+
+size_t DuktapeAllocator::getChunkBytes() const {
+  return chunks_.size() * CHUNK_SIZE;
+}
+
+void DuktapeAllocator::resetCounts() {
+  peakBytes_ = bytesInUse_;
+  allocCount_ = 0;
+}
+
+void DuktapeAllocator::trim() {
+  if (chunks_.empty()) return;
+
+  // Each chunk only ever holds one size class, so a chunk is empty when all of
+  // its blocks are on that class's free list
+  Vector<size_t> freeBlocks(chunks_.size(), 0);
+  auto chunkIndex = [&](void *block) {
+    auto it = std::upper_bound(chunks_.begin(), chunks_.end(), (Uint8 *)block);
+    return (size_t)(it - chunks_.begin()) - 1;
+  };
+  for (void *block : freeLists_) {
+    for (; block; block = *(void **)block) ++freeBlocks[chunkIndex(block)];
+  }
+
+  Vector<bool> empty(chunks_.size(), false);
+  for (size_t sizeClass = 0; sizeClass < freeLists_.size(); ++sizeClass) {
+    const size_t perChunk = CHUNK_SIZE / ((sizeClass + 1) * BLOCK_ALIGN);
+    void **link = &freeLists_[sizeClass];
+    while (*link) {
+      const size_t i = chunkIndex(*link);
+      if (freeBlocks[i] == perChunk) {
+        empty[i] = true;
+        *link = **(void ***)link;
+      } else {
+        link = (void **)*link;
+      }
+    }
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    if (empty[i]) {
+      SDL_free(chunks_[i]);
+    } else {
+      chunks_[kept++] = chunks_[i];
+    }
+  }
+  chunks_.resize(kept);
+}
+
+void *DuktapeAllocator::allocFunc(void *udata, duk_size_t size) {
+  return ((DuktapeAllocator *)udata)->allocate(size);
+}
+
+void *DuktapeAllocator::reallocFunc(void *udata, void *ptr, duk_size_t size) {
+  return ((DuktapeAllocator *)udata)->reallocate(ptr, size);
+}
+
+void DuktapeAllocator::freeFunc(void *udata, void *ptr) {
+  ((DuktapeAllocator *)udata)->release(ptr);
+}
+
+void *DuktapeAllocator::allocate(size_t size) {
+  if (!size) return nullptr;
+  if (limit_ && bytesInUse_ + size > limit_) {
+    SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
+                 "DuktapeAllocator::allocate: %zu bytes would exceed the %zu "
+                 "byte limit.\n",
+                 size, limit_);
+    return nullptr;
+  }
+
+  Uint8 *block;
+  const size_t bytes = blockSize(size);
+  if (bytes <= MAX_POOLED_BLOCK) {
+    const size_t sizeClass = bytes / BLOCK_ALIGN - 1;
+    block = (Uint8 *)freeLists_[sizeClass];
+    if (!block) block = (Uint8 *)refill(sizeClass);
+    if (!block) return nullptr;
+    freeLists_[sizeClass] = *(void **)block;
+  } else {
+    block = (Uint8 *)SDL_malloc(size + HEADER_SIZE);
+    if (!block) return nullptr;
+  }
+
+  void *ptr = block + HEADER_SIZE;
+  payloadSize(ptr) = size;
+  bytesInUse_ += size;
+  peakBytes_ = SDL_max(peakBytes_, bytesInUse_);
+  ++allocCount_;
+  return ptr;
+}
+
+void *DuktapeAllocator::reallocate(void *ptr, size_t size) {
+  if (!ptr) return allocate(size);
+  if (!size) {
+    release(ptr);
+    return nullptr;
+  }
+
+  // Blocks can change size in-place, as long as they stay the same kind
+  const size_t oldSize = payloadSize(ptr);
+  const size_t oldBytes = blockSize(oldSize), bytes = blockSize(size);
+  if (limit_ && size > oldSize && bytesInUse_ + size - oldSize > limit_) {
+    SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
+                 "DuktapeAllocator::reallocate: %zu bytes would exceed the %zu "
+                 "byte limit.\n",
+                 size, limit_);
+    return nullptr;
+  }
+  if (oldBytes == bytes ||
+      (oldBytes > MAX_POOLED_BLOCK && bytes > MAX_POOLED_BLOCK)) {
+    if (oldBytes != bytes) {
+      Uint8 *block = (Uint8 *)SDL_realloc((Uint8 *)ptr - HEADER_SIZE,
+                                          size + HEADER_SIZE);
+      if (!block) return nullptr;
+      ptr = block + HEADER_SIZE;
+      ++allocCount_;
+    }
+    bytesInUse_ = bytesInUse_ - oldSize + size;
+    peakBytes_ = SDL_max(peakBytes_, bytesInUse_);
+    payloadSize(ptr) = size;
+    return ptr;
+  }
+
+  void *newPtr = allocate(size);
+  if (!newPtr) return nullptr;
+  SDL_memcpy(newPtr, ptr, SDL_min(oldSize, size));
+  release(ptr);
+  return newPtr;
+}
+
+void DuktapeAllocator::release(void *ptr) {
+  if (!ptr) return;
+  const size_t size = payloadSize(ptr);
+  const size_t bytes = blockSize(size);
+  Uint8 *block = (Uint8 *)ptr - HEADER_SIZE;
+  bytesInUse_ -= size;
+  if (bytes <= MAX_POOLED_BLOCK) {
+    const size_t sizeClass = bytes / BLOCK_ALIGN - 1;
+    *(void **)block = freeLists_[sizeClass];
+    freeLists_[sizeClass] = block;
+  } else {
+    SDL_free(block);
+  }
+}
+
+// Carve a new chunk into blocks for an empty size class
+void *DuktapeAllocator::refill(size_t sizeClass) {
+  Uint8 *chunk = (Uint8 *)SDL_malloc(CHUNK_SIZE);
+  if (!chunk) return nullptr;
+  chunks_.insert(std::upper_bound(chunks_.begin(), chunks_.end(), chunk),
+                 chunk);
+  const size_t bytes = (sizeClass + 1) * BLOCK_ALIGN;
+  void *head = nullptr;
+  for (size_t offset = CHUNK_SIZE - CHUNK_SIZE % bytes; offset >= bytes;) {
+    offset -= bytes;
+    *(void **)(chunk + offset) = head;
+    head = chunk + offset;
+  }
+  freeLists_[sizeClass] = head;
+  return head;
+}
+}  // namespace renity
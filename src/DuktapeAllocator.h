@@ -0,0 +1,80 @@
+/****************************************************
+ * DuktapeAllocator.h: Pooled Duktape heap memory   *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+#pragma once
+
+#include "3rdparty/duktape/duktape.h"
+#include "types.h"
+
+namespace renity {
+/** Memory functions for a single Duktape heap.
+ * Small allocations (most JS objects, strings and property tables) come from
+ * per-size-class free lists carved out of larger chunks, rather than from the
+ * system allocator, and everything is tracked so heaps can report and cap
+ * their usage. Not thread-safe, just like the heap it belongs to.
+ */
+class DuktapeAllocator {
+ public:
+  DuktapeAllocator();
+  ~DuktapeAllocator();
+
+  DuktapeAllocator(const DuktapeAllocator &other) = delete;
+  DuktapeAllocator &operator=(const DuktapeAllocator &other) = delete;
+
+  /** Create a heap that allocates through a new DuktapeAllocator. */
+  static duk_context *createHeap();
+
+  /** Destroy a heap from createHeap(), along with its allocator. */
+  static void destroyHeap(duk_context *ctx);
+
+  /** Get the allocator behind a heap from createHeap(). */
+  static DuktapeAllocator *get(duk_context *ctx);
+
+  /** Get the payload bytes currently allocated. */
+  size_t getBytesInUse() const { return bytesInUse_; }
+
+  /** Get the most payload bytes allocated at once since the last reset. */
+  size_t getPeakBytes() const { return peakBytes_; }
+
+  /** Get the number of allocations since the last reset. */
+  Uint64 getAllocCount() const { return allocCount_; }
+
+  /** Get the bytes held in chunks for small allocations, used or not. */
+  size_t getChunkBytes() const;
+
+  /** Restart the peak and allocation counts from the current usage. */
+  void resetCounts();
+
+  /** Free every chunk with no allocations left in it.
+   * Chunks are otherwise kept until the allocator is destroyed, so a heap that
+   * was briefly large would hold onto its peak for as long as it lives.
+   */
+  void trim();
+
+  /** Limit the payload bytes in use; allocations past it fail.
+   * @param maxBytes The limit, or 0 for none.
+   */
+  void setLimit(size_t maxBytes) { limit_ = maxBytes; }
+
+ private:
+  static void *allocFunc(void *udata, duk_size_t size);
+  static void *reallocFunc(void *udata, void *ptr, duk_size_t size);
+  static void freeFunc(void *udata, void *ptr);
+
+  void *allocate(size_t size);
+  void *reallocate(void *ptr, size_t size);
+  void release(void *ptr);
+  void *refill(size_t sizeClass);
+
+  Vector<void *> freeLists_;
+  Vector<Uint8 *> chunks_;  // Sorted by address, for trim()
+  size_t bytesInUse_, peakBytes_, limit_;
+  Uint64 allocCount_;
+};
+}  // namespace renity
@@ -0,0 +1,304 @@
+/****************************************************
+ * GL_LightRenderer.cc: GL 2D light accumulation    *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+#include "GL_LightRenderer.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include <cmath>
+
+#include "GL_TileRenderer.h"
+#include "ResourceManager.h"
+#include "Window.h"
+#include "gl3.h"
+#include "resources/GL_ShaderProgram.h"
+
+namespace renity {
+// Light falloff over a fraction of LIGHT_RADIUS; matches pointlight2d.frag.
+// See https://wiki.ogre3d.org/Light+Attenuation+Shortcut
+static float attenuate(float dist) {
+  return 1.0f / (1.0f + 4.5f * dist + 75.0f * dist * dist);
+}
+
+// Each lightmap quad is two triangles of (pixel x, pixel y, u, v)
+static constexpr size_t LIGHTMAP_QUAD_FLOATS = 6 * 4;
+
+struct GL_Lightmap::Impl {
+  Impl() : tex(0), vao(0), vbo(0) {}
+  ~Impl() {
+    glDeleteTextures(1, &tex);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+  }
+
+  GLuint tex, vao, vbo;
+  Rect2Di32 bounds;
+  Dimension2Du32 size;
+};
+
+RENITY_API GL_Lightmap::GL_Lightmap() { pimpl_ = new Impl(); }
+
+RENITY_API GL_Lightmap::~GL_Lightmap() { delete pimpl_; }
+
+RENITY_API void GL_Lightmap::bake(Span<const LightInstance> lights,
+                                  const Dimension2Du32 &areaSize,
+                                  LightmapImage &imageOut) {
+  imageOut.texels.clear();
+  if (lights.empty()) {
+    imageOut.bounds = Rect2Di32();
+    imageOut.size = Dimension2Du32(0, 0);
+    return;
+  }
+  const Sint32 reach = (Sint32)LIGHT_RADIUS;
+  const Sint32 texel = LIGHTMAP_TEXEL_PIXELS;
+  const Uint32 width = (areaSize.width() + reach * 2 + texel - 1) / texel;
+  const Uint32 height = (areaSize.height() + reach * 2 + texel - 1) / texel;
+  imageOut.bounds = Rect2Di32(-reach, -reach, width * texel, height * texel);
+  imageOut.size = Dimension2Du32(width, height);
+
+  // Add up each light over just the texels within its reach
+  Vector<float> rgb(width * height * 3, 0.0f);
+  const float edge = attenuate(1.0f);
+  for (auto &light : lights) {
+    const float x = light.x + reach, y = light.y + reach;
+    const Sint32 firstX = SDL_max(0, (Sint32)((x - LIGHT_RADIUS) / texel));
+    const Sint32 lastX =
+        SDL_min((Sint32)width - 1, (Sint32)((x + LIGHT_RADIUS) / texel));
+    const Sint32 firstY = SDL_max(0, (Sint32)((y - LIGHT_RADIUS) / texel));
+    const Sint32 lastY =
+        SDL_min((Sint32)height - 1, (Sint32)((y + LIGHT_RADIUS) / texel));
+    const float color[3] = {light.r / 255.0f, light.g / 255.0f,
+                            light.b / 255.0f};
+    for (Sint32 texelY = firstY; texelY <= lastY; ++texelY) {
+      for (Sint32 texelX = firstX; texelX <= lastX; ++texelX) {
+        const float dx = (texelX + 0.5f) * texel - x;
+        const float dy = (texelY + 0.5f) * texel - y;
+        const float dist = std::sqrt(dx * dx + dy * dy) / LIGHT_RADIUS;
+        if (dist >= 1.0f) continue;
+        const float attenuation = (attenuate(dist) - edge) / (1.0f - edge);
+        float *out = &rgb[(texelY * width + texelX) * 3];
+        for (int c = 0; c < 3; ++c) out[c] += color[c] * attenuation;
+      }
+    }
+  }
+
+  // Pack into the light buffer's format, so baked light bands no more than
+  // drawn light does
+  imageOut.texels.resize(width * height);
+  for (size_t i = 0; i < width * height; ++i) {
+    Uint32 packed = 3u << 30;
+    for (int c = 0; c < 3; ++c) {
+      const float value = rgb[i * 3 + c] / LIGHT_BUFFER_RANGE * 1023.0f + 0.5f;
+      packed |= (Uint32)SDL_min(value, 1023.0f) << (c * 10);
+    }
+    imageOut.texels[i] = packed;
+  }
+}
+
+RENITY_API void GL_Lightmap::upload(const LightmapImage &image) {
+  if (!pimpl_->tex) glGenTextures(1, &pimpl_->tex);
+  glBindTexture(GL_TEXTURE_2D, pimpl_->tex);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // Light changes gradually, so filtering hides the low resolution
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, image.size.width(),
+               image.size.height(), 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV,
+               image.texels.data());
+
+  // The quad never changes relative to its map, so only the map's offset
+  // needs setting per draw; images are stored top row first
+  const float left = (float)image.bounds.x();
+  const float top = (float)image.bounds.y();
+  const float right = left + image.bounds.width();
+  const float bottom = top + image.bounds.height();
+  const float quad[LIGHTMAP_QUAD_FLOATS] = {
+      left,  bottom, 0.0f, 1.0f,  // Bottom-left
+      right, top,    1.0f, 0.0f,  // Top-right
+      left,  top,    0.0f, 0.0f,  // Top-left
+      left,  bottom, 0.0f, 1.0f,  // Bottom-left
+      right, bottom, 1.0f, 1.0f,  // Bottom-right
+      right, top,    1.0f, 0.0f   // Top-right
+  };
+  if (!pimpl_->vao) {
+    glGenVertexArrays(1, &pimpl_->vao);
+    glGenBuffers(1, &pimpl_->vbo);
+  }
+  glBindVertexArray(pimpl_->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, pimpl_->vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 4, 0);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  pimpl_->bounds = image.bounds;
+  pimpl_->size = image.size;
+}
+
+RENITY_API Rect2Di32 GL_Lightmap::getBounds() const { return pimpl_->bounds; }
+
+RENITY_API size_t GL_Lightmap::getGpuBytes() const {
+  // RGB10_A2 packs each texel into 4 bytes
+  const size_t quadBytes =
+      pimpl_->vbo ? sizeof(float) * LIGHTMAP_QUAD_FLOATS : 0;
+  return (size_t)pimpl_->size.getArea() * 4 + quadBytes;
+}
+
+struct GL_LightRenderer::Impl {
+  explicit Impl() : tex(0), size(0, 0) {
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ibo);
+    glGenFramebuffers(1, &fbo);
+    lightShader =
+        ResourceManager::getActive()->get<GL_ShaderProgram>(LIGHT_SHADER_PATH);
+    lightShader->setBlendFunc(GL_ONE, GL_ONE);
+    lightmapShader = ResourceManager::getActive()->get<GL_ShaderProgram>(
+        LIGHTMAP_SHADER_PATH);
+    lightmapShader->setBlendFunc(GL_ONE, GL_ONE);
+    tileShader =
+        ResourceManager::getActive()->get<GL_ShaderProgram>(TILE_SHADER_PATH);
+    tileShader->setSamplerUnit("lightBuffer", LIGHT_TEXTURE_UNIT);
+  }
+
+  ~Impl() {
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ibo);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &tex);
+  }
+
+  // (Re)create the buffer texture at a new size. Storage is immutable, so it
+  // always starts from a fresh texture.
+  void resize(const Dimension2Di32 &newSize) {
+    glDeleteTextures(1, &tex);
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // ES3 can't always render to float formats; 10-bit channels leave room
+    // for lights to add up past 1.0 (see LIGHT_BUFFER_RANGE)
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB10_A2, newSize.width(),
+                   newSize.height());
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, tex, 0);
+    if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) !=
+        GL_FRAMEBUFFER_COMPLETE) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "GL_LightRenderer::draw: Could not create a %ix%i light "
+                   "buffer.",
+                   newSize.width(), newSize.height());
+    }
+    size = newSize;
+  }
+
+  GLuint vao, vbo, ibo, fbo, tex;
+  Dimension2Di32 size;
+  GL_ShaderProgramPtr lightShader;
+  GL_ShaderProgramPtr lightmapShader;
+  GL_ShaderProgramPtr tileShader;
+};
+
+RENITY_API GL_LightRenderer::GL_LightRenderer() {
+  pimpl_ = new Impl();
+  Vector<float> vertices = {-1.0f, -1.0f, 1.0f, 1.0f,  -1.0f, 1.0f,
+                            -1.0f, -1.0f, 1.0f, -1.0f, 1.0f,  1.0f};
+  glBindVertexArray(pimpl_->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, pimpl_->vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(),
+               vertices.data(), GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, 0);
+
+  // Configure the instances buffer that will be filled by draws
+  glBindBuffer(GL_ARRAY_BUFFER, pimpl_->ibo);
+  glEnableVertexAttribArray(1);
+  glVertexAttribDivisor(1, 1);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(LightInstance), 0);
+  glEnableVertexAttribArray(2);
+  glVertexAttribDivisor(2, 1);
+  glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LightInstance),
+                        (const void *)offsetof(LightInstance, r));
+
+  // Unbind everything to be safe
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+RENITY_API GL_LightRenderer::~GL_LightRenderer() { delete pimpl_; }
+
+RENITY_API void GL_LightRenderer::draw(Span<const LightmapInstance> lightmaps,
+                                       Span<const LightInstance> lights,
+                                       float scale) {
+  Impl *pimpl = pimpl_;
+  const Dimension2Di32 windowSize = Window::getActive()->sizeInPixels();
+  if (windowSize.width() != pimpl->size.width() ||
+      windowSize.height() != pimpl->size.height()) {
+    pimpl->resize(windowSize);
+  }
+
+  // Draw into the buffer using the same viewport as the window, so tile
+  // shaders can sample it at their own fragment coordinates
+  GLint prevFbo;
+  GLfloat prevClearColor[4];
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFbo);
+  glGetFloatv(GL_COLOR_CLEAR_VALUE, prevClearColor);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pimpl->fbo);
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  // Match the ViewParams the app gives tile shaders
+  const Dimension2Di32 viewSize = Window::getActive()->size();
+  const Vector<float> viewParams = {(float)viewSize.width(),
+                                    (float)viewSize.height(), scale};
+  if (!lightmaps.empty()) {
+    pimpl->lightmapShader->setUniformBlock("ViewParams", viewParams);
+    pimpl->lightmapShader->activate();
+    glActiveTexture(GL_TEXTURE0);
+    for (auto &instance : lightmaps) {
+      const GL_Lightmap::Impl *lightmap = instance.lightmap->pimpl_;
+      if (!lightmap->tex) continue;
+      // Each lightmap's quad was uploaded with it; only its map's offset is
+      // set here, as a constant attribute rather than a buffer
+      glBindVertexArray(lightmap->vao);
+      glVertexAttrib2f(1, (float)instance.offset.x(),
+                       (float)instance.offset.y());
+      glBindTexture(GL_TEXTURE_2D, lightmap->tex);
+      glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+  }
+  if (!lights.empty()) {
+    pimpl->lightShader->setUniformBlock("ViewParams", viewParams);
+    pimpl->lightShader->setUniformBlock<float>(
+        "LightDetails", {LIGHT_RADIUS, 0.0f, 0.0f, 0.0f});
+    pimpl->lightShader->activate();
+    glBindVertexArray(pimpl->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, pimpl->ibo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(LightInstance) * lights.size(),
+                 lights.data(), GL_STREAM_DRAW);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, lights.size());
+  }
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevFbo);
+  glClearColor(prevClearColor[0], prevClearColor[1], prevClearColor[2],
+               prevClearColor[3]);
+
+  glActiveTexture(GL_TEXTURE0 + LIGHT_TEXTURE_UNIT);
+  glBindTexture(GL_TEXTURE_2D, pimpl->tex);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+RENITY_API size_t GL_LightRenderer::getGpuBytes() const {
+  // RGB10_A2 packs each pixel into 4 bytes
+  return (size_t)pimpl_->size.getArea() * 4;
+}
+}  // namespace renity
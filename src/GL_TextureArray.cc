@@ -0,0 +1,123 @@
+/****************************************************
+ * GL_TextureArray.cc: Packed GL 2D texture arrays  *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+#include "GL_TextureArray.h"
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "gl3.h"
+
+namespace renity {
+struct GL_TextureArray::Impl {
+  Impl() : tex(0), size(0, 0), layers(0) {}
+  ~Impl() { glDeleteTextures(1, &tex); }
+
+  GLuint tex;
+  Dimension2Du32 size;
+  Uint32 layers;
+};
+
+RENITY_API GL_TextureArray::GL_TextureArray() { pimpl_ = new Impl(); }
+
+RENITY_API GL_TextureArray::~GL_TextureArray() { delete pimpl_; }
+
+RENITY_API bool GL_TextureArray::pack(
+    const Vector<GL_Texture2DPtr> &textures) {
+  GLint maxLayers = 0;
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+  if (textures.size() > (size_t)maxLayers) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "GL_TextureArray::pack: %lu textures is more than the %i "
+                 "layers allowed.",
+                 textures.size(), maxLayers);
+    return false;
+  }
+
+  Dimension2Du32 size(0, 0);
+  for (auto &texture : textures) {
+    if (!texture) continue;
+    size.width(SDL_max(size.width(), texture->getSize().width()));
+    size.height(SDL_max(size.height(), texture->getSize().height()));
+  }
+
+  // Storage is immutable, so every pack starts from a fresh texture
+  glDeleteTextures(1, &pimpl_->tex);
+  pimpl_->tex = 0;
+  pimpl_->size = Dimension2Du32(0, 0);
+  pimpl_->layers = 0;
+  if (!size.getArea()) return true;
+  Uint32 levels = 1;
+  while ((SDL_max(size.width(), size.height()) >> levels) > 0) ++levels;
+
+  // Match the filtering of GL_Texture2D, so packed tiles look the same
+  glGenTextures(1, &pimpl_->tex);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, pimpl_->tex);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, size.width(),
+                 size.height(), textures.size());
+
+  // Copy each texture in by reading it through a framebuffer, which keeps the
+  // pixels on the GPU rather than needing the source images again
+  GLint prevFbo = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevFbo);
+  GLuint fbo;
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+  for (size_t layer = 0; layer < textures.size(); ++layer) {
+    const GL_Texture2DPtr &texture = textures[layer];
+    if (!texture || !texture->getSize().getArea()) continue;
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, texture->getTextureIndex(), 0);
+    if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) !=
+        GL_FRAMEBUFFER_COMPLETE) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "GL_TextureArray::pack: Could not read texture for layer "
+                   "%lu.",
+                   layer);
+      continue;
+    }
+    glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, 0, 0,
+                        texture->getSize().width(),
+                        texture->getSize().height());
+  }
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)prevFbo);
+  glDeleteFramebuffers(1, &fbo);
+  glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+  pimpl_->size = size;
+  pimpl_->layers = textures.size();
+  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                 "GL_TextureArray::pack: Packed %u %ux%u layer(s).",
+                 pimpl_->layers, size.width(), size.height());
+  return true;
+}
+
+RENITY_API void GL_TextureArray::use() {
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, pimpl_->tex);
+}
+
+RENITY_API Dimension2Du32 GL_TextureArray::getSize() const {
+  return pimpl_->size;
+}
+
+RENITY_API Uint32 GL_TextureArray::getLayerCount() const {
+  return pimpl_->layers;
+}
+
+RENITY_API size_t GL_TextureArray::getGpuBytes() const {
+  // RGBA8, plus roughly a third more for the mipmap chain
+  return (size_t)pimpl_->size.getArea() * pimpl_->layers * 4 * 4 / 3;
+}
+}  // namespace renity
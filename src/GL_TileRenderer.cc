@@ -9,19 +9,58 @@
  ***************************************************/
 #include "GL_TileRenderer.h"
 
+#include <SDL3/SDL_stdinc.h>
+
 #include "ResourceManager.h"
 #include "gl3.h"
 
 namespace renity {
 static GLenum drawMode = GL_TRIANGLES;
 
+// Point the instance attributes of the bound VAO at a buffer
+static void pointInstances(GLuint buffer, size_t first) {
+  // They're integers, so use the I variant to keep them from becoming floats
+  const size_t offset = sizeof(TileInstance) * first;
+  const size_t layerOffset = offset + offsetof(TileInstance, layer);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glVertexAttribIPointer(2, 3, GL_UNSIGNED_SHORT, sizeof(TileInstance),
+                         (const void *)offset);
+  glVertexAttribIPointer(3, 2, GL_UNSIGNED_BYTE, sizeof(TileInstance),
+                         (const void *)layerOffset);
+}
+
+struct GL_TileBuffer::Impl {
+  explicit Impl() : count(0) { glGenBuffers(1, &vbo); }
+  ~Impl() { glDeleteBuffers(1, &vbo); }
+
+  GLuint vbo;
+  Uint32 count;
+};
+
+RENITY_API GL_TileBuffer::GL_TileBuffer() { pimpl_ = new Impl(); }
+
+RENITY_API GL_TileBuffer::~GL_TileBuffer() { delete pimpl_; }
+
+RENITY_API void GL_TileBuffer::upload(Span<const TileInstance> tiles) {
+  glBindBuffer(GL_ARRAY_BUFFER, pimpl_->vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(TileInstance) * tiles.size(),
+               tiles.data(), GL_STATIC_DRAW);
+  pimpl_->count = (Uint32)tiles.size();
+}
+
+RENITY_API Uint32 GL_TileBuffer::size() const { return pimpl_->count; }
+
+RENITY_API size_t GL_TileBuffer::getGpuBytes() const {
+  return sizeof(TileInstance) * pimpl_->count;
+}
+
 struct GL_TileRenderer::Impl {
   explicit Impl() {
     glGenVertexArrays(1, &vao);
     glGenBuffers(1, &vbo);
     glGenBuffers(1, &ibo);
-    tileShader = ResourceManager::getActive()->get<GL_ShaderProgram>(
-        "/assets/shaders/tile2d.shader");
+    tileShader =
+        ResourceManager::getActive()->get<GL_ShaderProgram>(TILE_SHADER_PATH);
   }
 
   ~Impl() {
@@ -58,16 +97,13 @@ RENITY_API GL_TileRenderer::GL_TileRenderer() {
   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, bufStride,
                         (const void *)(sizeof(float) * 3));
 
-  // Configure the instances buffer that will be filled every draw call
-  glBindBuffer(GL_ARRAY_BUFFER, pimpl_->ibo);
+  // Configure the instances buffer that will be filled by streamed draws;
+  // draws from a GL_TileBuffer point the attributes at it instead
   glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, 3, GL_UNSIGNED_INT, GL_FALSE, sizeof(TileInstance),
-                        0);
   glVertexAttribDivisor(2, 1);
   glEnableVertexAttribArray(3);
-  glVertexAttribPointer(3, 3, GL_UNSIGNED_INT, GL_FALSE, sizeof(TileInstance),
-                        (const void *)(offsetof(TileInstance, t)));
   glVertexAttribDivisor(3, 1);
+  pointInstances(pimpl_->ibo, 0);
 
   // Unbind everything to be safe
   glBindVertexArray(0);
@@ -87,12 +123,30 @@ RENITY_API GL_ShaderProgramPtr GL_TileRenderer::getTileShader() {
 }
 
 RENITY_API void GL_TileRenderer::draw(const Vector<TileInstance> &tiles) {
+  draw(Span<const TileInstance>{tiles.data(), tiles.size()});
+}
+
+RENITY_API void GL_TileRenderer::draw(Span<const TileInstance> tiles) {
   pimpl_->tileShader->activate();
   glBindVertexArray(pimpl_->vao);
-  // TODO: Try removing this, since the VAO should bind it
-  glBindBuffer(GL_ARRAY_BUFFER, pimpl_->ibo);
+  pointInstances(pimpl_->ibo, 0);
   glBufferData(GL_ARRAY_BUFFER, sizeof(TileInstance) * tiles.size(),
                tiles.data(), GL_STREAM_DRAW);
   glDrawArraysInstanced(drawMode, 0, 6, tiles.size());
 }
+
+RENITY_API void GL_TileRenderer::draw(const GL_TileBuffer &buffer,
+                                      Uint32 first, Uint32 count,
+                                      bool opaque) {
+  if (first >= buffer.size()) return;
+  count = SDL_min(count, buffer.size() - first);
+  pimpl_->tileShader->activate();
+  glBindVertexArray(pimpl_->vao);
+  // ES3 has no base instance, so offset the attributes instead
+  pointInstances(buffer.pimpl_->vbo, first);
+  // Blending is on by default (see Window), so only leave it off briefly
+  if (opaque) glDisable(GL_BLEND);
+  glDrawArraysInstanced(drawMode, 0, 6, count);
+  if (opaque) glEnable(GL_BLEND);
+}
 }  // namespace renity
@@ -87,7 +87,7 @@ struct InputMapper::Impl : public ActionHandler {
 #ifdef RENITY_DEBUG
       // Only auto-save in debug since it removes the abiity to cancel changes
       // TODO: Add action triggers for load/save?
-      mapDict.save("keybinds.json");
+      mapDict.saveAsync("keybinds.json");
 #endif
     }
   }
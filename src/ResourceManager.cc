@@ -12,8 +12,23 @@
 
 #include <SDL3/SDL.h>
 
+#include <algorithm>
+
+#include "Dictionary.h"
 #include "HashTable.h"
+#include "resources/GL_FragShader.h"
+#include "resources/GL_Mesh.h"
+#include "resources/GL_ShaderProgram.h"
+#include "resources/GL_Texture2D.h"
+#include "resources/GL_VertShader.h"
+#include "resources/ScriptContext.h"
+#include "resources/StringBuffer.h"
+#include "resources/TileWorld.h"
+#include "resources/Tilemap.h"
+#include "resources/Tileset.h"
 #include "utils/physfsrwops.h"
+#include "utils/rwops_utils.h"
+#include "utils/string_helpers.h"
 
 #ifdef RENITY_DEBUG
 #define DMON_IMPL
@@ -29,18 +44,852 @@ struct ResourceUpdate {
   bool fileStillValid;
 };
 
+struct RetainedRes {
+  PathId id;
+  StrongRes res;
+  size_t bytes;  // Measured once loaded, so trimming needn't ask again
+};
+using RetainedList = List<RetainedRes>;
+
+enum class AsyncState { Queued, Preparing, Prepared, Expanding };
+struct AsyncLoad {
+  String path;
+  PathId id;
+  StrongRes res;
+  AsyncState state;
+  bool staged;  // Whether prepareLoad() consumed the file
+  Uint8 *buf;   // Otherwise, the raw file contents (if any) for load()
+  Sint64 bufSize;
+  SDL_RWops *mapped;       // Or the memory-mapped file, handed over as-is
+  bool mappable;           // Whether the file may be mapped at all
+  bool expanded;           // Whether dependencies have been requested yet
+  bool awaited;            // Whether a thread is blocked on it, see claim()
+  Vector<StrongRes> deps;  // Pending dependencies to finish first
+  ResourceLoadStats stats;
+};
+
+// Time spent in nested loads on this thread, so each load's phase timings only
+// count its own work rather than e.g. the tilesets a map pulls in.
+static thread_local Uint64 nestedLoadNS = 0;
+
+/* Resources this thread is in the middle of loading. Nested requests are
+ * recorded as dependencies of the innermost one, and requests for any of them
+ * (i.e. dependency cycles) get them as-is rather than waiting on themselves.
+ */
+struct LoadingRes {
+  Resource *res;
+  PathId id;
+};
+static thread_local Vector<LoadingRes> loadingHere;
+
+// Time a load phase, excluding nested loads, and report it to any outer phase
+static Uint64 timePhase(const FuncPtr<void()> &phase) {
+  const Uint64 outerNestedNS = nestedLoadNS;
+  nestedLoadNS = 0;
+  const Uint64 start = SDL_GetTicksNS();
+  phase();
+  const Uint64 elapsed = SDL_GetTicksNS() - start;
+  const Uint64 exclusive = elapsed - SDL_min(elapsed, nestedLoadNS);
+  nestedLoadNS = outerNestedNS + elapsed;
+  return exclusive;
+}
+
+// Wrap a stream to add the time and bytes read through it to a load's stats
+static Sint64 timedRead(SDL_RWops *rw, void *ptr, Sint64 size) {
+  SDL_RWops *src = (SDL_RWops *)rw->hidden.unknown.data1;
+  ResourceLoadStats *stats = (ResourceLoadStats *)rw->hidden.unknown.data2;
+  const Uint64 start = SDL_GetTicksNS();
+  Sint64 readBytes = SDL_RWread(src, ptr, size);
+  stats->readNS += SDL_GetTicksNS() - start;
+  if (readBytes > 0) stats->bytesRead += readBytes;
+  return readBytes;
+}
+static Sint64 timedSize(SDL_RWops *rw) {
+  return SDL_RWsize((SDL_RWops *)rw->hidden.unknown.data1);
+}
+static Sint64 timedSeek(SDL_RWops *rw, Sint64 offset, int whence) {
+  return SDL_RWseek((SDL_RWops *)rw->hidden.unknown.data1, offset, whence);
+}
+static Sint64 timedWrite(SDL_RWops *rw, const void *ptr, Sint64 size) {
+  return SDL_RWwrite((SDL_RWops *)rw->hidden.unknown.data1, ptr, size);
+}
+static int timedClose(SDL_RWops *rw) {
+  int result = SDL_RWclose((SDL_RWops *)rw->hidden.unknown.data1);
+  SDL_DestroyRW(rw);
+  return result;
+}
+static SDL_RWops *timeReads(SDL_RWops *src, ResourceLoadStats *stats) {
+  if (!src) return nullptr;
+  SDL_RWops *rw = SDL_CreateRW();
+  if (!rw) return src;
+  rw->size = timedSize;
+  rw->seek = timedSeek;
+  rw->read = timedRead;
+  rw->write = timedWrite;
+  rw->close = timedClose;
+  rw->hidden.unknown.data1 = src;
+  rw->hidden.unknown.data2 = stats;
+  return rw;
+}
+
+/* Open a file for a load, timing it. Memory-mapped files are left unwrapped,
+ * so loaders can still get at their buffers; their reads are just copies, and
+ * any paging in happens during parsing anyway. Hot-reloadable files are never
+ * mapped, since truncating one while a loader holds it would fault (SIGBUS).
+ */
+static SDL_RWops *timedOpen(const char *path, ResourceLoadStats *stats,
+                            bool mappable) {
+  SDL_RWops *ops = nullptr;
+  stats->openNS += timePhase([&]() {
+    ops = mappable ? RENITY_OpenRead(path) : PHYSFSRWOPS_openRead(path);
+  });
+  Sint64 mappedSize = 0;
+  if (RENITY_GetMappedBuffer(ops, &mappedSize)) {
+    stats->bytesRead += mappedSize;
+    return ops;
+  }
+  return timeReads(ops, stats);
+}
+
+// Type registry shared by all ResourceManagers
+static HashTable<String, ResourceFactory> &getFactories() {
+  static HashTable<String, ResourceFactory> factories;
+  return factories;
+}
+static HashTable<String, String> &getExtensionTypes() {
+  static HashTable<String, String> extensionTypes;
+  return extensionTypes;
+}
+
+static void registerBuiltinTypes() {
+  static bool registered = false;
+  if (registered) return;
+  registered = true;
+  ResourceManager::registerType<Dictionary>("Dictionary", {".json", ".cbor"});
+  ResourceManager::registerType<GL_FragShader>("GL_FragShader", {".frag"});
+  ResourceManager::registerType<GL_Mesh>("GL_Mesh", {".mesh"});
+  ResourceManager::registerType<GL_ShaderProgram>("GL_ShaderProgram",
+                                                  {".shader"});
+  ResourceManager::registerType<GL_Texture2D>(
+      "GL_Texture2D", {".png", ".jpg", ".jpeg", ".bmp", ".tga", ".gif"});
+  ResourceManager::registerType<GL_VertShader>("GL_VertShader", {".vert"});
+  ResourceManager::registerType<ScriptContext>("ScriptContext");
+  ResourceManager::registerType<StringBuffer>("StringBuffer", {".js", ".txt"});
+  ResourceManager::registerType<Tilemap>("Tilemap", {".tmj"});
+  ResourceManager::registerType<Tileset>("Tileset", {".tsj"});
+  ResourceManager::registerType<TileWorld>("TileWorld", {".world"});
+}
+
+static ResourceFactory findFactory(const char *path, const char *typeName) {
+  String type;
+  if (typeName && typeName[0]) {
+    type = typeName;
+  } else {
+    const char *ext = SDL_strrchr(path, '.');
+    if (ext && !SDL_strchr(ext, '/')) {
+      type = getExtensionTypes().keep(toLower(ext), "");
+    }
+  }
+  if (type.empty() || !getFactories().exists(type)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "ResourceManager::findFactory: Unknown type '%s' for '%s'\n",
+                 type.c_str(), path);
+    return nullptr;
+  }
+  return getFactories().get(type);
+}
+
 struct ResourceManager::Impl {
-  HashTable<String, WeakRes> map;
+  /* The cache is split into shards by PathId, each with its own reader/writer
+   * lock, so that lookups from different threads rarely contend.
+   */
+  static constexpr size_t SHARD_COUNT = 16;
+  struct CacheEntry {
+    WeakRes res;
+    const char *path;  // Interned, to tell apart paths that share a PathId
+  };
+  struct CacheShard {
+    SDL_RWLock *lock;
+    IdHashTable<CacheEntry> map;
+  };
+  CacheShard shards[SHARD_COUNT];
+
+  CacheShard &shardOf(PathId id) { return shards[id % SHARD_COUNT]; }
+
+  // Whether an entry belongs to a different path that hashes to the same id
+  static bool collides(const CacheEntry &entry, const char *path) {
+    return entry.path && entry.path != path && SDL_strcmp(entry.path, path);
+  }
+
+  // Get a cached Resource, if it's still alive
+  StrongRes find(PathId id, bool *known = nullptr) {
+    CacheShard &shard = shardOf(id);
+    SDL_LockRWLockForReading(shard.lock);
+    const CacheEntry *entry = shard.map.find(id);
+    StrongRes strong = entry ? entry->res.lock() : nullptr;
+    SDL_UnlockRWLock(shard.lock);
+    if (known) *known = entry != nullptr;
+    return strong;
+  }
+
+  /* Get a cached Resource, or create and cache a new one marked as pending.
+   * Only one caller gets to cache it, and must then load it and call endLoad()
+   * (or queue it); everyone else shares the pending Resource. Constructors may
+   * request Resources themselves, so construction happens outside the lock,
+   * and the loser of a race just discards its copy. If a live Resource of a
+   * different path has the same PathId, nothing is cached and collided is set.
+   */
+  StrongRes findOrCreate(const ResourcePath &path, ResourceFactory factory,
+                         bool *created, bool *collided) {
+    *created = false;
+    *collided = false;
+    CacheShard &shard = shardOf(path.id());
+    SDL_LockRWLockForReading(shard.lock);
+    const CacheEntry *known = shard.map.find(path.id());
+    StrongRes strong = known ? known->res.lock() : nullptr;
+    *collided = strong && collides(*known, path.c_str());
+    SDL_UnlockRWLock(shard.lock);
+    if (*collided) return nullptr;
+    if (strong) return strong;
+
+    StrongRes fresh = StrongRes(factory());
+    fresh->pending_ = 1;
+    SDL_LockRWLockForWriting(shard.lock);
+    CacheEntry &entry = shard.map.get(path.id());
+    strong = entry.res.lock();
+    if (strong && collides(entry, path.c_str())) {
+      *collided = true;
+      strong = nullptr;
+    } else if (!strong) {
+      if (!entry.path || collides(entry, path.c_str())) {
+        entry.path = ResourcePath::intern(path.c_str()).c_str();
+      }
+      entry.res = fresh;
+      strong = fresh;
+      *created = true;
+    }
+    SDL_UnlockRWLock(shard.lock);
+    if (!*created) discard(std::move(fresh));
+    return strong;
+  }
+
+  /* Resources released by the cache are destroyed on the owning thread, during
+   * update(), since destructors may free GL objects and this may be a worker.
+   */
+  Vector<StrongRes> discarded;
+
+  void discard(StrongRes &&res) {
+    SDL_LockMutex(cacheLock);
+    discarded.push_back(std::move(res));
+    SDL_UnlockMutex(cacheLock);
+  }
+
+  void releaseDiscarded() {
+    Vector<StrongRes> released;
+    SDL_LockMutex(cacheLock);
+    released.swap(discarded);
+    SDL_UnlockMutex(cacheLock);
+  }
+
+  // Note that this thread is loading a Resource, for waitWouldCycle()
+  void beginLoad(PathId id) {
+    SDL_LockMutex(loadLock);
+    loaders.put(id, SDL_ThreadID());
+    SDL_UnlockMutex(loadLock);
+  }
+
+  // Mark a synchronously-loaded Resource as done, waking anyone waiting on it
+  void endLoad(Resource *res, PathId id) {
+    SDL_LockMutex(loadLock);
+    res->pending_ = 0;
+    loaders.erase(id);
+    SDL_BroadcastCondition(loadProgressed);
+    SDL_UnlockMutex(loadLock);
+  }
+
+  // Bookkeeping below (retention, stats, and releases) uses cacheLock
+  SDL_Mutex *cacheLock;
+  IdHashTable<ResourceLoadStats> loadStats;
+
+  void recordLoad(const ResourcePath &path, ResourceLoadStats &stats) {
+    stats.path = path.c_str();
+    stats.reloadCount = 0;
+    SDL_LockMutex(cacheLock);
+    if (loadStats.exists(path.id())) {
+      stats.reloadCount = loadStats.get(path.id()).reloadCount + 1;
+    }
+    loadStats.put(path.id(), stats);
+    SDL_UnlockMutex(cacheLock);
+  }
+
+  /* Dependency edges, recorded from nested requests while loading, in both
+   * directions: dependencies[a] lists what a requested, and dependents[b]
+   * lists everything that requested b.
+   */
+  IdHashTable<Vector<PathId>> dependencies;
+  IdHashTable<Vector<PathId>> dependents;
+
+  // Record a request as a dependency of whatever this thread is loading
+  void noteRequest(PathId id) {
+    if (loadingHere.empty() || loadingHere.back().id == id) return;
+    PathId user = loadingHere.back().id;
+    SDL_LockMutex(cacheLock);
+    Vector<PathId> &deps = dependencies.get(user);
+    if (std::find(deps.begin(), deps.end(), id) == deps.end()) {
+      deps.push_back(id);
+      dependents.get(id).push_back(user);
+    }
+    SDL_UnlockMutex(cacheLock);
+  }
+
+  // Forget what a Resource depends on, before it (re)loads and re-requests it
+  void clearDependencies(PathId user) {
+    SDL_LockMutex(cacheLock);
+    const Vector<PathId> *deps = dependencies.find(user);
+    if (deps) {
+      for (auto id : *deps) {
+        Vector<PathId> &users = dependents.get(id);
+        users.erase(std::remove(users.begin(), users.end(), user), users.end());
+        if (users.empty()) dependents.erase(id);
+      }
+      dependencies.erase(user);
+    }
+    SDL_UnlockMutex(cacheLock);
+  }
+
+  /* List changed Resources and everything depending on them (directly or not),
+   * each once, with dependencies before their dependents. Must hold cacheLock.
+   */
+  Vector<PathId> reloadOrder(const Vector<PathId> &changed) {
+    Vector<PathId> order;
+    IdHashTable<bool> visited;
+    FuncPtr<void(PathId)> visit = [&](PathId id) {
+      if (visited.exists(id)) return;
+      visited.put(id, true);
+      const Vector<PathId> *users = dependents.find(id);
+      if (users) {
+        for (auto user : *users) visit(user);
+      }
+      order.push_back(id);
+    };
+    for (auto id : changed) visit(id);
+    std::reverse(order.begin(), order.end());
+    return order;
+  }
+
+  // Load a Resource synchronously, staging it first if supported for timing
+  static void timedLoad(Resource *res, SDL_RWops *ops,
+                        ResourceLoadStats &stats) {
+    bool staged = false;
+    stats.parseNS += timePhase([&]() {
+      staged = ops && res->prepareLoad(ops);
+      if (!staged) res->load(ops);
+    });
+    stats.parseNS -= SDL_min(stats.parseNS, stats.readNS);
+    if (staged) {
+      stats.uploadNS += timePhase([&]() { res->finishLoad(); });
+    }
+  }
+
+  // Strong refs to recently-requested Resources, most recent first
+  RetainedList retained;
+  IdHashTable<RetainedList::iterator> retainedIndex;
+  size_t retainedBytes;  // Total of every entry's bytes, used or not
+  size_t retentionBudget;
+  ResourceCacheStats stats;
+  AtomicUint64 hits;
+  AtomicUint64 misses;
+
+  /* Retain a newly-created Resource. Trimming waits for the next update(), so
+   * cache misses (e.g. a preload's worth of them) don't each rescan the list.
+   */
+  void retain(PathId id, const StrongRes &res) {
+    SDL_LockMutex(cacheLock);
+    moveToFront(id, res);
+    measureLocked(id, res);
+    SDL_UnlockMutex(cacheLock);
+  }
+
+  // Update a retained Resource's size after it (re)loads
+  void measure(PathId id, const StrongRes &res) {
+    SDL_LockMutex(cacheLock);
+    measureLocked(id, res);
+    SDL_UnlockMutex(cacheLock);
+  }
+
+  void measureLocked(PathId id, const StrongRes &res) {
+    if (!retainedIndex.exists(id) || res->isPending()) return;
+    RetainedRes &entry = *retainedIndex.get(id);
+    retainedBytes -= entry.bytes;
+    entry.bytes = sizeOf(res);
+    retainedBytes += entry.bytes;
+  }
+
+  /* Mark a cached Resource as recently requested. Hits are frequent, so rather
+   * than wait on a busy lock, skip it and let the LRU order be approximate.
+   */
+  void touch(PathId id, const StrongRes &res) {
+    if (SDL_TryLockMutex(cacheLock) == 0) {
+      moveToFront(id, res);
+      SDL_UnlockMutex(cacheLock);
+    }
+  }
+
+  void moveToFront(PathId id, const StrongRes &res) {
+    if (retainedIndex.exists(id)) {
+      RetainedList::iterator it = retainedIndex.get(id);
+      retained.splice(retained.begin(), retained, it);
+      it->res = res;
+    } else {
+      retained.push_front({id, res, 0});
+      retainedIndex.put(id, retained.begin());
+    }
+  }
+
+  static size_t sizeOf(const StrongRes &res) {
+    return sizeof(RetainedRes) + res->getCpuBytes() + res->getGpuBytes();
+  }
+
+  /* Release the least-recently-requested unused Resources until under budget.
+   * Only the owning thread trims, from update() and the like. Releasing one
+   * can leave its own dependencies unused, so repeat as needed.
+   */
+  void trim() {
+    Vector<StrongRes> evicted;
+    do {
+      evicted.clear();
+      SDL_LockMutex(cacheLock);
+      if (retainedBytes > retentionBudget) {
+        size_t bytes = 0;
+        for (auto &entry : retained) {
+          if (entry.res.use_count() == 1) bytes += entry.bytes;
+        }
+        auto it = retained.end();
+        while (bytes > retentionBudget && it != retained.begin()) {
+          --it;
+          if (it->res.use_count() != 1) continue;
+          bytes -= it->bytes;
+          retainedBytes -= it->bytes;
+          evicted.push_back(std::move(it->res));
+          retainedIndex.erase(it->id);
+          it = retained.erase(it);
+          ++stats.evictions;
+        }
+      }
+      SDL_UnlockMutex(cacheLock);
+    } while (!evicted.empty());
+  }
+
+  /* Background loading; workers are started on the first getAsync() call.
+   * Each unfinished load is indexed in loads, and moves through one queue per
+   * stage, so workers and update() only ever look at loads they can act on.
+   */
+  Vector<SDL_Thread *> workers;
+  IdHashTable<AsyncLoad *> loads;
+  Uint32 loadCount;
+  Deque<AsyncLoad *> queued;    // Waiting for a worker to prepare them
+  Deque<AsyncLoad *> prepared;  // Waiting for update() to expand them
+  Deque<AsyncLoad *> expanded;  // Waiting on dependencies, then to finish
+  SDL_Mutex *loadLock;
+  SDL_Condition *loadQueued;
+  SDL_Condition *loadProgressed;  // A load was prepared, expanded or finished
+  Uint64 loadBudgetNS;
+  bool stopWorkers;
+  ResourceLoadProgress progress;
+
+  void startWorkers() {
+    stopWorkers = false;
+    int count = SDL_GetCPUCount() - 1;
+    if (count < 1) count = 1;
+    for (int i = 0; i < count; ++i) {
+      SDL_Thread *thread = SDL_CreateThread(workerMain, "ResourceLoader", this);
+      if (!thread) {
+        SDL_LogError(SDL_LOG_CATEGORY_SYSTEM,
+                     "ResourceManager::Impl::startWorkers: Could not create "
+                     "loader thread: %s\n",
+                     SDL_GetError());
+        break;
+      }
+      workers.push_back(thread);
+    }
+  }
+
+  void stopAndClearLoads() {
+    SDL_LockMutex(loadLock);
+    stopWorkers = true;
+    SDL_BroadcastCondition(loadQueued);
+    SDL_UnlockMutex(loadLock);
+    for (auto thread : workers) {
+      SDL_WaitThread(thread, nullptr);
+    }
+    workers.clear();
+    SDL_LockMutex(loadLock);
+    loads.enumerate([](AsyncLoad *const &load) {
+      load->res->pending_ = 0;
+      SDL_free(load->buf);
+      if (load->mapped) SDL_RWclose(load->mapped);
+      delete load;
+      return true;
+    });
+    loads.clear();
+    loadCount = 0;
+    queued.clear();
+    prepared.clear();
+    expanded.clear();
+    progress = {0, 0};
+    SDL_BroadcastCondition(loadProgressed);
+    SDL_UnlockMutex(loadLock);
+  }
+
+  static int workerMain(void *data) {
+    Impl *pimpl_ = (Impl *)(data);
+    SDL_LockMutex(pimpl_->loadLock);
+    while (!pimpl_->stopWorkers) {
+      if (pimpl_->queued.empty()) {
+        SDL_WaitCondition(pimpl_->loadQueued, pimpl_->loadLock);
+        continue;
+      }
+      AsyncLoad *load = pimpl_->queued.front();
+      pimpl_->queued.pop_front();
+      load->state = AsyncState::Preparing;
+      SDL_UnlockMutex(pimpl_->loadLock);
+      prepare(load);
+      SDL_LockMutex(pimpl_->loadLock);
+      load->state = AsyncState::Prepared;
+      pimpl_->prepared.push_back(load);
+      SDL_BroadcastCondition(pimpl_->loadProgressed);
+    }
+    SDL_UnlockMutex(pimpl_->loadLock);
+    return 0;
+  }
+
+  /* Read (and if supported, decode) a file. Doesn't need the lock, since the
+   * load is marked Preparing and nothing else touches it in the meantime.
+   */
+  static void prepare(AsyncLoad *load) {
+    SDL_RWops *ops =
+        timedOpen(load->path.c_str(), &load->stats, load->mappable);
+    if (!ops) {
+      SDL_LogError(SDL_LOG_CATEGORY_SYSTEM,
+                   "ResourceManager::Impl::prepare: "
+                   "RENITY_OpenRead(\"%s\") failed: '%s'\n",
+                   load->path.c_str(), SDL_GetError());
+      return;
+    }
+    load->stats.parseNS = timePhase([&]() {
+      load->staged = load->res->prepareLoad(ops);
+      if (load->staged) return;
+      if (RENITY_GetMappedBuffer(ops, nullptr)) {
+        load->mapped = ops;
+      } else {
+        load->bufSize = RENITY_ReadRawBuffer(ops, &load->buf);
+      }
+    });
+    load->stats.parseNS -= SDL_min(load->stats.parseNS, load->stats.readNS);
+  }
+
+  // Apply a prepared load that's been taken out of the queue
+  void finish(AsyncLoad *load) {
+    Resource *res = load->res.get();
+    beginLoad(load->id);
+    clearDependencies(load->id);
+    loadingHere.push_back({res, load->id});
+    if (load->staged) {
+      load->stats.uploadNS = timePhase([&]() { res->finishLoad(); });
+    } else {
+      load->stats.parseNS += timePhase([&]() {
+        SDL_RWops *ops = load->mapped;
+        if (load->buf && load->bufSize > 0) {
+          ops = SDL_RWFromConstMem(load->buf, load->bufSize);
+        }
+        res->load(ops);
+      });
+    }
+    loadingHere.pop_back();
+    recordLoad(ResourcePath(load->path.c_str()), load->stats);
+    SDL_free(load->buf);
+    SDL_LockMutex(loadLock);
+    res->pending_ = 0;
+    loaders.erase(load->id);
+    ++progress.finished;
+    SDL_BroadcastCondition(loadProgressed);
+    SDL_UnlockMutex(loadLock);
+    measure(load->id, load->res);
+    res->runReloadCallbacks();
+    delete load;
+  }
+
+  // Whether a prepared load has no dependencies left to wait on
+  static bool isReady(AsyncLoad *load) {
+    if (load->state != AsyncState::Prepared || !load->expanded) return false;
+    for (auto &dep : load->deps) {
+      if (dep->isPending()) return false;
+    }
+    load->deps.clear();
+    return true;
+  }
+
+  // Take a load out of the index and whichever queue it's in. Must hold
+  // loadLock, and the load mustn't be Preparing or Expanding.
+  void unlinkLoad(AsyncLoad *load) {
+    Deque<AsyncLoad *> &queue = load->state == AsyncState::Queued ? queued
+                                : load->expanded ? expanded
+                                                 : prepared;
+    queue.erase(std::find(queue.begin(), queue.end(), load));
+    loads.erase(load->id);
+    --loadCount;
+  }
+
+  /* Take the next load that's ready to finish. Loads other threads are blocked
+   * on count as ready, as do all loads if every one is expanded but none are
+   * ready (i.e. a dependency cycle), taking the oldest; their synchronous
+   * get()s will finish whatever they need.
+   */
+  AsyncLoad *takeReady() {
+    SDL_LockMutex(loadLock);
+    AsyncLoad *load = nullptr;
+    for (auto candidate : expanded) {
+      if (candidate->awaited || isReady(candidate)) {
+        load = candidate;
+        break;
+      }
+    }
+    if (!load && !expanded.empty() && expanded.size() == loadCount) {
+      load = expanded.front();
+    }
+    if (load) unlinkLoad(load);
+    SDL_UnlockMutex(loadLock);
+    return load;
+  }
+
+  /* Which thread is applying each load underway, and which Resource each
+   * blocked thread is waiting on, so that waits closing a cycle between
+   * threads (e.g. two maps that refer to each other, loading on different
+   * threads) can be refused rather than deadlock. Guarded by loadLock.
+   */
+  IdHashTable<SDL_threadID> loaders;
+  IdHashTable<PathId> waits;
+
+  /* Whether waiting on a Resource would end up waiting on this thread, through
+   * whoever is loading it and whatever they're waiting on in turn. Loads no
+   * thread is applying yet can't block; update() or a claim() will take them.
+   * Must hold loadLock.
+   */
+  bool waitWouldCycle(PathId id) const {
+    const SDL_threadID self = SDL_ThreadID();
+    Vector<SDL_threadID> visited;
+    const SDL_threadID *loader = loaders.find(id);
+    while (loader) {
+      if (*loader == self) return true;
+      // Cycles not involving this thread are for their own threads to break
+      if (std::find(visited.begin(), visited.end(), *loader) != visited.end()) {
+        return false;
+      }
+      visited.push_back(*loader);
+      const PathId *next = waits.find(*loader);
+      if (!next) return false;
+      loader = loaders.find(*next);
+    }
+    return false;
+  }
+
+  // Take a prepared load that another thread is blocked on. Must hold loadLock.
+  AsyncLoad *takeAwaited() {
+    for (auto queue : {&prepared, &expanded}) {
+      for (auto load : *queue) {
+        if (!load->awaited || load->state != AsyncState::Prepared) continue;
+        unlinkLoad(load);
+        return load;
+      }
+    }
+    return nullptr;
+  }
+
+  /* Take a pending Resource's load out of the queue once it's prepared -
+   * preparing it on this thread if no worker has gotten to it yet - or wait for
+   * another thread to finish loading it. Loads needing the GL context are only
+   * finished on the owning thread; other threads just prepare them if need be,
+   * and mark them awaited for update() to finish first. While the owning
+   * thread waits, it finishes awaited loads itself, so the threads blocked on
+   * them can't end up blocking it in turn. Dependency cycles get the Resource
+   * as-is: on this thread via loadingHere, and between threads by refusing
+   * whichever wait would close the cycle.
+   * @return The load for the caller to finish, or nullptr if it's done (or
+   * can't be waited on).
+   */
+  AsyncLoad *claim(Resource *res, const ResourcePath &path) {
+    for (auto &loading : loadingHere) {
+      if (loading.res == res) return nullptr;
+    }
+    const PathId id = path.id();
+    const bool owner = onOwnerThread();
+    const bool finishHere = owner || !res->needsGpuContext();
+    SDL_LockMutex(loadLock);
+    while (res->isPending()) {
+      AsyncLoad *const *found = loads.find(id);
+      AsyncLoad *load = found && (*found)->res.get() == res ? *found : nullptr;
+      const bool claimable = load && (load->state == AsyncState::Queued ||
+                                      load->state == AsyncState::Prepared);
+      if (claimable && finishHere) {
+        unlinkLoad(load);
+        SDL_UnlockMutex(loadLock);
+        if (load->state == AsyncState::Queued) prepare(load);
+        return load;
+      }
+      if (load) load->awaited = true;
+      if (claimable && load->state == AsyncState::Queued) {
+        // Do the thread-safe part here, and leave the rest to update()
+        queued.erase(std::find(queued.begin(), queued.end(), load));
+        load->state = AsyncState::Preparing;
+        SDL_UnlockMutex(loadLock);
+        prepare(load);
+        SDL_LockMutex(loadLock);
+        load->state = AsyncState::Prepared;
+        prepared.push_back(load);
+        SDL_BroadcastCondition(loadProgressed);
+        continue;
+      }
+      AsyncLoad *awaited = owner ? takeAwaited() : nullptr;
+      if (awaited) {
+        SDL_UnlockMutex(loadLock);
+        finish(awaited);
+        SDL_LockMutex(loadLock);
+        continue;
+      }
+      if (waitWouldCycle(id)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "ResourceManager::getOrCreate: '%s' is loading on a "
+                     "thread that's waiting on this one (a dependency cycle); "
+                     "returning it unfinished.\n",
+                     path.c_str());
+        break;
+      }
+      waits.put(SDL_ThreadID(), id);
+      SDL_WaitCondition(loadProgressed, loadLock);
+      waits.erase(SDL_ThreadID());
+    }
+    SDL_UnlockMutex(loadLock);
+    return nullptr;
+  }
+
+  // Queue a newly-created Resource to load in the background
+  void queueLoad(const ResourcePath &resPath, const StrongRes &strong) {
+    SDL_LockMutex(loadLock);
+    if (workers.empty()) startWorkers();
+    if (!loadCount) progress = {0, 0};
+    ++progress.queued;
+    const bool mappable = !hotReloadable();
+    AsyncLoad *load =
+        new AsyncLoad{resPath.c_str(), resPath.id(), strong, AsyncState::Queued,
+                      false, nullptr, 0, nullptr, mappable, false, false, {},
+                      {}};
+    loads.put(resPath.id(), load);
+    ++loadCount;
+    queued.push_back(load);
+    SDL_SignalCondition(loadQueued);
+    SDL_UnlockMutex(loadLock);
+  }
+
+  // Loads that need the GL context finish on the thread that created this
+  SDL_threadID ownerThread;
+  bool onOwnerThread() const { return SDL_ThreadID() == ownerThread; }
+  Impl() {
+    for (auto &shard : shards) {
+      shard.lock = SDL_CreateRWLock();
+    }
+    cacheLock = SDL_CreateMutex();
+    loadLock = SDL_CreateMutex();
+    loadQueued = SDL_CreateCondition();
+    loadProgressed = SDL_CreateCondition();
+    loadBudgetNS = 4 * SDL_NS_PER_MS;
+    loadCount = 0;
+    stopWorkers = false;
+    progress = {0, 0};
+    retainedBytes = 0;
+    retentionBudget = 64 * 1024 * 1024;
+    stats = {0, 0, 0, 0, 0};
+    hits = 0;
+    misses = 0;
+    updateLock = SDL_CreateMutex();
+    ownerThread = SDL_ThreadID();
 #ifdef RENITY_DEBUG
-  // Implement hot-reload in debug mode
-  dmon_watch_id watchId;
+    watchId.id = 0;
+#endif
+  }
+  ~Impl() {
+    stopAndClearLoads();
+    SDL_DestroyCondition(loadProgressed);
+    SDL_DestroyCondition(loadQueued);
+    SDL_DestroyMutex(loadLock);
+    SDL_DestroyMutex(cacheLock);
+    for (auto &shard : shards) {
+      SDL_DestroyRWLock(shard.lock);
+    }
+    SDL_DestroyMutex(updateLock);
+  }
+
+  // Reloads requested since the last update(), e.g. by the file watcher
   Vector<ResourceUpdate> updates;
   SDL_Mutex *updateLock;
-  Impl() {
-    watchId.id = 0;
-    updateLock = SDL_CreateMutex();
+
+  // Reload changed Resources, then their dependents, each once and in order
+  void reloadChanged(const Vector<ResourceUpdate> &changes) {
+    Vector<PathId> changed;
+    IdHashTable<bool> deleted;
+    for (auto &change : changes) {
+      PathId id = hashPath(change.path.c_str());
+      changed.push_back(id);
+      if (!change.fileStillValid) deleted.put(id, true);
+    }
+
+    // Loaded Resources all have stats, which conveniently hold their paths
+    Vector<String> paths;
+    SDL_LockMutex(cacheLock);
+    Vector<PathId> order = reloadOrder(changed);
+    for (auto id : order) {
+      const ResourceLoadStats *stats = loadStats.find(id);
+      paths.push_back(stats ? stats->path : "");
+    }
+    SDL_UnlockMutex(cacheLock);
+
+    for (size_t i = 0; i < order.size(); ++i) {
+      ResourcePtr res = find(order[i]);
+      if (!res || res->isPending() || paths[i].empty()) continue;
+      SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
+                   "ResourceManager::Impl::reloadChanged: Reloading '%s'\n",
+                   paths[i].c_str());
+
+      // Generated Resources have no file to reload, but can still respond
+      ResourcePath path(paths[i].c_str());
+      if (path.c_str()[0] != '<') {
+        SDL_RWops *ops = nullptr;
+        ResourceLoadStats stats = {};
+        if (!deleted.exists(path.id())) {
+          ops = timedOpen(path.c_str(), &stats, false);
+        }
+        clearDependencies(path.id());
+        loadingHere.push_back({res.get(), path.id()});
+        timedLoad(res.get(), ops, stats);
+        loadingHere.pop_back();
+        recordLoad(path, stats);
+        measure(path.id(), res);
+      }
+      res->runReloadCallbacks();
+    }
   }
-  ~Impl() { SDL_DestroyMutex(updateLock); }
+
+  // Whether files may change under a load, and so mustn't be mapped
+  bool hotReloadable() const {
+#ifdef RENITY_DEBUG
+    return watchId.id > 0;
+#else
+    return false;
+#endif
+  }
+
+#ifdef RENITY_DEBUG
+  // Implement hot-reload in debug mode
+  dmon_watch_id watchId;
   static void dmonCallback(dmon_watch_id watch_id, dmon_action action,
                            const char *rootdir, const char *filepath,
                            const char *oldFilepath, void *user) {
@@ -57,11 +906,9 @@ struct ResourceManager::Impl {
     String absOldPathStr("/");
     Impl *pimpl_ = (Impl *)(user);
     SDL_LockMutex(pimpl_->updateLock);
-    bool known = pimpl_->map.exists(absPathStr);
-    WeakRes &weak = pimpl_->map.get(absPathStr);
-    const char *statusStr =
-        weak.expired() ? (known ? "known" : "unused") : "active";
-    ResourcePtr res = weak.lock();
+    bool known;
+    ResourcePtr res = pimpl_->find(hashPath(absPath), &known);
+    const char *statusStr = res ? "active" : (known ? "known" : "unused");
     bool fileStillValid = true;
     switch (action) {
       case DMON_ACTION_CREATE:
@@ -76,16 +923,16 @@ struct ResourceManager::Impl {
         break;
       case DMON_ACTION_MOVE:
         absOldPathStr += oldFilepath;
-        WeakRes &weakOld = pimpl_->map.get(absOldPathStr);
+        ResourcePtr resOld = pimpl_->find(hashPath(absOldPathStr.c_str()));
         SDL_Log("MOVE: [baseDir]%s (%s) -> [baseDir]%s (%s)",
-                absOldPathStr.c_str(), weakOld.expired() ? "unused" : "active",
-                absPath, statusStr);
-        if (!weakOld.expired()) {
+                absOldPathStr.c_str(), resOld ? "active" : "unused", absPath,
+                statusStr);
+        if (resOld) {
           pimpl_->updates.push_back({absOldPathStr, false});
         }
         break;
     }
-    if (!weak.expired()) {
+    if (res) {
       pimpl_->updates.push_back({absPathStr, fileStillValid});
     }
     SDL_UnlockMutex(pimpl_->updateLock);
@@ -94,6 +941,7 @@ struct ResourceManager::Impl {
 };
 
 RENITY_API ResourceManager::ResourceManager() {
+  registerBuiltinTypes();
   pimpl_ = new Impl();
   if (!currentResourceManager) currentResourceManager = this;
 }
@@ -130,64 +978,343 @@ RENITY_API void ResourceManager::activate() {
   currentResourceManager = this;
 }
 
-RENITY_API void ResourceManager::update() {
-#ifdef RENITY_DEBUG
-  // Don't wait for the file watcher to finish, just try again next frame
-  if (SDL_TryLockMutex(pimpl_->updateLock) != 0) {
-    return;
+RENITY_API void ResourceManager::setLoadBudget(Uint64 budgetNS) {
+  pimpl_->loadBudgetNS = budgetNS;
+}
+
+RENITY_API void ResourceManager::setRetentionBudget(size_t budgetBytes) {
+  // Only stored; the next update() trims to it, on the owning thread
+  SDL_LockMutex(pimpl_->cacheLock);
+  pimpl_->retentionBudget = budgetBytes;
+  SDL_UnlockMutex(pimpl_->cacheLock);
+}
+
+RENITY_API ResourceCacheStats ResourceManager::getCacheStats() const {
+  SDL_LockMutex(pimpl_->cacheLock);
+  ResourceCacheStats stats = pimpl_->stats;
+  for (auto &entry : pimpl_->retained) {
+    if (entry.res.use_count() == 1) {
+      ++stats.retainedCount;
+      stats.retainedBytes += entry.bytes;
+    }
   }
+  SDL_UnlockMutex(pimpl_->cacheLock);
+  stats.hits = pimpl_->hits;
+  stats.misses = pimpl_->misses;
+  return stats;
+}
 
-  for (auto update : pimpl_->updates) {
-    ResourcePtr res = pimpl_->map.get(update.path).lock();
-    SDL_RWops *ops = nullptr;
-    if (update.fileStillValid) {
-      ops = PHYSFSRWOPS_openRead(update.path.c_str());
+RENITY_API Vector<ResourceLoadStats> ResourceManager::getLoadStats() const {
+  Vector<ResourceLoadStats> allStats;
+  SDL_LockMutex(pimpl_->cacheLock);
+  pimpl_->loadStats.enumerate([this, &allStats](const ResourceLoadStats &s) {
+    ResourceLoadStats stats = s;
+    StrongRes res = pimpl_->find(hashPath(stats.path.c_str()));
+    if (res) {
+      // Don't count our own temporary reference
+      stats.refCount = res.use_count() - 1;
+      // Nor size Resources a worker may still be filling in
+      if (!res->isPending()) {
+        stats.cpuBytes = res->getCpuBytes();
+        stats.gpuBytes = res->getGpuBytes();
+      }
     }
-    res->load(ops);
-    if (res->cb_) res->cb_(res->userdata_);
+    allStats.push_back(stats);
+    return true;
+  });
+  SDL_UnlockMutex(pimpl_->cacheLock);
+  return allStats;
+}
+
+RENITY_API bool ResourceManager::saveLoadStats(const char *destPath) const {
+  Dictionary dump;
+  dump.putArray("resources");
+  dump.select("resources");
+  Uint32 index = 0;
+  for (auto &stats : getLoadStats()) {
+    dump.selectIndex(index++, true);
+    dump.put<const char *>("path", stats.path.c_str());
+    dump.put<double>("openMS", (double)stats.openNS / SDL_NS_PER_MS);
+    dump.put<double>("readMS", (double)stats.readNS / SDL_NS_PER_MS);
+    dump.put<double>("parseMS", (double)stats.parseNS / SDL_NS_PER_MS);
+    dump.put<double>("uploadMS", (double)stats.uploadNS / SDL_NS_PER_MS);
+    dump.put<double>("bytesRead", (double)stats.bytesRead);
+    dump.put<Uint32>("reloadCount", stats.reloadCount);
+    dump.put<Sint32>("refCount", (Sint32)stats.refCount);
+    dump.put<double>("cpuBytes", (double)stats.cpuBytes);
+    dump.put<double>("gpuBytes", (double)stats.gpuBytes);
+    dump.unwind(1);
   }
-  pimpl_->updates.clear();
-  SDL_UnlockMutex(pimpl_->updateLock);
-#endif
+  dump.unwind();
+  return dump.saveJSON(destPath);
+}
+
+RENITY_API void ResourceManager::update() {
+  // Queue up dependencies of newly-prepared loads, so they load in parallel.
+  // Marking them Expanding keeps other threads from claiming them meanwhile.
+  Deque<AsyncLoad *> prepared;
+  SDL_LockMutex(pimpl_->loadLock);
+  prepared.swap(pimpl_->prepared);
+  for (auto load : prepared) load->state = AsyncState::Expanding;
+  SDL_UnlockMutex(pimpl_->loadLock);
+  for (auto load : prepared) {
+    Vector<ResourceRef> refs;
+    if (load->staged) load->res->getDependencies(refs);
+    for (auto &ref : refs) {
+      StrongRes dep = getAsync(ref.path.c_str(), ref.type.c_str());
+      if (dep && dep->isPending()) load->deps.push_back(dep);
+    }
+    SDL_LockMutex(pimpl_->loadLock);
+    load->state = AsyncState::Prepared;
+    load->expanded = true;
+    pimpl_->expanded.push_back(load);
+    SDL_BroadcastCondition(pimpl_->loadProgressed);
+    SDL_UnlockMutex(pimpl_->loadLock);
+  }
+
+  // Apply finished background loads, until the budget runs out
+  const Uint64 start = SDL_GetTicksNS();
+  AsyncLoad *load;
+  while ((load = pimpl_->takeReady())) {
+    pimpl_->finish(load);
+    if (SDL_GetTicksNS() - start >= pimpl_->loadBudgetNS) break;
+  }
+
+  // Apply this frame's reloads in one batch. Don't wait for the file watcher
+  // to finish, though, just try again next frame.
+  if (SDL_TryLockMutex(pimpl_->updateLock) == 0) {
+    Vector<ResourceUpdate> updates;
+    updates.swap(pimpl_->updates);
+    SDL_UnlockMutex(pimpl_->updateLock);
+    if (!updates.empty()) pimpl_->reloadChanged(updates);
+  }
+
+  // Sizes change as Resources (re)load, and outside references come and go
+  pimpl_->trim();
+  pimpl_->releaseDiscarded();
 }
 
 RENITY_API void ResourceManager::clear() {
   if (currentResourceManager == this) {
     currentResourceManager = nullptr;
   }
-  pimpl_->map.clear();
+  pimpl_->stopAndClearLoads();
+  pimpl_->releaseDiscarded();
+  SDL_LockMutex(pimpl_->cacheLock);
+  pimpl_->retainedIndex.clear();
+  pimpl_->retained.clear();
+  pimpl_->retainedBytes = 0;
+  pimpl_->loadStats.clear();
+  pimpl_->dependencies.clear();
+  pimpl_->dependents.clear();
+  SDL_UnlockMutex(pimpl_->cacheLock);
+  for (auto &shard : pimpl_->shards) {
+    SDL_LockRWLockForWriting(shard.lock);
+    shard.map.clear();
+    SDL_UnlockRWLock(shard.lock);
+  }
 }
 
 RENITY_API SharedPtr<Resource> ResourceManager::getOrCreate(
-    const char *path, Resource *(*factory)(SDL_RWops *)) {
-  WeakRes &weak = pimpl_->map.get(path);
-  if (!weak.expired()) {
+    const ResourcePath &resPath, ResourceFactory factory) {
+  const char *path = resPath.c_str();
+  if (!path) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "ResourceManager::getOrCreate: No path specified - creating "
+                "empty Resource.\n");
+    const StrongRes &strong = StrongRes(factory());
+    strong->load(nullptr);
+    return strong;
+  }
+  pimpl_->noteRequest(resPath.id());
+
+  bool created, collided;
+  StrongRes strong =
+      pimpl_->findOrCreate(resPath, factory, &created, &collided);
+  if (collided) {
+    // Rare enough to just load a private copy rather than share the wrong one
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "ResourceManager::getOrCreate: '%s' has the same PathId "
+                 "(%016" SDL_PRIx64 ") as another path; loading it uncached.\n",
+                 path, resPath.id());
+    strong = StrongRes(factory());
+    ResourceLoadStats stats = {};
+    Impl::timedLoad(strong.get(),
+                    timedOpen(path, &stats, !pimpl_->hotReloadable()), stats);
+    return strong;
+  }
+  if (!created) {
     SDL_LogVerbose(
         SDL_LOG_CATEGORY_APPLICATION,
         "ResourceManager::getOrCreate: Returning EXISTING ptr for '%s'\n",
         path);
-    return weak.lock();
+    if (strong->isPending()) {
+      AsyncLoad *load = pimpl_->claim(strong.get(), resPath);
+      if (load) pimpl_->finish(load);
+    }
+    ++pimpl_->hits;
+    pimpl_->touch(resPath.id(), strong);
+    return strong;
+  }
+
+  // Off the owning thread, Resources that upload to the GPU are read and
+  // decoded here as usual, but left for update() to finish
+  if (path[0] != '<' && strong->needsGpuContext() &&
+      !pimpl_->onOwnerThread()) {
+    ++pimpl_->misses;
+    pimpl_->retain(resPath.id(), strong);
+    pimpl_->queueLoad(resPath, strong);
+    AsyncLoad *load = pimpl_->claim(strong.get(), resPath);
+    if (load) pimpl_->finish(load);
+    return strong;
   }
 
   SDL_RWops *ops = nullptr;
-  if (!path) {
-    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                "ResourceManager::getOrCreate: No path specified - creating "
-                "empty Resource.\n");
-  } else if (path[0] != '<') {  // internal, non-file resources use <names>
-    ops = PHYSFSRWOPS_openRead(path);
+  ResourceLoadStats stats = {};
+  if (path[0] != '<') {  // internal, non-file resources use <names>
+    ops = timedOpen(path, &stats, !pimpl_->hotReloadable());
     SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
                    "ResourceManager::getOrCreate: CREATING ptr for '%s' (%s)\n",
                    path, ops ? "valid" : "NOT valid");
     if (!ops) {
       SDL_LogError(SDL_LOG_CATEGORY_SYSTEM,
-                   "ResourceManager::getOrCreate: PHYSFSRWOPS_openRead(\"%s\") "
+                   "ResourceManager::getOrCreate: RENITY_OpenRead(\"%s\") "
                    "failed: '%s'\n",
                    path, SDL_GetError());
     }
   }
-  const StrongRes &strong = StrongRes(factory(ops));
-  weak = strong;
+  // Should end up with a default resource if the file wasn't opened.
+  pimpl_->beginLoad(resPath.id());
+  loadingHere.push_back({strong.get(), resPath.id()});
+  Impl::timedLoad(strong.get(), ops, stats);
+  loadingHere.pop_back();
+  pimpl_->endLoad(strong.get(), resPath.id());
+  ++pimpl_->misses;
+  pimpl_->recordLoad(resPath, stats);
+  pimpl_->retain(resPath.id(), strong);
   return strong;
 }
+
+RENITY_API SharedPtr<Resource> ResourceManager::getOrCreateAsync(
+    const ResourcePath &resPath, ResourceFactory factory) {
+  // Generated resources have nothing to load in the background
+  const char *path = resPath.c_str();
+  if (!path || path[0] == '<') {
+    return getOrCreate(resPath, factory);
+  }
+  pimpl_->noteRequest(resPath.id());
+
+  // Already loaded or loading; pending ones keep filling in as usual
+  bool created, collided;
+  StrongRes strong =
+      pimpl_->findOrCreate(resPath, factory, &created, &collided);
+  if (collided) return getOrCreate(resPath, factory);
+  if (!created) {
+    ++pimpl_->hits;
+    pimpl_->touch(resPath.id(), strong);
+    return strong;
+  }
+
+  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                 "ResourceManager::getOrCreateAsync: QUEUEING ptr for '%s'\n",
+                 path);
+  strong->load(nullptr);
+  ++pimpl_->misses;
+  pimpl_->retain(resPath.id(), strong);
+  pimpl_->queueLoad(resPath, strong);
+  return strong;
+}
+
+RENITY_API void ResourceManager::reload(const ResourcePath &path) {
+  if (!path.c_str()) return;
+  SDL_LockMutex(pimpl_->updateLock);
+  pimpl_->updates.push_back({path.c_str(), true});
+  SDL_UnlockMutex(pimpl_->updateLock);
+}
+
+RENITY_API void ResourceManager::release(const ResourcePath &path) {
+  if (!path.c_str()) return;
+  SDL_LockMutex(pimpl_->cacheLock);
+  if (pimpl_->retainedIndex.exists(path.id())) {
+    RetainedList::iterator it = pimpl_->retainedIndex.get(path.id());
+    pimpl_->retainedBytes -= it->bytes;
+    pimpl_->discarded.push_back(std::move(it->res));
+    pimpl_->retainedIndex.erase(path.id());
+    pimpl_->retained.erase(it);
+  }
+  SDL_UnlockMutex(pimpl_->cacheLock);
+}
+
+RENITY_API Vector<String> ResourceManager::getDependents(
+    const ResourcePath &path) const {
+  Vector<String> paths;
+  SDL_LockMutex(pimpl_->cacheLock);
+  const Vector<PathId> *users = pimpl_->dependents.find(path.id());
+  if (users) {
+    for (auto id : *users) {
+      const ResourceLoadStats *stats = pimpl_->loadStats.find(id);
+      if (stats) paths.push_back(stats->path);
+    }
+  }
+  SDL_UnlockMutex(pimpl_->cacheLock);
+  return paths;
+}
+
+RENITY_API SharedPtr<Resource> ResourceManager::getAsync(const char *path,
+                                                         const char *typeName) {
+  ResourceFactory factory = findFactory(path, typeName);
+  if (!factory) return nullptr;
+  return getOrCreateAsync(path, factory);
+}
+
+RENITY_API Vector<ResourcePtr> ResourceManager::preload(
+    const Vector<ResourceRef> &refs) {
+  Vector<ResourcePtr> resources;
+  for (auto &ref : refs) {
+    ResourcePtr res = getAsync(ref.path.c_str(), ref.type.c_str());
+    if (res) resources.push_back(res);
+  }
+  return resources;
+}
+
+RENITY_API Vector<ResourcePtr> ResourceManager::preload(
+    const char *manifestPath) {
+  // Load the manifest like any other Resource, so it's timed and cached too
+  Vector<ResourceRef> refs;
+  DictionaryPtr manifest = get<Dictionary>(manifestPath);
+  manifest->enumerateArray(
+      "resources", [&refs](Dictionary &dict, const Uint32 &index) {
+        const char *path = nullptr, *type = "";
+        if (!dict.get<const char *>(nullptr, &path) &&
+            !dict.get<const char *>("path", &path)) {
+          SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                       "ResourceManager::preload: Missing path for entry %u",
+                       index);
+          return true;
+        }
+        dict.get<const char *>("type", &type);
+        refs.push_back({path, type});
+        return true;
+      });
+  SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
+               "ResourceManager::preload: Preloading %zu resource(s) from '%s'",
+               refs.size(), manifestPath);
+  return preload(refs);
+}
+
+RENITY_API ResourceLoadProgress ResourceManager::getLoadProgress() const {
+  SDL_LockMutex(pimpl_->loadLock);
+  ResourceLoadProgress progress = pimpl_->progress;
+  SDL_UnlockMutex(pimpl_->loadLock);
+  return progress;
+}
+
+RENITY_API void ResourceManager::registerFactory(
+    const char *typeName, ResourceFactory factory,
+    const Vector<String> &extensions) {
+  getFactories().put(typeName, factory);
+  for (auto &ext : extensions) {
+    getExtensionTypes().put(toLower(ext), typeName);
+  }
+}
 }  // namespace renity
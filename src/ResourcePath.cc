@@ -0,0 +1,42 @@
+/****************************************************
+ * ResourcePath.cc: Prehashed resource path handles *
+ * Copyright (C) 2023 by Zach Caldwell              *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+
+#include "ResourcePath.h"
+
+#include <SDL3/SDL.h>
+
+#include "HashTable.h"
+
+namespace renity {
+RENITY_API ResourcePath ResourcePath::intern(const char *path) {
+  if (!path) return ResourcePath(nullptr);
+
+  // List elements never move, so their strings stay valid once interned.
+  // Paths are bucketed by PathId, and buckets only grow past one on collisions.
+  static IdHashTable<List<String>> pool;
+  static SDL_Mutex *poolLock = SDL_CreateMutex();
+  const PathId id = hashPath(path);
+  SDL_LockMutex(poolLock);
+  List<String> &bucket = pool.get(id);
+  const char *interned = nullptr;
+  for (auto &str : bucket) {
+    if (str == path) {
+      interned = str.c_str();
+      break;
+    }
+  }
+  if (!interned) {
+    bucket.push_back(path);
+    interned = bucket.back().c_str();
+  }
+  SDL_UnlockMutex(poolLock);
+  return ResourcePath(interned);
+}
+}  // namespace renity
@@ -11,6 +11,7 @@
 
 #include <SDL3/SDL_log.h>
 
+#include "CookedFile.h"
 #include "Dictionary.h"
 #include "gl3.h"
 
@@ -19,24 +20,128 @@ static GLchar infoLog[INFO_LOG_SIZE];
 static GLenum drawMode = GL_TRIANGLES;
 
 namespace renity {
-struct GL_Mesh::Impl {
-  explicit Impl() : loaded(false), elementCount(0) {
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
-    glGenBuffers(1, &ibo);
+static const Uint32 COOKED_MESH = cookedTag("MESH");
+static const Uint32 VERTS_SECTION = cookedTag("VERT");
+static const Uint32 INDICES_SECTION = cookedTag("INDX");
+static const Uint32 UVS_SECTION = cookedTag("UVS ");
+
+// Read a mesh file, filling in any indices or UVs it leaves out
+static bool readMesh(Dictionary &details, Vector<float> &vertices,
+                     Vector<Uint32> &indices, Vector<float> &uvs) {
+  // Load vertices, bailing out if there aren't any
+  details.getArray("vertices", vertices);
+  Uint32 vertCount = vertices.size();
+  if (vertCount == 0) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "GL_Mesh::load: No vertices found");
+    return false;
+  }
+  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                 "GL_Mesh::load: Loaded %i vertex floats", vertCount);
+
+  // Load indices, treating vertex order as index order if there's no indices
+  details.getArray("indices", indices);
+  Uint32 indCount = indices.size();
+  if (indCount == 0) {
+    indCount = vertCount / 3;
+    SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                   "GL_Mesh::load: No indices found; creating monotonic list");
+    indices.reserve(indCount);
+    for (Uint32 index = 0; index < indCount; ++index) {
+      indices.push_back(index);
+    }
   }
+  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                 "GL_Mesh::load: Loaded %i of %i indices", indices.size(),
+                 indCount);
+
+  // Load texture UVs, basing them on X/Y vertices if they're not specified
+  details.getArray("uvs", uvs);
+  Uint32 uvCount = uvs.size();
+  if (uvCount == 0) {
+    uvCount = (vertCount / 3) * 2;
+    SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
+                 "GL_Mesh::load: No UVs found; normalizing from X/Y vertices");
+    uvs.reserve(uvCount);
+    for (Uint32 index = 0; index < uvCount; ++index) {
+      // 2 UVs for every 3 vertices
+      float vertex = vertices[index + (index / 2)];
+      // Convert from [-1.0, 1.0] to [0.0, 1.0]
+      float uv = (vertex + 1.0f) / 2.0f;
+      uvs.push_back(uv);
+    }
+  }
+  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                 "GL_Mesh::load: Loaded %i of %i UVs", uvs.size(), uvCount);
+  return true;
+}
+
+struct GL_Mesh::Impl {
+  explicit Impl()
+      : loaded(false), vao(0), vbo(0), ebo(0), ibo(0), elementCount(0),
+        bufferBytes(0) {}
 
   ~Impl() {
+    if (!vao) return;
     glDeleteVertexArrays(1, &vao);
     glDeleteBuffers(1, &vbo);
     glDeleteBuffers(1, &ebo);
     glDeleteBuffers(1, &ibo);
   }
 
+  // Reallocate the buffers and upload vertex, UV, and index data
+  void upload(Span<const float> vertices, Span<const Uint32> indices,
+              Span<const float> uvs) {
+    const size_t vertSize = sizeof(float) * vertices.size();
+    const size_t uvSize = sizeof(float) * uvs.size();
+    // Created here rather than in the constructor, since ResourceManager may
+    // construct meshes on threads without a GL context
+    if (!vao) {
+      glGenVertexArrays(1, &vao);
+      glGenBuffers(1, &vbo);
+      glGenBuffers(1, &ebo);
+      glGenBuffers(1, &ibo);
+    }
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    // TODO: Select the buffer usage more intelligently and/or with a field
+    glBufferData(GL_ARRAY_BUFFER, vertSize + uvSize, nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertSize, vertices.data());
+    glBufferSubData(GL_ARRAY_BUFFER, vertSize, uvSize, uvs.data());
+
+    // Upload the indices to their own array buffer
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Uint32) * indices.size(),
+                 indices.data(), GL_STATIC_DRAW);
+
+    // Configure and enable the interpretation of the vertex and UV attributes
+    // glVertexAttribPointer also "binds" the VBO/EBO to VAO attribute(s)
+    // For a better explanation, see https://stackoverflow.com/a/59892245
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float),
+                          (const void *)vertSize);
+    glEnableVertexAttribArray(1);
+
+    // Configure the instances buffer that will be filled every draw call
+    glBindBuffer(GL_ARRAY_BUFFER, ibo);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(MeshPosition), 0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribIPointer(3, 2, GL_UNSIGNED_INT, sizeof(MeshPosition),
+                           (void *)(offsetof(MeshPosition, u)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    elementCount = indices.size();
+    bufferBytes = vertSize + uvSize + sizeof(Uint32) * indices.size();
+    loaded = true;
+  }
+
   bool loaded;
   GLuint vao, vbo, ebo, ibo;
   Uint32 elementCount;
+  size_t bufferBytes;
 };
 
 RENITY_API GL_Mesh::GL_Mesh() { pimpl_ = new Impl(); }
@@ -56,6 +161,7 @@ RENITY_API void GL_Mesh::draw(const Vector<MeshPosition> &instances) {
                 "GL_Mesh::use: Attempted to use unloaded mesh %i", pimpl_->vao);
   }
 #endif
+  if (!pimpl_->vao) return;
   glBindVertexArray(pimpl_->vao);
   glBindBuffer(GL_ARRAY_BUFFER, pimpl_->ibo);
   glBufferData(GL_ARRAY_BUFFER, sizeof(MeshPosition) * instances.size(),
@@ -65,121 +171,42 @@ RENITY_API void GL_Mesh::draw(const Vector<MeshPosition> &instances) {
 }
 
 RENITY_API void GL_Mesh::load(SDL_RWops *src) {
-  Vector<float> vertices;
-  Dictionary details;
-  details.load(src);
-
-  // Load vertices, bailing out if there aren't any
-  Uint32 vertCount = details.end("vertices");
-  if (vertCount == 0 || vertCount == UINT32_MAX) {
-    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                "GL_Mesh::load: No vertices found");
+  // Cooked meshes already have their indices and UVs filled in
+  CookedFile cooked;
+  if (cooked.open(src, COOKED_MESH)) {
+    const Span<const float> vertices = cooked.getSection<float>(VERTS_SECTION);
+    if (vertices.empty()) {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                  "GL_Mesh::load: No vertices found");
+      return;
+    }
+    pimpl_->upload(vertices, cooked.getSection<Uint32>(INDICES_SECTION),
+                   cooked.getSection<float>(UVS_SECTION));
     return;
   }
-  vertices.reserve(vertCount);
-  details.enumerateArray("vertices",
-                         [&vertices](Dictionary &dict, const Uint32 &index) {
-                           float val;
-                           if (dict.get<float>(nullptr, &val)) {
-                             vertices.push_back(val);
-                           }
-                           return true;
-                         });
-  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
-                 "GL_Mesh::load: Loaded %i of %i vertex floats",
-                 vertices.size(), vertCount);
 
-  // Load indices, treating vertex order as index order if there's no indices
+  Vector<float> vertices, uvs;
   Vector<Uint32> indices;
-  Uint32 indCount = details.end("indices");
-  if (indCount == 0 || indCount == UINT32_MAX) {
-    indCount = vertCount / 3;
-    SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
-                   "GL_Mesh::load: No indices found; creating monotonic list");
-    indices.reserve(indCount);
-    for (Uint32 index = 0; index < indCount; ++index) {
-      indices.push_back(index);
-    }
-  } else {
-    indices.reserve(indCount);
-    details.enumerateArray("indices",
-                           [&indices](Dictionary &dict, const Uint32 &index) {
-                             Uint32 val;
-                             if (dict.get<Uint32>(nullptr, &val)) {
-                               indices.push_back(val);
-                             }
-                             return true;
-                           });
-  }
-  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
-                 "GL_Mesh::load: Loaded %i of %i indices", indices.size(),
-                 indCount);
-
-  // Load texture UVs, basing them on X/Y vertices if they're not specified
-  Vector<float> uvs;
-  Uint32 uvCount = details.end("uvs");
-  if (uvCount == 0 || uvCount == UINT32_MAX) {
-    uvCount = (vertCount / 3) * 2;
-    SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
-                 "GL_Mesh::load: No UVs found; normalizing from X/Y vertices");
-    uvs.reserve(uvCount);
-    for (Uint32 index = 0; index < uvCount; ++index) {
-      // 2 UVs for every 3 vertices
-      float vertex = vertices[index + (index / 2)];
-      // Convert from [-1.0, 1.0] to [0.0, 1.0]
-      float uv = (vertex + 1.0f) / 2.0f;
-      uvs.push_back(uv);
-    }
-  } else {
-    uvs.reserve(uvCount);
-    details.enumerateArray("uvs",
-                           [&uvs](Dictionary &dict, const Uint32 &index) {
-                             float val;
-                             if (dict.get<float>(nullptr, &val)) {
-                               uvs.push_back(val);
-                             }
-                             return true;
-                           });
-  }
-  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
-                 "GL_Mesh::load: Loaded %i of %i UVs", uvs.size(), uvCount);
+  Dictionary details;
+  details.load(src);
+  if (!readMesh(details, vertices, indices, uvs)) return;
 
-  // Unload the mesh file, reallocate the buffer, and upload vertex and UV data
+  // Unload the mesh file before uploading
   details.load(nullptr);
-  const size_t vertSize = sizeof(float) * vertices.size();
-  const size_t uvSize = sizeof(float) * uvs.size();
-  glBindVertexArray(pimpl_->vao);
-  glBindBuffer(GL_ARRAY_BUFFER, pimpl_->vbo);
-  // TODO: Select the buffer usage more intelligently and/or with a field
-  glBufferData(GL_ARRAY_BUFFER, vertSize + uvSize, nullptr, GL_STATIC_DRAW);
-  glBufferSubData(GL_ARRAY_BUFFER, 0, vertSize, vertices.data());
-  glBufferSubData(GL_ARRAY_BUFFER, vertSize, uvSize, uvs.data());
-
-  // Upload the indices to their own array buffer
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pimpl_->ebo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Uint32) * indices.size(),
-               indices.data(), GL_STATIC_DRAW);
-
-  // Configure and enable the interpretation of the vertex and UV attributes
-  // glVertexAttribPointer also "binds" the VBO/EBO to VAO attribute(s)
-  // For a better explanation, see https://stackoverflow.com/a/59892245
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float),
-                        (const void *)vertSize);
-  glEnableVertexAttribArray(1);
-
-  // Configure the instances buffer that will be filled every draw call
-  glBindBuffer(GL_ARRAY_BUFFER, pimpl_->ibo);
-  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(MeshPosition), 0);
-  glEnableVertexAttribArray(2);
-  glVertexAttribDivisor(2, 1);
-  glVertexAttribIPointer(3, 2, GL_UNSIGNED_INT, sizeof(MeshPosition),
-                         (void *)(offsetof(MeshPosition, u)));
-  glEnableVertexAttribArray(3);
-  glVertexAttribDivisor(3, 1);
-
-  pimpl_->elementCount = indCount;
-  pimpl_->loaded = true;
+  pimpl_->upload({vertices.data(), vertices.size()},
+                 {indices.data(), indices.size()}, {uvs.data(), uvs.size()});
 }
+
+RENITY_API bool GL_Mesh::cook(Dictionary &dict, CookedFileWriter &out) {
+  out.setType(COOKED_MESH);
+  Vector<float> vertices, uvs;
+  Vector<Uint32> indices;
+  if (!readMesh(dict, vertices, indices, uvs)) return false;
+  out.addSection(VERTS_SECTION, vertices);
+  out.addSection(INDICES_SECTION, indices);
+  out.addSection(UVS_SECTION, uvs);
+  return true;
+}
+
+RENITY_API size_t GL_Mesh::getGpuBytes() const { return pimpl_->bufferBytes; }
 }  // namespace renity
@@ -19,30 +19,42 @@ static GLchar infoLog[INFO_LOG_SIZE];
 
 namespace renity {
 struct GL_Shader::Impl {
-  explicit Impl(GLenum shaderType) : valid(false) {
+  explicit Impl(GLenum shaderType)
+      : valid(false), shader(0), shaderType(shaderType) {
     if (shaderType != GL_VERTEX_SHADER && shaderType != GL_FRAGMENT_SHADER) {
       SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                    "GL_Shader(): Unsupported shader type %i", shaderType);
-      shader = 0;
-      return;
+      this->shaderType = 0;
     }
+  }
+
+  ~Impl() {
+    if (shader) glDeleteShader(shader);
+  }
+
+  /* Create the shader object on first load rather than in the constructor,
+   * since ResourceManager may construct shaders on threads without a GL
+   * context.
+   */
+  bool create() {
+    if (shader || !shaderType) return shader != 0;
     shader = glCreateShader(shaderType);
     if (!shader) {
       SDL_LogError(
           SDL_LOG_CATEGORY_APPLICATION,
           "GL_Shader(): GL error %i while creating type %i shader object",
           glGetError(), shaderType);
-      return;
+      return false;
     }
     SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
                    "GL_Shader(): Successfully created shader %i with type %i",
                    shader, shaderType);
+    return true;
   }
 
-  ~Impl() { glDeleteShader(shader); }
-
   bool valid;
   GLuint shader;
+  GLenum shaderType;
 };
 
 RENITY_API GL_Shader::GL_Shader(GLenum shaderType) {
@@ -56,7 +68,7 @@ RENITY_API GLuint GL_Shader::getShaderIndex() { return pimpl_->shader; }
 RENITY_API bool GL_Shader::isValid() { return pimpl_->valid; }
 
 RENITY_API void GL_Shader::load(SDL_RWops* src) {
-  if (!pimpl_->shader) {
+  if (!pimpl_->create()) {
     return;
   }
 
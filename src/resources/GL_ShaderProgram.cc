@@ -11,6 +11,7 @@
 
 #include <SDL3/SDL_log.h>
 
+#include "CookedFile.h"
 #include "Dictionary.h"
 #include "HashTable.h"
 #include "ResourceManager.h"
@@ -23,22 +24,56 @@ static GLchar infoLog[INFO_LOG_SIZE];
 
 namespace renity {
 GL_ShaderProgram* currentGLShaderProgram = nullptr;
+static const Uint32 COOKED_PROGRAM = cookedTag("PROG");
+static const Uint32 INFO_SECTION = cookedTag("INFO");
+
+// Cooked INFO section layout
+struct CookedProgramInfo {
+  Uint32 vertPath, fragPath;  // Offsets into the strings section
+};
+
+// Read the shader paths from a program file
+static bool readShaderPaths(Dictionary& details, const char** vertPath,
+                            const char** fragPath) {
+  if (!details.get<const char*>("vertexShaderPath", vertPath) ||
+      !details.get<const char*>("fragmentShaderPath", fragPath)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "GL_ShaderProgram::load: Invalid shader details (missing "
+                 "vertexShaderPath [%s] and/or fragmentShaderPath [%s])",
+                 *vertPath, *fragPath);
+    return false;
+  }
+  return true;
+}
 
 struct GL_ShaderProgram::Impl {
   explicit Impl()
-      : dirty(false),
-        valid(false),
+      : valid(false),
+        shaderProgram(0),
         nextBindingPoint(1),
         blendSrc(GL_SRC_ALPHA),
         blendDst(GL_ONE_MINUS_SRC_ALPHA) {
+    SDL_memset(uniformBuffers, 0, sizeof(uniformBuffers));
+  }
+
+  ~Impl() {
+    if (!shaderProgram) return;
+    glDeleteProgram(shaderProgram);
+    glDeleteBuffers(MAX_UNIFORM_BLOCK_NAMES, &uniformBuffers[1]);
+  }
+
+  /* Create the GL objects on first use rather than in the constructor, since
+   * ResourceManager may construct programs on threads without a GL context.
+   */
+  bool create() {
+    if (shaderProgram) return true;
     shaderProgram = glCreateProgram();
     if (!shaderProgram) {
       SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                    "GL_Shader(): GL error %i while creating shader program",
                    glGetError());
-      return;
+      return false;
     }
-    uniformBuffers[0] = 0;
     glGenBuffers(MAX_UNIFORM_BLOCK_NAMES, &uniformBuffers[1]);
     for (Uint32 buf = 1; buf <= MAX_UNIFORM_BLOCK_NAMES; ++buf) {
       if (uniformBuffers[buf] == 0) {
@@ -46,18 +81,13 @@ struct GL_ShaderProgram::Impl {
                      "GL_Shader(): Failed to generate a uniform buffer for "
                      "binding point %u",
                      buf);
-        return;
+        return true;
       }
     }
-  }
-
-  ~Impl() {
-    glDeleteProgram(shaderProgram);
-    glDeleteBuffers(MAX_UNIFORM_BLOCK_NAMES, &uniformBuffers[1]);
+    return true;
   }
 
   void linkProgram() {
-    dirty = false;
     if (!vert->isValid() || !frag->isValid()) {
       SDL_LogWarn(
           SDL_LOG_CATEGORY_APPLICATION,
@@ -102,9 +132,31 @@ struct GL_ShaderProgram::Impl {
       glUniformBlockBinding(shaderProgram, blockIndex, bindingPoint);
       return true;
     });
+
+    // Likewise for sampler units, which need the program in use to set
+    if (samplerUnits.empty()) return;
+    glUseProgram(shaderProgram);
+    for (auto &sampler : samplerUnits) applySamplerUnit(sampler);
+    if (currentGLShaderProgram) {
+      glUseProgram(currentGLShaderProgram->pimpl_->shaderProgram);
+    }
   }
 
-  bool dirty, valid;
+  struct SamplerUnit {
+    String name;
+    GLint unit;
+  };
+
+  // Point a sampler at its texture unit; the program must be in use
+  bool applySamplerUnit(const SamplerUnit& sampler) {
+    const GLint location =
+        glGetUniformLocation(shaderProgram, sampler.name.c_str());
+    if (location < 0) return false;
+    glUniform1i(location, sampler.unit);
+    return true;
+  }
+
+  bool valid;
   GLuint shaderProgram, nextBindingPoint,
       uniformBuffers[MAX_UNIFORM_BLOCK_NAMES + 1];
   GLenum blendSrc, blendDst;
@@ -112,6 +164,7 @@ struct GL_ShaderProgram::Impl {
   GL_FragShaderPtr frag;
   HashTable<String, GLuint> bindingPoints;
   HashTable<GLuint, String> bindingNames;
+  Vector<SamplerUnit> samplerUnits;
 };
 
 RENITY_API GL_ShaderProgram::GL_ShaderProgram() { pimpl_ = new Impl(); }
@@ -120,9 +173,6 @@ RENITY_API GL_ShaderProgram::~GL_ShaderProgram() { delete pimpl_; }
 
 RENITY_API void GL_ShaderProgram::activate() {
   currentGLShaderProgram = this;
-  if (pimpl_->dirty) {
-    pimpl_->linkProgram();
-  }
 #ifdef RENITY_DEBUG
   if (!pimpl_->valid) {
     SDL_LogVerbose(
@@ -131,6 +181,7 @@ RENITY_API void GL_ShaderProgram::activate() {
         pimpl_->shaderProgram);
   }
 #endif
+  pimpl_->create();
   glBlendFunc(pimpl_->blendSrc, pimpl_->blendDst);
   glUseProgram(pimpl_->shaderProgram);
   for (GLuint bindPoint = 1; bindPoint < pimpl_->nextBindingPoint;
@@ -144,12 +195,6 @@ RENITY_API GL_ShaderProgram* GL_ShaderProgram::getActive() {
   return currentGLShaderProgram;
 }
 
-static void flagReload(void* userdata) {
-  GL_ShaderProgram::Impl* pimpl_ =
-      static_cast<GL_ShaderProgram::Impl*>(userdata);
-  pimpl_->dirty = true;
-}
-
 RENITY_API void GL_ShaderProgram::setBlendFunc(Uint32 src, Uint32 dest) {
   pimpl_->blendSrc = src;
   pimpl_->blendDst = dest;
@@ -170,6 +215,8 @@ RENITY_API bool GL_ShaderProgram::setUniformBlock(String blockName,
   }
 #endif
 
+  pimpl_->create();
+
   // Associate binding points with shader program uniform block names, as needed
   // (e.g. "MyBlock" in "layout (std140) uniform MyBlock { vec4 myVec; }")
   if (!pimpl_->bindingPoints.exists(blockName)) {
@@ -217,21 +264,61 @@ template RENITY_API bool GL_ShaderProgram::setUniformBlock(
 template RENITY_API bool GL_ShaderProgram::setUniformBlock(
     String blockName, Vector<unsigned int> uniforms);
 
+RENITY_API bool GL_ShaderProgram::setSamplerUnit(String samplerName,
+                                                 Uint32 unit) {
+  Impl::SamplerUnit sampler = {samplerName, (GLint)unit};
+  bool found = false;
+  for (auto& existing : pimpl_->samplerUnits) {
+    if (existing.name == samplerName) {
+      existing = sampler;
+      found = true;
+    }
+  }
+  if (!found) pimpl_->samplerUnits.push_back(sampler);
+
+  activate();
+  if (!pimpl_->applySamplerUnit(sampler)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "GL_ShaderProgram::setSamplerUnit: No sampler named '%s'",
+                 samplerName.c_str());
+    return false;
+  }
+  return true;
+}
+
+RENITY_API bool GL_ShaderProgram::cook(Dictionary& dict,
+                                       CookedFileWriter& out) {
+  out.setType(COOKED_PROGRAM);
+  const char *vertPath = "<undefined>", *fragPath = vertPath;
+  if (!readShaderPaths(dict, &vertPath, &fragPath)) return false;
+  const CookedProgramInfo info = {out.addString(vertPath),
+                                  out.addString(fragPath)};
+  out.addSection(INFO_SECTION, &info, sizeof(info));
+  return true;
+}
+
 RENITY_API void GL_ShaderProgram::load(SDL_RWops* src) {
   const char *vertPath = "<undefined>", *fragPath = vertPath;
+  CookedFile cooked;
   Dictionary details;
-  details.load(src);
-
-  if (!details.get<const char*>("vertexShaderPath", &vertPath) ||
-      !details.get<const char*>("fragmentShaderPath", &fragPath)) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                 "GL_ShaderProgram::load: Invalid shader details (missing "
-                 "vertexShaderPath [%s] and/or fragmentShaderPath [%s])",
-                 vertPath, fragPath);
-    return;
+  if (cooked.open(src, COOKED_PROGRAM)) {
+    const Span<const CookedProgramInfo> info =
+        cooked.getSection<CookedProgramInfo>(INFO_SECTION);
+    if (info.empty()) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "GL_ShaderProgram::load: Cooked program is missing its "
+                   "shader paths");
+      return;
+    }
+    vertPath = cooked.getString(info[0].vertPath);
+    fragPath = cooked.getString(info[0].fragPath);
+  } else {
+    details.load(src);
+    if (!readShaderPaths(details, &vertPath, &fragPath)) return;
   }
 
   // Usually we're changing files; detach any loaded shaders from the program
+  if (!pimpl_->create()) return;
   if (pimpl_->vert) {
     glDetachShader(pimpl_->shaderProgram, pimpl_->vert->getShaderIndex());
   }
@@ -239,14 +326,13 @@ RENITY_API void GL_ShaderProgram::load(SDL_RWops* src) {
     glDetachShader(pimpl_->shaderProgram, pimpl_->frag->getShaderIndex());
   }
 
-  // Once replaced, resource management will delete any now-detached shaders
+  // Once replaced, resource management will delete any now-detached shaders.
+  // If either shader changes on disk, ResourceManager reloads (and relinks) the
+  // program after it, since it requested them here.
   pimpl_->vert = ResourceManager::getActive()->get<GL_VertShader>(vertPath);
-  pimpl_->vert->setReloadCallback(flagReload, pimpl_);
   glAttachShader(pimpl_->shaderProgram, pimpl_->vert->getShaderIndex());
   pimpl_->frag = ResourceManager::getActive()->get<GL_FragShader>(fragPath);
-  pimpl_->frag->setReloadCallback(flagReload, pimpl_);
   glAttachShader(pimpl_->shaderProgram, pimpl_->frag->getShaderIndex());
-  pimpl_->dirty = true;
   SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
                  "GL_ShaderProgram::load: (Re)linking shader program %i using "
                  "vertShader:[%s], fragShader:[%s])",
@@ -29,75 +29,148 @@ INCBIN(DefaultGL_Texture2D, "resources/default_texture.png");
 #endif
 
 namespace renity {
+// Size of the square blocks of pixels that opacity is recorded for
+static const Uint32 OPACITY_BLOCK = 4;
+
 struct GL_Texture2D::Impl {
-  Impl() : size(0, 0), texUnit(GL_TEXTURE0) { glGenTextures(1, &tex); }
+  Impl() : tex(0), texUnit(GL_TEXTURE0), size(0, 0), staged(nullptr) {}
 
-  ~Impl() { glDeleteTextures(1, &tex); }
+  ~Impl() {
+    if (tex) glDeleteTextures(1, &tex);
+    SDL_DestroySurface(staged);
+  }
 
   GLuint tex;
   GLenum texUnit;
   Dimension2Du32 size;
-};
-
-RENITY_API GL_Texture2D::GL_Texture2D() { pimpl_ = new Impl(); }
+  SDL_Surface *staged;
+  // Whether each OPACITY_BLOCK of the image is fully opaque, from the top-left
+  Vector<bool> opaqueBlocks, stagedOpaqueBlocks;
 
-RENITY_API GL_Texture2D::~GL_Texture2D() { delete pimpl_; }
+  /* Record which blocks of a decoded image are fully opaque, while it's still
+   * in memory, so e.g. Tilesets needn't decode it again to find opaque tiles.
+   */
+  static void findOpaqueBlocks(SDL_Surface *rgbaSurf, Vector<bool> &opaque) {
+    const Uint32 blocksX = (rgbaSurf->w + OPACITY_BLOCK - 1) / OPACITY_BLOCK;
+    const Uint32 blocksY = (rgbaSurf->h + OPACITY_BLOCK - 1) / OPACITY_BLOCK;
+    opaque.assign(blocksX * blocksY, true);
+    SDL_LockSurface(rgbaSurf);
+    for (Sint32 y = 0; y < rgbaSurf->h; ++y) {
+      // The surface is already flipped to GL's bottom-left origin
+      const Uint8 *row = (const Uint8 *)rgbaSurf->pixels +
+                         (rgbaSurf->h - 1 - y) * rgbaSurf->pitch;
+      const Uint32 rowBlocks = (y / OPACITY_BLOCK) * blocksX;
+      for (Sint32 x = 0; x < rgbaSurf->w; ++x) {
+        // RGBA32 is byte-ordered, so alpha is always the fourth byte
+        if (row[x * 4 + 3] != 0xFF) {
+          opaque[rowBlocks + x / OPACITY_BLOCK] = false;
+        }
+      }
+    }
+    SDL_UnlockSurface(rgbaSurf);
+  }
 
-RENITY_API void GL_Texture2D::load(SDL_RWops *src) {
-  // Load default not-found texture if not given a valid one
-  SDL_Surface *surf = RENITY_LoadPhysSurfaceRW(src);
-  if (!surf) {
-    SDL_LogDebug(
-        SDL_LOG_CATEGORY_APPLICATION,
-        "GL_Texture2D::load: Invalid RWops - using default texture.\n");
-    SDL_RWops *defSrc =
+  /* Decode an image into a GL-ready surface, and find its opaque blocks.
+   * Doesn't touch the GL context, so it can also run on a ResourceManager
+   * loader thread.
+   */
+  static SDL_Surface *decode(SDL_RWops *src, Vector<bool> &opaqueOut) {
+    // Load default not-found texture if not given a valid one
+    SDL_Surface *surf = RENITY_LoadPhysSurfaceRW(src);
+    if (!surf) {
+      SDL_LogDebug(
+          SDL_LOG_CATEGORY_APPLICATION,
+          "GL_Texture2D::load: Invalid RWops - using default texture.\n");
+      SDL_RWops *defSrc =
 #ifdef RENITY_DEFAULT_TEXTURE
-        SDL_RWFromConstMem(pDefaultTextureData, pDefaultTextureSize);
+          SDL_RWFromConstMem(pDefaultTextureData, pDefaultTextureSize);
 #else
-        SDL_RWFromConstMem(pDefaultGL_Texture2DData, pDefaultGL_Texture2DSize);
+          SDL_RWFromConstMem(pDefaultGL_Texture2DData,
+                             pDefaultGL_Texture2DSize);
 #endif
-    // Shouldn't fail, but avoid infinite loops just to be safe
-    if (defSrc) {
-      load(defSrc);
-    } else {
+      // Shouldn't fail, but don't keep trying if it does
+      if (defSrc) {
+        surf = RENITY_LoadPhysSurfaceRW(defSrc);
+      }
+      if (!surf) {
+        SDL_LogError(
+            SDL_LOG_CATEGORY_APPLICATION,
+            "GL_Texture2D::load: Could not load default texture ('%s')\n",
+            SDL_GetError());
+        return nullptr;
+      }
+    }
+
+    // Convert the pixel data from its original format to 32-bit RGBA.
+    // Using RGBA32 instead of RGBA8888 converts from little-endian ABGR as
+    // needed. Image Y axes also need to be flipped into GL's bottom-left
+    // coordinates.
+    SDL_Surface *rgbaSurf = RENITY_FlipSurfaceVertical(
+        SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_RGBA32), SDL_TRUE);
+    SDL_DestroySurface(surf);
+    if (!rgbaSurf) {
       SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                   "GL_Texture2D::load: SDL_RWFromConstMem failed ('%s')\n",
+                   "GL_Texture2D::load: Surface format conversion failed: '%s'",
                    SDL_GetError());
+      opaqueOut.clear();
+      return nullptr;
     }
-    return;
+    findOpaqueBlocks(rgbaSurf, opaqueOut);
+    return rgbaSurf;
   }
 
-  // Convert the pixel data from its original format to 32-bit RGBA.
-  // Using RGBA32 instead of RGBA8888 converts from little-endian ABGR as needed
-  // Image Y axes also need to be flipped into GL's bottom-left coordinates.
-  SDL_Surface *rgbaSurf = RENITY_FlipSurfaceVertical(
-      SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_RGBA32), SDL_TRUE);
-  SDL_DestroySurface(surf);
-  if (!rgbaSurf) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                 "GL_Texture2D::load: Surface format conversion failed: '%s'",
-                 SDL_GetError());
-    return;
+  void upload(SDL_Surface *rgbaSurf) {
+    size.width(rgbaSurf->w);
+    size.height(rgbaSurf->h);
+
+    // Bind/configure/upload the texture data and auto-generate mipmaps. The
+    // texture is only created here, since ResourceManager may construct
+    // textures on threads without a GL context.
+    if (!tex) glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    // TODO: Make the texture wrapping/filtering options configurable
+    // GL_BORDER mode is not available in base ES3, so we'll default to
+    // GL_REPEAT
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, rgbaSurf->w, rgbaSurf->h, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, rgbaSurf->pixels);
+    SDL_DestroySurface(rgbaSurf);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                   "GL_Texture2D::load: Successfully buffered %ux%u texture",
+                   size.width(), size.height());
   }
-  pimpl_->size.width(rgbaSurf->w);
-  pimpl_->size.height(rgbaSurf->h);
+};
 
-  // Bind/configure/upload the texture data and auto-generate mipmaps
-  glBindTexture(GL_TEXTURE_2D, pimpl_->tex);
-  // TODO: Make the texture wrapping/filtering options configurable
-  // GL_BORDER mode is not available in base ES3, so we'll default to GL_REPEAT
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                  GL_LINEAR_MIPMAP_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, rgbaSurf->w, rgbaSurf->h, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, rgbaSurf->pixels);
-  SDL_DestroySurface(rgbaSurf);
-  glGenerateMipmap(GL_TEXTURE_2D);
-  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
-                 "GL_Texture2D::load: Successfully buffered %ux%u texture",
-                 pimpl_->size.width(), pimpl_->size.height());
+RENITY_API GL_Texture2D::GL_Texture2D() { pimpl_ = new Impl(); }
+
+RENITY_API GL_Texture2D::~GL_Texture2D() { delete pimpl_; }
+
+RENITY_API void GL_Texture2D::load(SDL_RWops *src) {
+  Vector<bool> opaque;
+  SDL_Surface *rgbaSurf = Impl::decode(src, opaque);
+  if (!rgbaSurf) return;
+  pimpl_->upload(rgbaSurf);
+  pimpl_->opaqueBlocks.swap(opaque);
+}
+
+RENITY_API bool GL_Texture2D::prepareLoad(SDL_RWops *src) {
+  SDL_DestroySurface(pimpl_->staged);
+  pimpl_->staged = Impl::decode(src, pimpl_->stagedOpaqueBlocks);
+  return true;
+}
+
+RENITY_API void GL_Texture2D::finishLoad() {
+  if (pimpl_->staged) {
+    pimpl_->upload(pimpl_->staged);
+    pimpl_->opaqueBlocks.swap(pimpl_->stagedOpaqueBlocks);
+  }
+  pimpl_->staged = nullptr;
+  pimpl_->stagedOpaqueBlocks.clear();
 }
 
 RENITY_API void GL_Texture2D::setTextureUnit(Uint32 unit) {
@@ -127,4 +200,36 @@ RENITY_API void GL_Texture2D::use() {
 }
 
 RENITY_API Dimension2Du32 GL_Texture2D::getSize() const { return pimpl_->size; }
+
+RENITY_API bool GL_Texture2D::isOpaque(const Rect2Di32 &area) const {
+  const Dimension2Du32 &size = pimpl_->size;
+  if (area.x() < 0 || area.y() < 0 || area.width() <= 0 ||
+      area.height() <= 0 || (Uint32)(area.x() + area.width()) > size.width() ||
+      (Uint32)(area.y() + area.height()) > size.height()) {
+    return false;
+  }
+  const Uint32 blocksX = (size.width() + OPACITY_BLOCK - 1) / OPACITY_BLOCK;
+  const Uint32 blocksY = (size.height() + OPACITY_BLOCK - 1) / OPACITY_BLOCK;
+  if (pimpl_->opaqueBlocks.size() != (size_t)blocksX * blocksY) return false;
+
+  const Uint32 lastX = (area.x() + area.width() - 1) / OPACITY_BLOCK;
+  const Uint32 lastY = (area.y() + area.height() - 1) / OPACITY_BLOCK;
+  for (Uint32 y = area.y() / OPACITY_BLOCK; y <= lastY; ++y) {
+    for (Uint32 x = area.x() / OPACITY_BLOCK; x <= lastX; ++x) {
+      if (!pimpl_->opaqueBlocks[y * blocksX + x]) return false;
+    }
+  }
+  return true;
+}
+
+RENITY_API Uint32 GL_Texture2D::getTextureIndex() const { return pimpl_->tex; }
+
+RENITY_API size_t GL_Texture2D::getCpuBytes() const {
+  return pimpl_->opaqueBlocks.capacity() / 8;
+}
+
+RENITY_API size_t GL_Texture2D::getGpuBytes() const {
+  // RGBA8, plus roughly a third more for the mipmap chain
+  return (size_t)pimpl_->size.getArea() * 4 * 4 / 3;
+}
 }  // namespace renity
@@ -83,6 +83,11 @@ RENITY_API void ScriptContext::load(SDL_RWops* src) {
   setupGlobalEnv();
 }
 
+RENITY_API void ScriptContext::finishLoad() {
+  Dictionary::finishLoad();
+  setupGlobalEnv();
+}
+
 // Debug logger
 // TODO: Allow varying numbers of arguments
 static duk_ret_t scriptConsoleLog(duk_context* ctx) {
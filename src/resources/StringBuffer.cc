@@ -34,10 +34,20 @@ RENITY_API size_t StringBuffer::length() const {
   return pimpl_->content.length();
 }
 
+RENITY_API size_t StringBuffer::getCpuBytes() const {
+  return pimpl_->content.capacity();
+}
+
 RENITY_API void StringBuffer::load(SDL_RWops *src) {
   pimpl_->content.clear();
 
-  if (src) {
+  // Mapped files can be copied straight into the String
+  Sint64 mappedSize = 0;
+  const Uint8 *mapped = RENITY_GetMappedBuffer(src, &mappedSize);
+  if (mapped) {
+    pimpl_->content.assign((const char *)mapped, (size_t)mappedSize);
+    SDL_RWclose(src);
+  } else if (src) {
     char *bufPtr = nullptr;
     Sint64 bufSize = RENITY_ReadCharBuffer(src, &bufPtr);
     if (bufPtr) {
@@ -11,9 +11,14 @@
 
 #include <SDL3/SDL_log.h>
 
+#include <algorithm>
+
+#include "CookedFile.h"
 #include "Dictionary.h"
 #include "Dimension2D.h"
+#include "GL_LightRenderer.h"
 #include "GL_TileRenderer.h"
+#include "HashTable.h"
 #include "Rect2D.h"
 #include "ResourceManager.h"
 #include "Window.h"
@@ -22,21 +27,230 @@
 #include "utils/string_helpers.h"
 
 namespace renity {
+static const Uint32 COOKED_WORLD = cookedTag("WRLD");
+static const Uint32 MAPS_SECTION = cookedTag("MAPS");
+static const Uint32 INFO_SECTION = cookedTag("INFO");
+static const Uint32 NO_MAP = UINT32_MAX;
+static const Sint32 DEFAULT_PREFETCH_RADIUS = 512;
+static const Sint32 DEFAULT_EVICT_RADIUS = 1024;
+
+// Cooked section layouts
+struct CookedMapEntry {
+  Uint32 path;  // Offset into the strings section
+  Sint32 x, y, width, height;
+};
+struct CookedWorldInfo {
+  Uint32 onlyShowAdjacentMaps;
+};
+
+// Find the grid cell holding a coordinate, rounding down for negative ones
+static Sint32 cellOf(Sint32 coord, Sint32 cellSize) {
+  return coord >= 0 ? coord / cellSize : -((-coord - 1) / cellSize) - 1;
+}
+
+static Uint64 cellKey(Sint32 cellX, Sint32 cellY) {
+  return (Uint64)(Uint32)cellY << 32 | (Uint32)cellX;
+}
+
 struct MapInstance {
-  MapInstance(const TilemapPtr &mapPtr, const Rect2Di32 &bounds)
-      : map(mapPtr), worldBounds(bounds) {}
-  TilemapPtr map;
+  MapInstance(const char *mapPath, const Rect2Di32 &bounds)
+      : path(mapPath), worldBounds(bounds) {}
+  String path;
   Rect2Di32 worldBounds;
+  TilemapPtr map;  // Only while streamed in
 };
 
+// Grow a rect by a radius on every side
+static Rect2Di32 expandRect(const Rect2Di32 &rect, Sint32 radius) {
+  return Rect2Di32(rect.x() - radius, rect.y() - radius,
+                   rect.width() + radius * 2, rect.height() + radius * 2);
+}
+
 struct TileWorld::Impl {
-  explicit Impl() : prevPos(-1, -1) {}
+  explicit Impl()
+      : viewValid(false),
+        onlyShowAdjacentMaps(false),
+        currentMap(NO_MAP),
+        cellSize(1, 1),
+        queryStamp(0),
+        prefetchRadius(DEFAULT_PREFETCH_RADIUS),
+        evictRadius(DEFAULT_EVICT_RADIUS),
+        streamValid(false) {}
   ~Impl() {}
 
-  Point2Di32 prevPos;
-  float prevScale;
+  // Add a map, which is only loaded once the camera nears it
+  void addMap(const char *mapPath, const Rect2Di32 &bounds) {
+    maps.emplace_back(mapPath, bounds);
+    SDL_LogVerbose(
+        SDL_LOG_CATEGORY_APPLICATION,
+        "TileWorld::load: Successfully added map '%s' with rect (%i, "
+        "%i)+(%i, %i).",
+        mapPath, bounds.x(), bounds.y(), bounds.width(), bounds.height());
+  }
+
+  // Start loading maps near the view, and release ones that are well past it
+  void streamMaps(const Rect2Di32 &view) {
+    // The prefetch area reaches well past the view, so it only needs updating
+    // once the view has moved a good part of the way towards its edge
+    const Sint32 step = SDL_max(1, prefetchRadius / 4);
+    if (streamValid && view.width() == streamedView.width() &&
+        view.height() == streamedView.height() &&
+        SDL_abs(view.x() - streamedView.x()) < step &&
+        SDL_abs(view.y() - streamedView.y()) < step) {
+      return;
+    }
+    streamedView = view;
+    streamValid = true;
+
+    // Maps fill in as they finish loading in the background, rather than
+    // stalling; prefetching gives them time to load before they're visible
+    findMaps(expandRect(view, prefetchRadius), nearbyMaps);
+    for (auto index : nearbyMaps) {
+      MapInstance &inst = maps[index];
+      if (inst.map) continue;
+      inst.map =
+          ResourceManager::getActive()->getAsync<Tilemap>(inst.path.c_str());
+      streamedMaps.push_back(index);
+    }
+
+    // Released maps are dropped from the ResourceManager's retention too, so
+    // they don't linger in memory; the evict radius keeps nearby ones instead
+    Rect2Di32 keepArea = expandRect(view, evictRadius);
+    for (size_t i = 0; i < streamedMaps.size();) {
+      MapInstance &inst = maps[streamedMaps[i]];
+      if (keepArea.intersects(inst.worldBounds)) {
+        ++i;
+        continue;
+      }
+      SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                     "TileWorld::draw: Releasing distant map '%s'.",
+                     inst.path.c_str());
+      inst.map.reset();
+      ResourceManager::getActive()->release(inst.path.c_str());
+      streamedMaps[i] = streamedMaps.back();
+      streamedMaps.pop_back();
+    }
+  }
+
+  // Call back with the index of each map that may be in an area (possibly more
+  // than once, if it spans several grid cells)
+  template <typename F>
+  void forEachCandidate(Rect2Di32 area, F &&callback) const {
+    const Sint32 firstX = cellOf(area.x(), cellSize.width());
+    const Sint32 firstY = cellOf(area.y(), cellSize.height());
+    const Sint32 lastX = cellOf(area.x() + area.width(), cellSize.width());
+    const Sint32 lastY = cellOf(area.y() + area.height(), cellSize.height());
+    for (Sint32 cellY = firstY; cellY <= lastY; ++cellY) {
+      for (Sint32 cellX = firstX; cellX <= lastX; ++cellX) {
+        const Vector<Uint32> *cell = grid.find(cellKey(cellX, cellY));
+        if (!cell) continue;
+        for (auto index : *cell) callback(index);
+      }
+    }
+  }
+
+  // Find the maps intersecting an area, in world file order
+  void findMaps(Rect2Di32 area, Vector<Uint32> &found) {
+    found.clear();
+    ++queryStamp;
+    forEachCandidate(area, [&](Uint32 index) {
+      if (seenStamps[index] == queryStamp) return;
+      seenStamps[index] = queryStamp;
+      if (area.intersects(maps[index].worldBounds)) found.push_back(index);
+    });
+    std::sort(found.begin(), found.end());
+  }
+
+  // Find the map a point is in, or NO_MAP if it's between them
+  Uint32 findMapAt(const Point2Di32 point) const {
+    Uint32 found = NO_MAP;
+    forEachCandidate(Rect2Di32(point.x(), point.y(), 0, 0), [&](Uint32 index) {
+      const Rect2Di32 &bounds = maps[index].worldBounds;
+      if (index < found && point.x() >= bounds.x() &&
+          point.x() < bounds.x() + bounds.width() && point.y() >= bounds.y() &&
+          point.y() < bounds.y() + bounds.height()) {
+        found = index;
+      }
+    });
+    return found;
+  }
+
+  // Index the maps into a grid of cells and link up the ones that touch,
+  // once they've all been added
+  void buildIndex() {
+    grid.clear();
+    neighbors.assign(maps.size(), {});
+    seenStamps.assign(maps.size(), 0);
+    queryStamp = 0;
+    currentMap = NO_MAP;
+    visibleMaps.clear();
+    litMaps.clear();
+    streamedMaps.clear();
+    viewValid = false;
+    streamValid = false;
+    if (maps.empty()) return;
+
+    // Size cells like an average map, so most maps only span a few
+    Sint64 totalWidth = 0, totalHeight = 0;
+    for (auto &inst : maps) {
+      totalWidth += inst.worldBounds.width();
+      totalHeight += inst.worldBounds.height();
+    }
+    cellSize.width(SDL_max(1, (Sint32)(totalWidth / (Sint64)maps.size())));
+    cellSize.height(SDL_max(1, (Sint32)(totalHeight / (Sint64)maps.size())));
+    for (Uint32 index = 0; index < maps.size(); ++index) {
+      const Rect2Di32 &bounds = maps[index].worldBounds;
+      const Sint32 lastX =
+          cellOf(bounds.x() + bounds.width(), cellSize.width());
+      const Sint32 lastY =
+          cellOf(bounds.y() + bounds.height(), cellSize.height());
+      for (Sint32 cellY = cellOf(bounds.y(), cellSize.height());
+           cellY <= lastY; ++cellY) {
+        for (Sint32 cellX = cellOf(bounds.x(), cellSize.width());
+             cellX <= lastX; ++cellX) {
+          grid.get(cellKey(cellX, cellY)).push_back(index);
+        }
+      }
+    }
+
+    // Touching edges count as adjacent, as with Rect2D::intersects()
+    for (Uint32 index = 0; index < maps.size(); ++index) {
+      findMaps(maps[index].worldBounds, neighbors[index]);
+      neighbors[index].erase(std::remove(neighbors[index].begin(),
+                                         neighbors[index].end(), index),
+                             neighbors[index].end());
+    }
+  }
+
+  Rect2Di32 view;  // World-space area the camera can see
+  bool viewValid;  // Whether the visible maps have been found for it
   Vector<MapInstance> maps;
-  GL_TileRenderer renderer;
+  Vector<Uint32> visibleMaps;
+  bool onlyShowAdjacentMaps;
+  Uint32 currentMap;  // The map the camera was last in, if showing adjacent
+  // Spatial index of the maps
+  Dimension2Di32 cellSize;
+  IdHashTable<Vector<Uint32>> grid;
+  Vector<Vector<Uint32>> neighbors;
+  Vector<Uint32> seenStamps;  // Dedupes maps spanning several cells
+  Uint32 queryStamp;
+  // Map streaming
+  Sint32 prefetchRadius, evictRadius;
+  Vector<Uint32> nearbyMaps;    // Scratch space for streamMaps()
+  Vector<Uint32> streamedMaps;  // Every map that's currently loaded
+  Rect2Di32 streamedView;       // The view maps were last streamed for
+  bool streamValid;
+  // Lighting
+  Vector<Uint32> litMaps;  // Maps with lights that may reach the view
+  Vector<LightmapInstance> lightmaps;
+  Vector<LightInstance> worldLights;  // Dynamic ones, from setLights()
+  Vector<LightInstance> lights;       // Dynamic ones near the view
+  // Created on the first draw, since ResourceManager may construct worlds on
+  // threads without a GL context
+  UniquePtr<GL_LightRenderer> lightRenderer;
+  UniquePtr<GL_TileRenderer> renderer;
+  DictionaryPtr staged;
+  SharedPtr<CookedFile> cooked;
 };
 
 RENITY_API TileWorld::TileWorld() { pimpl_ = new Impl(); }
@@ -44,37 +258,146 @@ RENITY_API TileWorld::TileWorld() { pimpl_ = new Impl(); }
 RENITY_API TileWorld::~TileWorld() { delete pimpl_; }
 
 RENITY_API void TileWorld::draw(const Point2Di32 cameraPos, float scale) {
-  static Vector<MapInstance> visibleMaps;
+  Impl *pimpl = pimpl_;
   Dimension2Di32 windowSize = Window::getActive()->sizeInPixels();
-  if (pimpl_->prevPos != cameraPos || scale != pimpl_->prevScale) {
-    pimpl_->prevScale = scale;
-    Rect2Di32 aabb = Rect2Di32::getFromCentroid(cameraPos, windowSize)
-                         .scaleFromCenter(1.0f / scale);
+  Rect2Di32 aabb = Rect2Di32::getFromCentroid(cameraPos, windowSize)
+                       .scaleFromCenter(1.0f / scale);
+  if (!pimpl->viewValid || aabb.x() != pimpl->view.x() ||
+      aabb.y() != pimpl->view.y() || aabb.width() != pimpl->view.width() ||
+      aabb.height() != pimpl->view.height()) {
+    pimpl->view = aabb;
+    pimpl->viewValid = true;
 
-    // TODO: Implement neighbor and/or binary search and map cache eviction
-    // TODO: Also coordinate edge lights from neighbor maps for cross-lighting
-    visibleMaps.clear();
-    for (auto inst : pimpl_->maps) {
-      if (aabb.intersects(inst.worldBounds)) {
-        visibleMaps.push_back(inst);
+    if (pimpl->onlyShowAdjacentMaps) {
+      // Keep showing the last map while the camera is between them
+      const Uint32 current = pimpl->findMapAt(cameraPos);
+      if (current != NO_MAP) pimpl->currentMap = current;
+    }
+    if (pimpl->onlyShowAdjacentMaps && pimpl->currentMap != NO_MAP) {
+      pimpl->visibleMaps.assign(1, pimpl->currentMap);
+      for (auto index : pimpl->neighbors[pimpl->currentMap]) {
+        if (aabb.intersects(pimpl->maps[index].worldBounds)) {
+          pimpl->visibleMaps.push_back(index);
+        }
       }
+      std::sort(pimpl->visibleMaps.begin(), pimpl->visibleMaps.end());
+      pimpl->litMaps = pimpl->visibleMaps;
+    } else {
+      pimpl->findMaps(aabb, pimpl->visibleMaps);
+      // Lights can shine across map borders, from maps just out of view
+      pimpl->findMaps(expandRect(aabb, (Sint32)LIGHT_RADIUS), pimpl->litMaps);
     }
-    pimpl_->prevPos = cameraPos;
   }
 
-  for (auto instance : visibleMaps) {
+  // Checked every frame, but it only does anything once the view has moved far
+  // enough (or the streaming radii changed)
+  pimpl->streamMaps(aabb);
+
+  // Gather the lighting that reaches the view every frame, since streamed
+  // maps may have finished loading since the last, and draw it before the
+  // tiles. Positions are made relative to the camera, at the view's center.
+  const Rect2Di32 &view = pimpl->view;
+  Rect2Di32 cameraView(-view.width() / 2, -view.height() / 2, view.width(),
+                       view.height());
+  pimpl->lightmaps.clear();
+  for (auto index : pimpl->litMaps) {
+    const MapInstance &instance = pimpl->maps[index];
+    if (!instance.map) continue;
+    const SharedPtr<GL_Lightmap> lightmap = instance.map->getLightmap();
+    if (!lightmap) continue;
+    const Point2Di32 mapOffset = instance.worldBounds.position() - cameraPos;
+    const Rect2Di32 bounds = lightmap->getBounds();
+    if (cameraView.intersects(Rect2Di32(bounds.x() + mapOffset.x(),
+                                        bounds.y() + mapOffset.y(),
+                                        bounds.width(), bounds.height()))) {
+      pimpl->lightmaps.push_back({lightmap.get(), mapOffset});
+    }
+  }
+  const float reachX = view.width() / 2.0f + LIGHT_RADIUS;
+  const float reachY = view.height() / 2.0f + LIGHT_RADIUS;
+  pimpl->lights.clear();
+  for (LightInstance light : pimpl->worldLights) {
+    light.x -= cameraPos.x();
+    light.y -= cameraPos.y();
+    if (light.x < -reachX || light.x > reachX || light.y < -reachY ||
+        light.y > reachY) {
+      continue;
+    }
+    pimpl->lights.push_back(light);
+  }
+  if (!pimpl->renderer) {
+    pimpl->renderer.reset(new GL_TileRenderer());
+    pimpl->lightRenderer.reset(new GL_LightRenderer());
+  }
+  pimpl->lightRenderer->draw(
+      {pimpl->lightmaps.data(), pimpl->lightmaps.size()},
+      {pimpl->lights.data(), pimpl->lights.size()}, scale);
+
+  for (auto index : pimpl->visibleMaps) {
+    const MapInstance &instance = pimpl->maps[index];
+    if (!instance.map) continue;
     // Map inverts the Y axis into GL coordinates - no need to do it here
     Point2Di32 mapOffset = instance.worldBounds.position() - cameraPos;
-    instance.map->draw(pimpl_->renderer, mapOffset);
+    // Maps only draw the chunks within the view, relative to their corner
+    const Rect2Di32 mapView(view.x() - instance.worldBounds.x(),
+                            view.y() - instance.worldBounds.y(), view.width(),
+                            view.height());
+    instance.map->draw(*pimpl->renderer, mapOffset, mapView);
     // Reset the Z buffer for the next map
     glClear(GL_DEPTH_BUFFER_BIT);
   }
 }
 
 RENITY_API void TileWorld::load(SDL_RWops *src) {
-  Impl *pimpl = pimpl_;
+  if (!src) {
+    pimpl_->maps.clear();
+    pimpl_->buildIndex();
+    return;
+  }
+
+  CookedFile cooked;
+  if (cooked.open(src, COOKED_WORLD)) {
+    load(cooked);
+    return;
+  }
   Dictionary dict;
   dict.load(src);
+  load(dict);
+}
+
+RENITY_API bool TileWorld::prepareLoad(SDL_RWops *src) {
+  pimpl_->cooked = makeSharedPtr<CookedFile>();
+  if (pimpl_->cooked->open(src, COOKED_WORLD)) return true;
+  pimpl_->cooked.reset();
+  pimpl_->staged = makeSharedPtr<Dictionary>();
+  pimpl_->staged->load(src);
+  return true;
+}
+
+RENITY_API void TileWorld::finishLoad() {
+  if (pimpl_->cooked) {
+    load(*pimpl_->cooked);
+    pimpl_->cooked.reset();
+  }
+  if (!pimpl_->staged) return;
+  load(*pimpl_->staged);
+  pimpl_->staged.reset();
+}
+
+RENITY_API void TileWorld::setStreamingRadius(Sint32 prefetchRadius,
+                                              Sint32 evictRadius) {
+  pimpl_->prefetchRadius = SDL_max(0, prefetchRadius);
+  pimpl_->evictRadius = SDL_max(pimpl_->prefetchRadius, evictRadius);
+  // Stream with the new radii on the next draw
+  pimpl_->streamValid = false;
+}
+
+RENITY_API void TileWorld::setLights(Span<const LightInstance> lights) {
+  pimpl_->worldLights.assign(lights.begin(), lights.end());
+}
+
+RENITY_API void TileWorld::load(Dictionary &dict) {
+  Impl *pimpl = pimpl_;
 
   // (Re)load the map list
   pimpl_->maps.clear();
@@ -90,19 +413,59 @@ RENITY_API void TileWorld::load(SDL_RWops *src) {
       return true;
     }
 
-    TilemapPtr map = ResourceManager::getActive()->get<Tilemap>(mapPath);
-    Rect2Di32 bounds(x, y, width, height);
-    pimpl->maps.emplace_back(map, bounds);
-    SDL_LogVerbose(
-        SDL_LOG_CATEGORY_APPLICATION,
-        "TileWorld::load: Successfully cached map '%s' with rect (%i, "
-        "%i)+(%i, %i).",
-        mapPath, x, y, width, height);
+    pimpl->addMap(mapPath, Rect2Di32(x, y, width, height));
     return true;
   });
+  pimpl_->onlyShowAdjacentMaps = false;
+  dict.get<bool>("onlyShowAdjacentMaps", &pimpl_->onlyShowAdjacentMaps);
+  pimpl_->buildIndex();
 
   SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
                "TileWorld::load: Successfully loaded %u map(s).",
                pimpl->maps.size());
 }
+
+RENITY_API void TileWorld::load(const CookedFile &cooked) {
+  pimpl_->maps.clear();
+  for (auto &entry : cooked.getSection<CookedMapEntry>(MAPS_SECTION)) {
+    pimpl_->addMap(cooked.getString(entry.path),
+                   Rect2Di32(entry.x, entry.y, entry.width, entry.height));
+  }
+  const Span<const CookedWorldInfo> info =
+      cooked.getSection<CookedWorldInfo>(INFO_SECTION);
+  pimpl_->onlyShowAdjacentMaps = !info.empty() && info[0].onlyShowAdjacentMaps;
+  pimpl_->buildIndex();
+
+  SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
+               "TileWorld::load: Successfully loaded %u cooked map(s).",
+               pimpl_->maps.size());
+}
+
+RENITY_API bool TileWorld::cook(Dictionary &dict, CookedFileWriter &out) {
+  out.setType(COOKED_WORLD);
+  bool valid = true;
+  Vector<CookedMapEntry> entries;
+  dict.enumerateArray("maps", [&](Dictionary &dict, const Uint32 &index) {
+    const char *mapPath = "<undefined>";
+    CookedMapEntry entry;
+    if (!dict.get<const char *>("fileName", &mapPath) ||
+        !dict.get<Sint32>("x", &entry.x) || !dict.get<Sint32>("y", &entry.y) ||
+        !dict.get<Sint32>("width", &entry.width) ||
+        !dict.get<Sint32>("height", &entry.height)) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "TileWorld::cook: Missing details for map '%s'", mapPath);
+      valid = false;
+      return false;
+    }
+    entry.path = out.addString(mapPath);
+    entries.push_back(entry);
+    return true;
+  });
+  bool onlyShowAdjacentMaps = false;
+  dict.get<bool>("onlyShowAdjacentMaps", &onlyShowAdjacentMaps);
+  const CookedWorldInfo info = {onlyShowAdjacentMaps};
+  out.addSection(MAPS_SECTION, entries);
+  out.addSection(INFO_SECTION, &info, sizeof(info));
+  return valid;
+}
 }  // namespace renity
@@ -14,32 +14,346 @@
 #include <SDL3/SDL_stdinc.h>
 // #include <SDL3/SDL_surface.h>
 
+#include <algorithm>
+
+#include "CookedFile.h"
 #include "Dictionary.h"
 #include "Dimension2D.h"
+#include "GL_TextureArray.h"
 #include "GL_TileRenderer.h"
+#include "HashTable.h"
+#include "Rect2D.h"
 #include "ResourceManager.h"
 #include "gl3.h"
 #include "resources/Tileset.h"
+#include "utils/rwops_utils.h"
 #include "utils/string_helpers.h"
 
 namespace renity {
+static const Uint32 COOKED_TILEMAP = cookedTag("TMAP");
+static const Uint32 INFO_SECTION = cookedTag("INFO");
+static const Uint32 DETAILS_SECTION = cookedTag("DETL");
+static const Uint32 TILESETS_SECTION = cookedTag("TSET");
+static const Uint32 TILES_SECTION = cookedTag("TILE");
+static const Uint32 CHUNKS_SECTION = cookedTag("CHNK");
+static const Uint32 ANIMATIONS_SECTION = cookedTag("ANIM");
+static const Uint32 LIGHTS_SECTION = cookedTag("LITE");
+static const Uint32 LIGHTMAP_INFO_SECTION = cookedTag("LMIN");
+static const Uint32 LIGHTMAP_SECTION = cookedTag("LMAP");
+
+// Cooked section layouts
+struct CookedTilemapInfo {
+  Uint32 pixelWidth, pixelHeight, tileWidth, tileHeight;
+};
+struct CookedLightmapInfo {
+  Sint32 x, y, pixelWidth, pixelHeight;
+  Uint32 width, height;  // In texels
+};
+struct CookedTilesetEntry {
+  TileId firstGid;
+  Uint32 source;  // Offset into the strings section
+};
+
+// A MAP_CHUNK_TILES-square area of the map's tiles. Its opaque tiles are
+// sorted front-to-back and its translucent ones back-to-front; tiles can't
+// overlap other chunks, so that orders them correctly within the whole map.
+struct TileChunk {
+  ChunkId id;          // Row-major index of the chunk within the map
+  Rect2Di32 bounds;    // In pixels from the map's top-left corner
+  Uint32 firstOpaque;  // Index of its first opaque tile in the map's tiles
+  Uint32 opaqueCount;
+  Uint32 firstTranslucent;
+  Uint32 translucentCount;
+};
+struct CookedTileChunk {
+  ChunkId id;
+  Sint32 x, y, width, height;
+  Uint32 firstOpaque, opaqueCount;
+  Uint32 firstTranslucent, translucentCount;
+};
+
+// Get the order tiles are drawn in, front (lowest) to back; the same as
+// their Z in the shader, since a map layer is deeper than any Y in it
+static Uint32 getTileDepth(const TileInstance &tile) {
+  return (Uint32)(tile.flags & TILE_DEPTH_MASK) << 16 | tile.y;
+}
+
 struct TilesetInstance {
   TileId firstGid;
+  String source;
   TilesetPtr tileset;
-  Vector<TileInstance> tiles;
+  // Only needed while building the tiles from a map file
+  Dimension2Du32 tileCounts;
+  Vector<Uint32> lightColors;
+  Vector<Uint8> opaqueTiles;
+  TileAnimations animations;
 };
 
-constexpr Uint8 MAX_DETAIL_VECS = 1 + MAX_MAP_LIGHTS * 2;
-struct Tilemap::Impl {
-  explicit Impl() : nextLightSlot(1) {
-    mapDetails.assign(MAX_DETAIL_VECS, {0.0f, 0.0f, 0.0f, 0.0f});
+// Look up a tileset's tile counts and light colors for building a map
+using TilesetResolver = FuncPtr<bool(TilesetInstance &ts)>;
+
+/* Maps that use the same tilesets, in the same order, share one packed array
+ * rather than each holding another copy of every sheet. Tilesets are only
+ * shared within a ResourceManager, so each one's GL context gets its own. An
+ * array keeps its tilesets alive, and repacks after any of them reloads.
+ */
+struct SheetArray {
+  explicit SheetArray(Vector<TilesetPtr> &&sets) : tilesets(std::move(sets)) {
+    for (auto &ts : tilesets) ts->addReloadCallback(markStale, this);
+  }
+  ~SheetArray() {
+    for (auto &ts : tilesets) ts->removeReloadCallback(markStale, this);
+  }
+
+  static void markStale(void *self) { ((SheetArray *)self)->stale = true; }
+
+  // Pack the sheets, unless they're already up to date
+  void refresh() {
+    if (!stale) return;
+    Vector<GL_Texture2DPtr> sheets;
+    for (auto &ts : tilesets) sheets.push_back(ts->getTexture());
+    array.pack(sheets);
+    stale = false;
+  }
+
+  GL_TextureArray array;
+  Vector<TilesetPtr> tilesets;
+  bool stale = true;
+};
+
+// Find the array for a list of tilesets, packing a new one if there isn't one
+static SharedPtr<SheetArray> getSheetArray(Vector<TilesetPtr> &&tilesets) {
+  static List<WeakPtr<SheetArray>> arrays;
+  SharedPtr<SheetArray> found;
+  for (auto it = arrays.begin(); it != arrays.end() && !found;) {
+    found = it->lock();
+    if (!found) {
+      it = arrays.erase(it);
+    } else if (found->tilesets != tilesets) {
+      found.reset();
+      ++it;
+    }
+  }
+  if (!found) {
+    found = makeSharedPtr<SheetArray>(std::move(tilesets));
+    arrays.push_back(found);
   }
+  found->refresh();
+  return found;
+}
+
+struct Tilemap::Impl {
+  explicit Impl() { mapDetails.assign(1, {0.0f, 0.0f, 0.0f, 0.0f}); }
   ~Impl() {}
 
-  Uint8 nextLightSlot;
+  // Get a tileset's details, from the tileset itself unless cooking
+  bool resolveTileset(TilesetInstance &ts) {
+    if (cookResolver) return cookResolver(ts);
+    ts.tileset = ResourceManager::getActive()->get<Tileset>(ts.source.c_str());
+    ts.tileCounts = ts.tileset->getTileCounts();
+    ts.lightColors.resize(ts.tileCounts.getArea());
+    ts.opaqueTiles.resize(ts.tileCounts.getArea());
+    ts.animations.starts.clear();
+    ts.animations.frames.clear();
+    for (TileId id = 0; id < ts.lightColors.size(); ++id) {
+      ts.lightColors[id] = ts.tileset->getLightColor(id);
+      ts.opaqueTiles[id] = ts.tileset->isOpaque(id);
+      const Span<const TileFrame> frames = ts.tileset->getAnimation(id);
+      ts.animations.starts.push_back((Uint32)ts.animations.frames.size());
+      ts.animations.frames.insert(ts.animations.frames.end(), frames.begin(),
+                                  frames.end());
+    }
+    ts.animations.starts.push_back((Uint32)ts.animations.frames.size());
+    return true;
+  }
+
+  // Get the frames of a tile while building the map
+  static Span<const TileFrame> getFrames(const TilesetInstance &ts,
+                                         TileId id) {
+    const TileAnimations &anims = ts.animations;
+    if (id + 1 >= anims.starts.size()) return {};
+    const Uint32 first = anims.starts[id];
+    return {anims.frames.data() + first, anims.starts[id + 1] - first};
+  }
+
+  // Get the bottom-left corner of a tile in its sheet, in pixels
+  void getTileCorner(const TilesetInstance &ts, TileId id, Uint32 *tOut,
+                     Uint32 *uOut) const {
+    const Dimension2Du32 &tilesetDims = ts.tileCounts;
+    *tOut = (id % tilesetDims.width()) * tileSize.width();
+    *uOut = (tilesetDims.height() - 1 - id / tilesetDims.width()) *
+            tileSize.height();
+  }
+
+  // Add a tile's animation to the TileAnimations block, if it has one and it
+  // isn't already there. The shader picks frames from it, so animated tiles
+  // never need their instances updated.
+  // Returns the index of the animation in the block, or 0 if there is none.
+  Uint32 addAnimation(Uint32 tilesetIndex, TileId id) {
+    const TilesetInstance &ts = tilesets[tilesetIndex];
+    const Span<const TileFrame> frames = getFrames(ts, id);
+    if (frames.empty()) return 0;
+    const Uint64 key = (Uint64)tilesetIndex << 32 | id;
+    const Uint32 *known = animationIndices.find(key);
+    if (known) return *known;
+
+    // Index 0 means "not animated", so the block starts with a blank entry
+    if (animations.empty()) animations.assign(4, 0);
+    const Uint32 index = (Uint32)animations.size() / 4;
+    Uint32 duration = 0;
+    for (auto &frame : frames) duration += frame.duration;
+    if (duration > MAX_ANIMATION_DURATION) {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                  "Tilemap::load: Tile %u of tileset '%s' takes %u ms to "
+                  "loop, over MAX_ANIMATION_DURATION (%u); not animating it.",
+                  id, ts.source.c_str(), duration, MAX_ANIMATION_DURATION);
+      animationIndices.put(key, 0);
+      return 0;
+    }
+    if (!duration || index + 1 + frames.size() > MAX_ANIMATION_VECS) {
+      if (duration) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Tilemap::load: Exceeded MAX_ANIMATION_VECS (%u); not "
+                    "animating tile %u of tileset '%s'.",
+                    MAX_ANIMATION_VECS, id, ts.source.c_str());
+      }
+      animationIndices.put(key, 0);
+      return 0;
+    }
+
+    // A header of (frame count, total duration), then each frame's sheet
+    // corner and the time it ends at
+    animations.insert(animations.end(),
+                      {(Uint32)frames.size(), duration, 0, 0});
+    Uint32 endTime = 0;
+    for (auto &frame : frames) {
+      Uint32 t, u;
+      getTileCorner(ts, frame.id, &t, &u);
+      endTime += frame.duration;
+      animations.insert(animations.end(), {t, u, endTime, 0});
+    }
+    animationIndices.put(key, index);
+    return index;
+  }
+
+  // Group the tiles by chunk, with all the opaque ones first, and work out
+  // each chunk's ranges
+  void buildChunks(Uint32 chunksX, Uint32 chunksY) {
+    // Counting sort into buckets of opaque chunks, then translucent chunks
+    const Uint32 chunkCount = chunksX * chunksY;
+    Vector<Uint32> bucketStarts(chunkCount * 2 + 1, 0);
+    for (auto bucket : tileBuckets) ++bucketStarts[bucket + 1];
+    for (size_t i = 1; i < bucketStarts.size(); ++i) {
+      bucketStarts[i] += bucketStarts[i - 1];
+    }
+    Vector<TileInstance> sorted(tiles.size());
+    Vector<Uint32> nextTile(bucketStarts.begin(), bucketStarts.end() - 1);
+    for (size_t i = 0; i < tiles.size(); ++i) {
+      sorted[nextTile[tileBuckets[i]]++] = tiles[i];
+    }
+    tiles.swap(sorted);
+    tileBuckets.clear();
+    tileBuckets.shrink_to_fit();
+
+    // Lower Z is in front, so opaque tiles go lowest-first and translucent
+    // ones highest-first
+    for (Uint32 bucket = 0; bucket < chunkCount * 2; ++bucket) {
+      TileInstance *first = tiles.data() + bucketStarts[bucket];
+      TileInstance *last = tiles.data() + bucketStarts[bucket + 1];
+      if (bucket < chunkCount) {
+        std::stable_sort(first, last, [](auto &lhs, auto &rhs) {
+          return getTileDepth(lhs) < getTileDepth(rhs);
+        });
+      } else {
+        std::stable_sort(first, last, [](auto &lhs, auto &rhs) {
+          return getTileDepth(lhs) > getTileDepth(rhs);
+        });
+      }
+    }
+
+    const Sint32 chunkWidth = MAP_CHUNK_TILES * tileSize.width();
+    const Sint32 chunkHeight = MAP_CHUNK_TILES * tileSize.height();
+    chunks.clear();
+    for (ChunkId id = 0; id < chunkCount; ++id) {
+      const Uint32 opaque = bucketStarts[id + 1] - bucketStarts[id];
+      const Uint32 translucentId = chunkCount + id;
+      const Uint32 translucent =
+          bucketStarts[translucentId + 1] - bucketStarts[translucentId];
+      if (!opaque && !translucent) continue;
+      // Edge chunks are clipped to the map
+      const Sint32 x = (id % chunksX) * chunkWidth;
+      const Sint32 y = (id / chunksX) * chunkHeight;
+      const Rect2Di32 bounds(
+          x, y, SDL_min(chunkWidth, (Sint32)pixelSize.width() - x),
+          SDL_min(chunkHeight, (Sint32)pixelSize.height() - y));
+      chunks.push_back({id, bounds, bucketStarts[id], opaque,
+                        bucketStarts[translucentId], translucent});
+    }
+  }
+
+  // Drop the previous map's tiles and GPU data before (re)loading
+  void clear() {
+    pixelSize = Dimension2Du32(0, 0);
+    tileSize = Dimension2Du32(0, 0);
+    tilesets.clear();
+    tiles.clear();
+    chunks.clear();
+    tilesetLayouts.clear();
+    lights.clear();
+    lightmapImage = LightmapImage();
+    lightmap.reset();
+    animations.clear();
+    animationIndices.clear();
+    buffer.reset();
+    sheetArray.reset();
+  }
+
+  // Upload the tiles and pack the tilesets, once they're all loaded
+  void upload() {
+    buffer = makeSharedPtr<GL_TileBuffer>();
+    buffer->upload({tiles.data(), tiles.size()});
+    // The shader block is always full-size, however many animations there are
+    if (!animations.empty()) animations.resize(MAX_ANIMATION_VECS * 4, 0);
+
+    Vector<TilesetPtr> sets;
+    for (auto &ts : tilesets) sets.push_back(ts.tileset);
+    sheetArray = getSheetArray(std::move(sets));
+    const Dimension2Du32 layerSize = sheetArray->array.getSize();
+    tilesetDetails = {(float)tileSize.width(), (float)tileSize.height(),
+                      (float)layerSize.width(), (float)layerSize.height()};
+
+    // Tiles only store their index, so the shader needs each sheet's layout
+    // to find their corners; this block is always full-size too
+    tilesetLayouts.assign(MAX_TILESETS * 4, 0);
+    for (size_t i = 0; i < tilesets.size() && i < MAX_TILESETS; ++i) {
+      const Dimension2Du32 counts = tilesets[i].tileset->getTileCounts();
+      tilesetLayouts[i * 4] = counts.width();
+      tilesetLayouts[i * 4 + 1] = counts.height();
+    }
+  }
+
   Dimension2Du32 pixelSize;
+  Dimension2Du32 tileSize;
   Vector<vec4> mapDetails;
+  Vector<float> tilesetDetails;
+  Vector<Uint32> tilesetLayouts;  // TilesetLayouts block contents, as uvec4s
   Vector<TilesetInstance> tilesets;
+  Vector<TileInstance> tiles;    // Grouped by chunk, in chunk order
+  Vector<TileChunk> chunks;      // Only the ones that have tiles
+  Vector<LightInstance> lights;  // From the map's top-left corner
+  Vector<Uint32> tileBuckets;    // Chunk and opacity of each, while building
+  Vector<Uint32> animations;     // TileAnimations block contents, as uvec4s
+  // Index of each animation added, by tileset and TileId, while building
+  IdHashTable<Uint32> animationIndices;
+  // Only created on the first draw after a (re)load, once tilesets are ready
+  SharedPtr<GL_TileBuffer> buffer;
+  SharedPtr<SheetArray> sheetArray;
+  // Baked while loading, and uploaded on first use
+  LightmapImage lightmapImage;
+  SharedPtr<GL_Lightmap> lightmap;
+  DictionaryPtr staged;  // Parsed by prepareLoad(), applied by finishLoad()
+  SharedPtr<CookedFile> cooked;  // Or the cooked file, likewise
+  TilesetResolver cookResolver;
 };
 
 RENITY_API Tilemap::Tilemap() { pimpl_ = new Impl(); }
@@ -48,42 +362,183 @@ RENITY_API Tilemap::~Tilemap() { delete pimpl_; }
 
 RENITY_API void Tilemap::draw(GL_TileRenderer &renderer,
                               const Point2Di32 position) {
+  draw(renderer, position,
+       Rect2Di32(0, 0, pimpl_->pixelSize.width(), pimpl_->pixelSize.height()));
+}
+
+RENITY_API void Tilemap::draw(GL_TileRenderer &renderer,
+                              const Point2Di32 position,
+                              const Rect2Di32 &view) {
   // Set shader uniforms specifying map position, size, and depth.
-  // The rest of the values are set during load().
+  // The size and depth are set during load().
   // Vertex shader will use this along with tile X/Y/Z to position & sort tiles.
   pimpl_->mapDetails[0].x = (float)position.x();
   pimpl_->mapDetails[0].y = position.y() * -1.0f;
   renderer.getTileShader()->setUniformBlock("MapDetails", pimpl_->mapDetails);
 
-  for (auto &tsInstance : pimpl_->tilesets) {
-    tsInstance.tileset->use();
-    renderer.draw(tsInstance.tiles);
+  // Tiles only change on (re)load, so upload them on the first draw after
+  if (!pimpl_->buffer) pimpl_->upload();
+  pimpl_->sheetArray->refresh();
+  pimpl_->sheetArray->array.use();
+  renderer.getTileShader()->setUniformBlock("TilesetDetails",
+                                            pimpl_->tilesetDetails);
+  renderer.getTileShader()->setUniformBlock("TilesetLayouts",
+                                            pimpl_->tilesetLayouts);
+  if (!pimpl_->animations.empty()) {
+    renderer.getTileShader()->setUniformBlock("TileAnimations",
+                                              pimpl_->animations);
   }
+
+  // Every tileset is a layer of the same texture, so runs of adjacent visible
+  // chunks go out in one draw no matter how many tilesets they use. Opaque
+  // tiles go first, unblended, so the depth test skips whatever they cover.
+  Rect2Di32 visible = view;
+  for (const bool opaque : {true, false}) {
+    Uint32 runStart = 0, runEnd = 0;
+    for (auto &chunk : pimpl_->chunks) {
+      if (!visible.intersects(chunk.bounds)) continue;
+      const Uint32 first = opaque ? chunk.firstOpaque : chunk.firstTranslucent;
+      const Uint32 count = opaque ? chunk.opaqueCount : chunk.translucentCount;
+      if (first != runEnd) {
+        if (runStart != runEnd) {
+          renderer.draw(*pimpl_->buffer, runStart, runEnd - runStart, opaque);
+        }
+        runStart = first;
+      }
+      runEnd = first + count;
+    }
+    if (runStart != runEnd) {
+      renderer.draw(*pimpl_->buffer, runStart, runEnd - runStart, opaque);
+    }
+  }
+}
+
+RENITY_API size_t Tilemap::getCpuBytes() const {
+  return sizeof(vec4) * pimpl_->mapDetails.capacity() +
+         sizeof(float) * pimpl_->tilesetDetails.capacity() +
+         sizeof(Uint32) * pimpl_->tilesetLayouts.capacity() +
+         sizeof(TileInstance) * pimpl_->tiles.capacity() +
+         sizeof(TileChunk) * pimpl_->chunks.capacity() +
+         sizeof(LightInstance) * pimpl_->lights.capacity() +
+         sizeof(Uint32) * pimpl_->lightmapImage.texels.capacity() +
+         sizeof(Uint32) * pimpl_->animations.capacity();
+}
+
+RENITY_API size_t Tilemap::getGpuBytes() const {
+  size_t bytes = 0;
+  if (pimpl_->buffer) bytes += pimpl_->buffer->getGpuBytes();
+  // Shared sheets are split evenly between the maps using them
+  if (pimpl_->sheetArray) {
+    bytes += pimpl_->sheetArray->array.getGpuBytes() /
+             pimpl_->sheetArray.use_count();
+  }
+  if (pimpl_->lightmap) bytes += pimpl_->lightmap->getGpuBytes();
+  return bytes;
+}
+
+RENITY_API Span<const LightInstance> Tilemap::getLights() const {
+  return {pimpl_->lights.data(), pimpl_->lights.size()};
+}
+
+RENITY_API SharedPtr<GL_Lightmap> Tilemap::getLightmap() {
+  LightmapImage &image = pimpl_->lightmapImage;
+  if (!pimpl_->lightmap && !image.texels.empty()) {
+    pimpl_->lightmap = makeSharedPtr<GL_Lightmap>();
+    pimpl_->lightmap->upload(image);
+    image.texels.clear();
+    image.texels.shrink_to_fit();
+  }
+  return pimpl_->lightmap;
 }
 
 RENITY_API void Tilemap::load(SDL_RWops *src) {
-  Impl *pimpl = pimpl_;
+  // No map to draw, e.g. a placeholder for a pending async load
+  if (!src) {
+    pimpl_->clear();
+    return;
+  }
+
+  CookedFile cooked;
+  if (cooked.open(src, COOKED_TILEMAP)) {
+    load(cooked);
+    return;
+  }
   Dictionary dict;
   dict.load(src);
+  load(dict);
+}
+
+RENITY_API bool Tilemap::prepareLoad(SDL_RWops *src) {
+  pimpl_->cooked = makeSharedPtr<CookedFile>();
+  if (pimpl_->cooked->open(src, COOKED_TILEMAP)) return true;
+  pimpl_->cooked.reset();
+  pimpl_->staged = makeSharedPtr<Dictionary>();
+  pimpl_->staged->load(src);
+  return true;
+}
+
+RENITY_API void Tilemap::finishLoad() {
+  if (pimpl_->cooked) {
+    load(*pimpl_->cooked);
+    pimpl_->cooked.reset();
+  }
+  if (!pimpl_->staged) return;
+  load(*pimpl_->staged);
+  pimpl_->staged.reset();
+}
+
+RENITY_API void Tilemap::getDependencies(Vector<ResourceRef> &deps) {
+  if (pimpl_->cooked) {
+    const CookedFile &cooked = *pimpl_->cooked;
+    for (auto &entry :
+         cooked.getSection<CookedTilesetEntry>(TILESETS_SECTION)) {
+      deps.push_back({cooked.getString(entry.source), "Tileset"});
+    }
+    return;
+  }
+  if (!pimpl_->staged) return;
+  pimpl_->staged->enumerateArray(
+      "tilesets", [&deps](Dictionary &dict, const Uint32 &index) {
+        const char *path;
+        if (dict.get<const char *>("source", &path)) {
+          deps.push_back({path, "Tileset"});
+        }
+        return true;
+      });
+}
+
+RENITY_API void Tilemap::load(Dictionary &dict) {
+  Impl *pimpl = pimpl_;
 
   Uint32 tileCountX = 0, tileCountY = 0, tileWidth = 0, tileHeight = 0;
   dict.get<Uint32>("width", &tileCountX);
   dict.get<Uint32>("height", &tileCountY);
   dict.get<Uint32>("tilewidth", &tileWidth);
   dict.get<Uint32>("tileheight", &tileHeight);
-  pimpl_->pixelSize.width(tileCountX * tileWidth);
-  pimpl_->pixelSize.height(tileCountY * tileHeight);
-  if (!pimpl_->pixelSize.width() || !pimpl_->pixelSize.height()) {
+
+  // Invalid maps are left empty, rather than sized for tiles they don't have
+  pimpl_->clear();
+  if (!tileCountX || !tileCountY || !tileWidth || !tileHeight) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                  "Tilemap::load: Invalid map size with width:%u, height:%u, "
                  "tilewidth:%u, tileheight:%u",
                  tileCountX, tileCountY, tileWidth, tileHeight);
     return;
   }
-  pimpl_->mapDetails.assign(MAX_DETAIL_VECS, {0.0f, 0.0f, 0.0f, 0.0f});
+  if (tileCountX > MAX_MAP_TILES || tileCountY > MAX_MAP_TILES) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Tilemap::load: Map size %ux%u is more than the %u tiles "
+                 "across and down allowed.",
+                 tileCountX, tileCountY, MAX_MAP_TILES);
+    return;
+  }
+  pimpl_->pixelSize.width(tileCountX * tileWidth);
+  pimpl_->pixelSize.height(tileCountY * tileHeight);
+  pimpl_->tileSize.width(tileWidth);
+  pimpl_->tileSize.height(tileHeight);
+  pimpl_->mapDetails.assign(1, {0.0f, 0.0f, 0.0f, 0.0f});
 
   // (Re)load the tilesets
-  pimpl_->tilesets.clear();
   dict.enumerateArray(
       "tilesets", [pimpl](Dictionary &dict, const Uint32 &index) {
         TilesetInstance ts;
@@ -94,7 +549,8 @@ RENITY_API void Tilemap::load(SDL_RWops *src) {
                        "Tilemap::load: Missing tileset firstgid or source");
           return true;
         }
-        ts.tileset = ResourceManager::getActive()->get<Tileset>(tilesetPath);
+        ts.source = tilesetPath;
+        if (!pimpl->resolveTileset(ts)) return true;
         pimpl->tilesets.push_back(ts);
         SDL_LogVerbose(
             SDL_LOG_CATEGORY_APPLICATION,
@@ -104,19 +560,21 @@ RENITY_API void Tilemap::load(SDL_RWops *src) {
       });
 
   // (Re)load the tiles, indexed by tileset
-  Uint32 layerCount = dict.end("layers");
+  const Uint32 chunksX = (tileCountX + MAP_CHUNK_TILES - 1) / MAP_CHUNK_TILES;
+  const Uint32 chunksY = (tileCountY + MAP_CHUNK_TILES - 1) / MAP_CHUNK_TILES;
+  // Layers past MAX_MAP_LAYERS are rejected below, so they take no depth
+  const Uint32 layerCount = SDL_min(dict.end("layers"), MAX_MAP_LAYERS);
   dict.enumerateArray("layers", [pimpl, layerCount, tileCountX, tileCountY,
-                                 tileWidth, tileHeight](Dictionary &dict,
-                                                        const Uint32 &index) {
-    /*
+                                 tileWidth, tileHeight, chunksX,
+                                 chunksY](Dictionary &dict,
+                                          const Uint32 &index) {
     if (index >= MAX_MAP_LAYERS) {
       SDL_LogError(
-        SDL_LOG_CATEGORY_APPLICATION,
-        "Tilemap::load: Too many map layers - only %u are supported.",
-        MAX_MAP_LAYERS);
+          SDL_LOG_CATEGORY_APPLICATION,
+          "Tilemap::load: Too many map layers - only %u are supported.",
+          MAX_MAP_LAYERS);
       return false;
     }
-    */
     // TODO: Add object layer support if/when needed
     const char *type = "<undefined>";
     if (!dict.get<const char *>("type", &type) ||
@@ -127,19 +585,22 @@ RENITY_API void Tilemap::load(SDL_RWops *src) {
     }
     const char *layerName = "<unnamed>";
     dict.get("name", &layerName);
-    Uint32 layerId;
+    // Only for logging; ids can have gaps and don't follow the layer order
+    Uint32 layerId = 0;
     dict.get("id", &layerId);
 
-    // Load the list of tiles
-    dict.select("data");
+    // Load the list of tiles in one go
+    Vector<TileId> scratch;
+    const Span<const TileId> tileIds =
+        dict.getArraySpan<TileId>("data", scratch);
     Uint32 tileNum;
-    for (tileNum = dict.begin(); tileNum < tileCountX * tileCountY; ++tileNum) {
+    for (tileNum = 0; tileNum < tileCountX * tileCountY; ++tileNum) {
       TileInstance tile;
-      tile.v = 0;
+      tile.layer = 0;
+      tile.flags = 0;
 
       // Layers should be the same size as the map; ignore missing/extra tiles
-      Uint32 tileId = 0;
-      dict.getIndex(tileNum, &tileId);
+      Uint32 tileId = tileNum < tileIds.size() ? tileIds[tileNum] : 0;
       if (tileId == 0) {
         // Also ignore blank/empty tiles (indexes always start at 1)
         continue;
@@ -150,15 +611,14 @@ RENITY_API void Tilemap::load(SDL_RWops *src) {
       // TODO: Test and support variable tile sizes in the same map
       Uint32 mapSpaceX = tileNum % tileCountX;
       Uint32 mapSpaceY = tileNum / tileCountX;
-      tile.x = mapSpaceX * tileWidth;
-      tile.y = (tileCountY - 1 - mapSpaceY) * tileHeight;
-
-      // Tiled layer order is currently bottom-to-top; top layers have lowest Z
-      Uint32 layerZ = (layerCount - layerId) * pimpl->pixelSize.height();
+      tile.x = mapSpaceX;
+      tile.y = tileCountY - 1 - mapSpaceY;
 
+      // Tiled layer order is currently bottom-to-top; top layers have lowest Z.
       // Currently we're assuming a top-down view with tiles now drawn relative
-      // to the bottom-left; so, lower Y means draw in front (i.e. lower Z)
-      tile.z = layerZ + tile.y;
+      // to the bottom-left; so, lower Y means draw in front (i.e. lower Z).
+      // The shader works that out from the layer and Y.
+      tile.flags = (layerCount - 1 - index) & TILE_DEPTH_MASK;
 
       // Figure out which tileset the tile belongs to
       Sint32 tilesetIndex;
@@ -179,51 +639,62 @@ RENITY_API void Tilemap::load(SDL_RWops *src) {
                      mapSpaceX, mapSpaceY, layerId, layerName);
         continue;
       }
+      if ((Uint32)tilesetIndex >= MAX_TILESETS || tileId > UINT16_MAX) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Tilemap::load: Tile (%u, %u) on layer %u ('%s') is past "
+                     "the first %u tilesets or %u tiles of one.",
+                     mapSpaceX, mapSpaceY, layerId, layerName, MAX_TILESETS,
+                     UINT16_MAX + 1);
+        continue;
+      }
 
       // Add its pointLight if it has one
+      const TilesetInstance &ts = pimpl->tilesets[tilesetIndex];
       Uint32 lightColor =
-          pimpl->tilesets[tilesetIndex].tileset->getLightColor(tileId);
+          tileId < ts.lightColors.size() ? ts.lightColors[tileId] : 0;
       if (lightColor != 0) {
-        if (pimpl->nextLightSlot >= MAX_DETAIL_VECS) {
-          SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                      "Tilemap::load: Exceeded MAX_MAP_LIGHTS (%u); skipping "
-                      "light at (%u, %u) on layer '%s'",
-                      MAX_MAP_LIGHTS, mapSpaceX, mapSpaceY, layerName);
-        } else {
-          vec4 lightColorVec;
-          lightColorVec.r = (float)((lightColor >> 24) & 0x000000FF) / 255.0f;
-          lightColorVec.g = (float)((lightColor >> 16) & 0x000000FF) / 255.0f;
-          lightColorVec.b = (float)((lightColor >> 8) & 0x000000FF) / 255.0f;
-          lightColorVec.a = (float)(lightColor & 0x000000FF) / 255.0f;
-          pimpl->mapDetails.at(pimpl->nextLightSlot++) = lightColorVec;
-          vec4 lightPos;
-          lightPos.x = (float)tile.x;
-          lightPos.y = (float)tile.y;
-          lightPos.z = (float)tile.z;
-          lightPos.w = 1.0f;
-          pimpl->mapDetails.at(pimpl->nextLightSlot++) = lightPos;
-        }
+        // Lights shine from the middle of their tile
+        LightInstance light;
+        light.x = (mapSpaceX + 0.5f) * tileWidth;
+        light.y = (mapSpaceY + 0.5f) * tileHeight;
+        light.r = (lightColor >> 24) & 0xFF;
+        light.g = (lightColor >> 16) & 0xFF;
+        light.b = (lightColor >> 8) & 0xFF;
+        light.a = lightColor & 0xFF;
+        pimpl->lights.push_back(light);
       }
 
-      // Convert tile id to U/V position and invert the Y to make it bottup-up
-      Dimension2Du32 tilesetDims =
-          pimpl->tilesets[tilesetIndex].tileset->getTileCounts();
-      Uint32 tilesetSpaceT = tileId % tilesetDims.width();
-      Uint32 tilesetSpaceU = tileId / tilesetDims.width();
-      tile.t = tilesetSpaceT * tileWidth;
-      tile.u = (tilesetDims.height() - 1 - tilesetSpaceU) * tileHeight;
+      // The shader finds the tile's U/V position from its index, or from
+      // its animation if it has one
+      const Uint32 animation = pimpl->addAnimation(tilesetIndex, tileId);
+      tile.tile = animation ? animation : tileId;
+      if (animation) tile.flags |= TILE_ANIMATED;
+      tile.layer = tilesetIndex;
 
       SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
-                     "Tile (%u, %u, %u)[%u, %u] -> (%u, %u, %u)[%u, %u]",
-                     mapSpaceX, mapSpaceY, layerId, tilesetSpaceT,
-                     tilesetSpaceU, tile.x, tile.y, tile.z, tile.t, tile.u);
-      pimpl->tilesets[tilesetIndex].tiles.push_back(tile);
+                     "Tile (%u, %u, %u)[%u] -> (%u, %u, %u)[%u, %#04x]",
+                     mapSpaceX, mapSpaceY, layerId, tileId, tile.x, tile.y,
+                     tile.tile, tile.layer, tile.flags);
+      pimpl->tiles.push_back(tile);
+
+      // Bucket it by chunk, with translucent tiles after all the opaque ones;
+      // animated tiles are only opaque if every frame is
+      bool opaque = tileId < ts.opaqueTiles.size() && ts.opaqueTiles[tileId];
+      if (animation) {
+        for (auto &frame : Impl::getFrames(ts, tileId)) {
+          opaque = opaque && frame.id < ts.opaqueTiles.size() &&
+                   ts.opaqueTiles[frame.id];
+        }
+      }
+      pimpl->tileBuckets.push_back((opaque ? 0 : chunksX * chunksY) +
+                                   (mapSpaceY / MAP_CHUNK_TILES) * chunksX +
+                                   mapSpaceX / MAP_CHUNK_TILES);
     }
     SDL_LogVerbose(
         SDL_LOG_CATEGORY_APPLICATION,
         "Tilemap::load: Successfully loaded layer %u ('%s') of type '%s' "
         "with %u of %u total tiles.",
-        layerId, layerName, type, tileNum, dict.end());
+        layerId, layerName, type, tileNum, tileIds.size());
 
     return true;
   });
@@ -231,8 +702,17 @@ RENITY_API void Tilemap::load(SDL_RWops *src) {
   // Preconfigure MapDetails for shader
   pimpl_->mapDetails[0].s = -(float)pimpl_->pixelSize.height();
   pimpl_->mapDetails[0].t = (float)(layerCount * pimpl_->pixelSize.height());
-
-  // TODO: Sort tiles front-to-back to take advantage of the depth buffer
+  pimpl_->buildChunks(chunksX, chunksY);
+  GL_Lightmap::bake({pimpl_->lights.data(), pimpl_->lights.size()},
+                    pimpl_->pixelSize, pimpl_->lightmapImage);
+  for (auto &ts : pimpl_->tilesets) {
+    ts.lightColors.clear();
+    ts.lightColors.shrink_to_fit();
+    ts.opaqueTiles.clear();
+    ts.opaqueTiles.shrink_to_fit();
+    ts.animations = TileAnimations();
+  }
+  pimpl_->animationIndices.clear();
 
   SDL_LogVerbose(
       SDL_LOG_CATEGORY_APPLICATION,
@@ -241,4 +721,164 @@ RENITY_API void Tilemap::load(SDL_RWops *src) {
       pimpl_->pixelSize.width(), pimpl_->pixelSize.height(), layerCount,
       pimpl_->tilesets.size());
 }
+
+RENITY_API void Tilemap::load(const CookedFile &cooked) {
+  pimpl_->clear();
+  const Span<const CookedTilemapInfo> info =
+      cooked.getSection<CookedTilemapInfo>(INFO_SECTION);
+  if (info.empty()) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Tilemap::load: Cooked map is missing its details.");
+    return;
+  }
+  pimpl_->pixelSize.width(info[0].pixelWidth);
+  pimpl_->pixelSize.height(info[0].pixelHeight);
+  pimpl_->tileSize.width(info[0].tileWidth);
+  pimpl_->tileSize.height(info[0].tileHeight);
+
+  // Details were already laid out when cooking
+  const Span<const vec4> details = cooked.getSection<vec4>(DETAILS_SECTION);
+  pimpl_->mapDetails.assign(details.begin(), details.end());
+  pimpl_->mapDetails.resize(1, {0.0f, 0.0f, 0.0f, 0.0f});
+
+  // As were the tiles, chunks, and lights, which can be copied out as-is
+  const Span<const TileInstance> tiles =
+      cooked.getSection<TileInstance>(TILES_SECTION);
+  const Span<const CookedTileChunk> chunks =
+      cooked.getSection<CookedTileChunk>(CHUNKS_SECTION);
+  const Span<const CookedTilesetEntry> tilesets =
+      cooked.getSection<CookedTilesetEntry>(TILESETS_SECTION);
+
+  // Tile layers index the tilesets (and their packed layouts), so a tile past
+  // the end means the whole file is corrupt
+  static_assert(UINT8_MAX < MAX_TILESETS, "Tile layers can pass MAX_TILESETS");
+  for (auto &tile : tiles) {
+    if (tile.layer < tilesets.size()) continue;
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Tilemap::load: Cooked tile at (%u, %u) uses tileset %u, "
+                 "but the map only has %u.",
+                 tile.x, tile.y, tile.layer, (Uint32)tilesets.size());
+    pimpl_->clear();
+    return;
+  }
+
+  for (auto &entry : tilesets) {
+    TilesetInstance ts;
+    ts.firstGid = entry.firstGid;
+    ts.source = cooked.getString(entry.source);
+    ts.tileset = ResourceManager::getActive()->get<Tileset>(ts.source.c_str());
+    pimpl_->tilesets.push_back(ts);
+  }
+  pimpl_->tiles.assign(tiles.begin(), tiles.end());
+  const Span<const LightInstance> lights =
+      cooked.getSection<LightInstance>(LIGHTS_SECTION);
+  pimpl_->lights.assign(lights.begin(), lights.end());
+  const Span<const CookedLightmapInfo> lightmapInfo =
+      cooked.getSection<CookedLightmapInfo>(LIGHTMAP_INFO_SECTION);
+  const Span<const Uint32> lightmap =
+      cooked.getSection<Uint32>(LIGHTMAP_SECTION);
+  if (!lightmapInfo.empty() &&
+      lightmap.size() ==
+          (size_t)lightmapInfo[0].width * lightmapInfo[0].height) {
+    const CookedLightmapInfo &info = lightmapInfo[0];
+    LightmapImage &image = pimpl_->lightmapImage;
+    image.bounds = Rect2Di32(info.x, info.y, info.pixelWidth, info.pixelHeight);
+    image.size = Dimension2Du32(info.width, info.height);
+    image.texels.assign(lightmap.begin(), lightmap.end());
+  }
+  const Span<const Uint32> animations =
+      cooked.getSection<Uint32>(ANIMATIONS_SECTION);
+  if (animations.size() <= MAX_ANIMATION_VECS * 4) {
+    pimpl_->animations.assign(animations.begin(), animations.end());
+  }
+  const Uint32 animationVecs = (Uint32)pimpl_->animations.size() / 4;
+  for (auto &tile : pimpl_->tiles) {
+    if (!(tile.flags & TILE_ANIMATED) || tile.tile < animationVecs) continue;
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Tilemap::load: Cooked tile at (%u, %u) has an out of "
+                 "bounds animation.",
+                 tile.x, tile.y);
+    tile.tile = 0;
+    tile.flags &= ~TILE_ANIMATED;
+  }
+  for (auto &chunk : chunks) {
+    if (chunk.firstOpaque > tiles.size() ||
+        chunk.opaqueCount > tiles.size() - chunk.firstOpaque ||
+        chunk.firstTranslucent > tiles.size() ||
+        chunk.translucentCount > tiles.size() - chunk.firstTranslucent) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Tilemap::load: Cooked chunk %u has out of bounds tiles.",
+                   chunk.id);
+      continue;
+    }
+    pimpl_->chunks.push_back(
+        {chunk.id, Rect2Di32(chunk.x, chunk.y, chunk.width, chunk.height),
+         chunk.firstOpaque, chunk.opaqueCount, chunk.firstTranslucent,
+         chunk.translucentCount});
+  }
+
+  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                 "Tilemap::load: Successfully loaded %ux%u px cooked map with "
+                 "%u tile(s), %u tileset(s).",
+                 pimpl_->pixelSize.width(), pimpl_->pixelSize.height(),
+                 tiles.size(), pimpl_->tilesets.size());
+}
+
+RENITY_API bool Tilemap::cook(Dictionary &dict, CookedFileWriter &out) {
+  out.setType(COOKED_TILEMAP);
+  // Build the map as usual, but reading tilesets from their files
+  bool tilesetsValid = true;
+  Tilemap map;
+  map.pimpl_->cookResolver = [&tilesetsValid](TilesetInstance &ts) {
+    SDL_RWops *src = RENITY_OpenRead(ts.source.c_str());
+    if (!src) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Tilemap::cook: Could not open tileset '%s': %s",
+                   ts.source.c_str(), SDL_GetError());
+      tilesetsValid = false;
+      return false;
+    }
+    Dictionary tileset;
+    tileset.load(src);
+    if (!Tileset::readTileDetails(tileset, &ts.tileCounts, &ts.lightColors,
+                                  &ts.opaqueTiles, &ts.animations)) {
+      tilesetsValid = false;
+    }
+    return true;
+  };
+  map.load(dict);
+  const Impl *pimpl = map.pimpl_;
+  if (!tilesetsValid || !pimpl->pixelSize.getArea()) return false;
+
+  Vector<CookedTilesetEntry> entries;
+  for (auto &ts : pimpl->tilesets) {
+    entries.push_back({ts.firstGid, out.addString(ts.source.c_str())});
+  }
+  Vector<CookedTileChunk> chunks;
+  for (auto &chunk : pimpl->chunks) {
+    chunks.push_back({chunk.id, chunk.bounds.x(), chunk.bounds.y(),
+                      chunk.bounds.width(), chunk.bounds.height(),
+                      chunk.firstOpaque, chunk.opaqueCount,
+                      chunk.firstTranslucent, chunk.translucentCount});
+  }
+  const CookedTilemapInfo info = {
+      pimpl->pixelSize.width(), pimpl->pixelSize.height(),
+      pimpl->tileSize.width(), pimpl->tileSize.height()};
+  out.addSection(INFO_SECTION, &info, sizeof(info));
+  out.addSection(DETAILS_SECTION, pimpl->mapDetails);
+  out.addSection(TILESETS_SECTION, entries);
+  out.addSection(TILES_SECTION, pimpl->tiles);
+  out.addSection(CHUNKS_SECTION, chunks);
+  out.addSection(ANIMATIONS_SECTION, pimpl->animations);
+  out.addSection(LIGHTS_SECTION, pimpl->lights);
+  const LightmapImage &image = pimpl->lightmapImage;
+  if (!image.texels.empty()) {
+    const CookedLightmapInfo lightmapInfo = {
+        image.bounds.x(),      image.bounds.y(),     image.bounds.width(),
+        image.bounds.height(), image.size.width(), image.size.height()};
+    out.addSection(LIGHTMAP_INFO_SECTION, &lightmapInfo, sizeof(lightmapInfo));
+    out.addSection(LIGHTMAP_SECTION, image.texels);
+  }
+  return true;
+}
 }  // namespace renity
@@ -10,26 +10,228 @@
 #include "resources/Tileset.h"
 
 #include <SDL3/SDL_log.h>
-// #include <SDL3/SDL_pixels.h>
-// #include <SDL3/SDL_surface.h>
+#include <SDL3/SDL_pixels.h>
+#include <SDL3/SDL_surface.h>
 
 #include <cmath>
 
+#include "CookedFile.h"
 #include "Dictionary.h"
 #include "ResourceManager.h"
 #include "resources/GL_ShaderProgram.h"
 #include "resources/GL_Texture2D.h"
 #include "utils/string_helpers.h"
+#include "utils/surface_utils.h"
 
 namespace renity {
+static const Uint32 COOKED_TILESET = cookedTag("TSET");
+static const Uint32 INFO_SECTION = cookedTag("INFO");
+static const Uint32 LIGHT_SECTION = cookedTag("LITE");
+static const Uint32 OPAQUE_SECTION = cookedTag("OPAQ");
+static const Uint32 ANIM_STARTS_SECTION = cookedTag("ASTR");
+static const Uint32 ANIM_FRAMES_SECTION = cookedTag("ANIM");
+
+// Cooked INFO section layout
+struct CookedTilesetInfo {
+  Uint32 imagePath;  // Offset into the strings section
+  Uint32 imageWidth, imageHeight, tileWidth, tileHeight;
+};
+
+// Read the sheet image details, or defaults if any are missing
+static bool readSheetDetails(Dictionary &dict, const char **sheetPathOut,
+                             CookedTilesetInfo *infoOut) {
+  static const DictionaryPath imagePath("image"),
+      imageWidthPath("imagewidth"), imageHeightPath("imageheight"),
+      tileWidthPath("tilewidth"), tileHeightPath("tileheight");
+  *sheetPathOut = "<default>";
+  *infoOut = {0, 32, 32, 32, 32};
+  if (!dict.get<const char *>(imagePath, sheetPathOut) ||
+      !dict.get<Uint32>(imageWidthPath, &infoOut->imageWidth) ||
+      !dict.get<Uint32>(imageHeightPath, &infoOut->imageHeight) ||
+      !dict.get<Uint32>(tileWidthPath, &infoOut->tileWidth) ||
+      !dict.get<Uint32>(tileHeightPath, &infoOut->tileHeight) ||
+      !infoOut->tileWidth || !infoOut->tileHeight) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Tileset::load: Missing image path or dimension details - "
+                 "using internal defaults.");
+    *sheetPathOut = "<default>";
+    *infoOut = {0, 32, 32, 32, 32};
+    return false;
+  }
+  return true;
+}
+
+// Fill in the colors of any pointLight tiles; others are left as-is
+static void readPointLights(Dictionary &dict, Vector<Uint32> &colors) {
+  if (!dict.isArray("tiles")) return;
+  dict.enumerateArray("tiles", [colors = &colors](Dictionary &dict,
+                                                  const Uint32 &index) {
+    if (!dict.isArray("properties")) return true;
+
+    size_t id = 0;
+    dict.get("id", &id);
+    dict.enumerateArray("properties", [id, colors](Dictionary &dict,
+                                                   const Uint32 &index) {
+      const char *name, *type;
+      if (!dict.get<const char *>("name", &name) ||
+          !dict.get<const char *>("type", &type)) {
+        SDL_LogError(
+            SDL_LOG_CATEGORY_APPLICATION,
+            "Tileset::load: Missing name or type for property %u of tile %u.",
+            index, id);
+        return true;
+      }
+      if (beginsWith(name, "pointLight") && id < colors->size()) {
+        const char *valueStr = "0";
+        dict.get<const char *>("value", &valueStr);
+        Uint32 value = strToColor(valueStr);
+        // Skip if the color is totally transparent
+        if (value & 0xFF) colors->at(id) = value;
+      }
+      return true;
+    });
+    return true;
+  });
+}
+
+// Read the frames of any animated tiles, leaving the rest unanimated
+static void readAnimations(Dictionary &dict, Uint32 tileCount,
+                           TileAnimations &animations) {
+  // Tiles may be listed in any order, so gather them up before flattening
+  Vector<Vector<TileFrame>> tileFrames(tileCount);
+  if (dict.isArray("tiles")) {
+    dict.enumerateArray("tiles", [&tileFrames](Dictionary &dict,
+                                               const Uint32 &index) {
+      TileId id = 0;
+      if (!dict.isArray("animation") || !dict.get("id", &id)) return true;
+      if (id >= tileFrames.size()) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Tileset::load: Skipping animation of out-of-range tile "
+                    "%u.",
+                    id);
+        return true;
+      }
+      Vector<TileFrame> &frames = tileFrames[id];
+      dict.enumerateArray("animation", [id, &frames, &tileFrames](
+                                           Dictionary &dict,
+                                           const Uint32 &index) {
+        TileFrame frame;
+        if (!dict.get("tileid", &frame.id) ||
+            !dict.get("duration", &frame.duration) ||
+            frame.id >= tileFrames.size()) {
+          SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                       "Tileset::load: Invalid frame %u of tile %u's "
+                       "animation.",
+                       index, id);
+          return true;
+        }
+        frames.push_back(frame);
+        return true;
+      });
+      return true;
+    });
+  }
+
+  animations.starts.resize(tileCount + 1);
+  animations.frames.clear();
+  for (TileId id = 0; id < tileCount; ++id) {
+    animations.starts[id] = (Uint32)animations.frames.size();
+    animations.frames.insert(animations.frames.end(), tileFrames[id].begin(),
+                             tileFrames[id].end());
+  }
+  animations.starts[tileCount] = (Uint32)animations.frames.size();
+}
+
+// Find which tiles of a sheet image have no transparent pixels, so they can be
+// drawn without blending. Only for tools; loads ask the sheet texture instead.
+static bool readOpaqueTiles(const char *sheetPath,
+                            const CookedTilesetInfo &info,
+                            Vector<Uint8> &opaque) {
+  opaque.clear();
+  SDL_Surface *surf = RENITY_LoadPhysSurface(sheetPath);
+  SDL_Surface *rgbaSurf =
+      surf ? SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_RGBA32) : nullptr;
+  SDL_DestroySurface(surf);
+  if (!rgbaSurf) {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "Tileset::load: Could not read '%s' to find opaque tiles; "
+                "treating them all as translucent: %s",
+                sheetPath, SDL_GetError());
+    return true;
+  }
+
+  // Tiles are indexed by the tileset's layout, so the image has to match it
+  if ((Uint32)rgbaSurf->w != info.imageWidth ||
+      (Uint32)rgbaSurf->h != info.imageHeight) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Tileset::load: Size mismatch (%ux%u vs. %ix%i) between "
+                 "tileset and image [%s]",
+                 info.imageWidth, info.imageHeight, rgbaSurf->w, rgbaSurf->h,
+                 sheetPath);
+    SDL_DestroySurface(rgbaSurf);
+    return false;
+  }
+
+  const Uint32 countX = rgbaSurf->w / info.tileWidth;
+  const Uint32 countY = rgbaSurf->h / info.tileHeight;
+  opaque.assign(countX * countY, 1);
+  SDL_LockSurface(rgbaSurf);
+  for (Uint32 y = 0; y < countY * info.tileHeight; ++y) {
+    const Uint8 *row = (const Uint8 *)rgbaSurf->pixels + y * rgbaSurf->pitch;
+    const Uint32 rowTiles = (y / info.tileHeight) * countX;
+    for (Uint32 x = 0; x < countX * info.tileWidth; ++x) {
+      // RGBA32 is byte-ordered, so alpha is always the fourth byte
+      if (row[x * 4 + 3] != 0xFF) opaque[rowTiles + x / info.tileWidth] = 0;
+    }
+  }
+  SDL_UnlockSurface(rgbaSurf);
+  SDL_DestroySurface(rgbaSurf);
+  return true;
+}
+
 struct Tileset::Impl {
   explicit Impl() {}
   ~Impl() {}
 
+  // Load the sheet texture and derive the tile counts from its size
+  void useSheet(const char *sheetPath, const CookedTilesetInfo &info) {
+    tex = ResourceManager::getActive()->get<GL_Texture2D>(sheetPath);
+    Dimension2Du32 imgSize = tex->getSize();
+    if (imgSize.width() != info.imageWidth ||
+        imgSize.height() != info.imageHeight) {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                  "Tileset::load: Size mismatch (%ux%u vs. %ux%u) between "
+                  "tileset and image [%s]",
+                  info.imageWidth, info.imageHeight, imgSize.width(),
+                  imgSize.height(), sheetPath);
+    }
+
+    tilesetSize = {(float)info.tileWidth, (float)info.tileHeight,
+                   (float)imgSize.width(), (float)imgSize.height()};
+    tileCount.width(imgSize.width() / info.tileWidth);
+    tileCount.height(imgSize.height() / info.tileHeight);
+  }
+
+  // Find the opaque tiles from the sheet texture, which recorded its opaque
+  // areas when it was decoded
+  void findOpaqueTiles(const CookedTilesetInfo &info) {
+    opaqueTiles.assign(tileCount.getArea(), 0);
+    for (Uint32 id = 0; id < opaqueTiles.size(); ++id) {
+      const Sint32 x = (id % tileCount.width()) * info.tileWidth;
+      const Sint32 y = (id / tileCount.width()) * info.tileHeight;
+      opaqueTiles[id] =
+          tex->isOpaque(Rect2Di32(x, y, info.tileWidth, info.tileHeight));
+    }
+  }
+
   Dimension2Du32 tileCount;
   Vector<float> tilesetSize;
   Vector<Uint32> pointLights;
+  Vector<Uint8> opaqueTiles;
+  TileAnimations animations;
   GL_Texture2DPtr tex;
+  DictionaryPtr staged;
+  SharedPtr<CookedFile> cooked;
 };
 
 RENITY_API Tileset::Tileset() { pimpl_ = new Impl(); }
@@ -59,10 +261,119 @@ RENITY_API Dimension2Du32 Tileset::getTileCounts() const {
   return pimpl_->tileCount;
 }
 
+RENITY_API GL_Texture2DPtr Tileset::getTexture() const { return pimpl_->tex; }
+
+RENITY_API bool Tileset::isOpaque(TileId id) const {
+  return id < pimpl_->opaqueTiles.size() && pimpl_->opaqueTiles[id];
+}
+
+RENITY_API Span<const TileFrame> Tileset::getAnimation(TileId id) const {
+  const TileAnimations &anims = pimpl_->animations;
+  if (id + 1 >= anims.starts.size()) return {};
+  const Uint32 first = anims.starts[id];
+  return {anims.frames.data() + first, anims.starts[id + 1] - first};
+}
+
+RENITY_API size_t Tileset::getCpuBytes() const {
+  // The texture is a separately-cached Resource, so don't count it here
+  return sizeof(Uint32) * pimpl_->pointLights.capacity() +
+         sizeof(Uint8) * pimpl_->opaqueTiles.capacity() +
+         sizeof(Uint32) * pimpl_->animations.starts.capacity() +
+         sizeof(TileFrame) * pimpl_->animations.frames.capacity() +
+         sizeof(float) * pimpl_->tilesetSize.capacity();
+}
+
 RENITY_API void Tileset::load(SDL_RWops *src) {
+  CookedFile cooked;
+  if (cooked.open(src, COOKED_TILESET)) {
+    load(cooked);
+    return;
+  }
   Dictionary dict;
   dict.load(src);
+  load(dict);
+}
 
+RENITY_API bool Tileset::prepareLoad(SDL_RWops *src) {
+  pimpl_->cooked = makeSharedPtr<CookedFile>();
+  if (pimpl_->cooked->open(src, COOKED_TILESET)) return true;
+  pimpl_->cooked.reset();
+  pimpl_->staged = makeSharedPtr<Dictionary>();
+  pimpl_->staged->load(src);
+  return true;
+}
+
+RENITY_API void Tileset::finishLoad() {
+  if (pimpl_->cooked) {
+    load(*pimpl_->cooked);
+    pimpl_->cooked.reset();
+  }
+  if (!pimpl_->staged) return;
+  load(*pimpl_->staged);
+  pimpl_->staged.reset();
+}
+
+RENITY_API void Tileset::getDependencies(Vector<ResourceRef> &deps) {
+  const char *sheetPath;
+  if (pimpl_->cooked) {
+    const Span<const CookedTilesetInfo> info =
+        pimpl_->cooked->getSection<CookedTilesetInfo>(INFO_SECTION);
+    if (!info.empty()) {
+      deps.push_back({pimpl_->cooked->getString(info[0].imagePath),
+                      "GL_Texture2D"});
+    }
+  } else if (pimpl_->staged &&
+             pimpl_->staged->get<const char *>("image", &sheetPath)) {
+    deps.push_back({sheetPath, "GL_Texture2D"});
+  }
+}
+
+RENITY_API bool Tileset::cook(Dictionary &dict, CookedFileWriter &out) {
+  out.setType(COOKED_TILESET);
+  const char *sheetPath;
+  CookedTilesetInfo info;
+  if (!readSheetDetails(dict, &sheetPath, &info)) return false;
+  info.imagePath = out.addString(sheetPath);
+
+  Dimension2Du32 tileCounts;
+  Vector<Uint32> lightColors;
+  Vector<Uint8> opaqueTiles;
+  TileAnimations animations;
+  if (!readTileDetails(dict, &tileCounts, &lightColors, &opaqueTiles,
+                       &animations)) {
+    return false;
+  }
+  out.addSection(INFO_SECTION, &info, sizeof(info));
+  out.addSection(LIGHT_SECTION, lightColors);
+  out.addSection(OPAQUE_SECTION, opaqueTiles);
+  out.addSection(ANIM_STARTS_SECTION, animations.starts);
+  out.addSection(ANIM_FRAMES_SECTION, animations.frames);
+  return true;
+}
+
+RENITY_API bool Tileset::readTileDetails(Dictionary &dict,
+                                         Dimension2Du32 *tileCountsOut,
+                                         Vector<Uint32> *lightColorsOut,
+                                         Vector<Uint8> *opaqueTilesOut,
+                                         TileAnimations *animationsOut) {
+  const char *sheetPath;
+  CookedTilesetInfo info;
+  bool valid = readSheetDetails(dict, &sheetPath, &info);
+  tileCountsOut->width(info.imageWidth / info.tileWidth);
+  tileCountsOut->height(info.imageHeight / info.tileHeight);
+  lightColorsOut->assign(tileCountsOut->getArea(), 0);
+  readPointLights(dict, *lightColorsOut);
+  if (opaqueTilesOut) {
+    if (!readOpaqueTiles(sheetPath, info, *opaqueTilesOut)) valid = false;
+    opaqueTilesOut->resize(tileCountsOut->getArea(), 0);
+  }
+  if (animationsOut) {
+    readAnimations(dict, tileCountsOut->getArea(), *animationsOut);
+  }
+  return valid;
+}
+
+RENITY_API void Tileset::load(Dictionary &dict) {
   // TODO: Do we need transparency mapping? Even quantized PNGs should be able
   // to use a palette index for a fully-transparent background color
   /*
@@ -81,64 +392,56 @@ RENITY_API void Tileset::load(SDL_RWops *src) {
     }
   */
 
-  const char *sheetPath = "<default>";
-  Uint32 sheetWidth = 32, sheetHeight = 32, tileWidth = 32, tileHeight = 32;
-  if (!dict.get<const char *>("image", &sheetPath) ||
-      !dict.get<Uint32>("imagewidth", &sheetWidth) ||
-      !dict.get<Uint32>("imageheight", &sheetHeight) ||
-      !dict.get<Uint32>("tilewidth", &tileWidth) ||
-      !dict.get<Uint32>("tileheight", &tileHeight)) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                 "Tileset::load: Missing image path or dimension details - "
-                 "using internal defaults.");
-  }
+  const char *sheetPath;
+  CookedTilesetInfo info;
+  readSheetDetails(dict, &sheetPath, &info);
+  pimpl_->useSheet(sheetPath, info);
 
-  pimpl_->tex = ResourceManager::getActive()->get<GL_Texture2D>(sheetPath);
-  Dimension2Du32 imgSize = pimpl_->tex->getSize();
-  if (imgSize.width() != sheetWidth || imgSize.height() != sheetHeight) {
-    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                "Tileset::load: Size mismatch (%ux%u vs. %ux%u) between "
-                "tileset and image [%s]",
-                sheetWidth, sheetHeight, imgSize.width(), imgSize.height(),
-                sheetPath);
-  }
+  // (Re)load tile properties
+  pimpl_->pointLights.assign(pimpl_->tileCount.getArea(), 0);
+  readPointLights(dict, pimpl_->pointLights);
+  readAnimations(dict, pimpl_->tileCount.getArea(), pimpl_->animations);
+  pimpl_->findOpaqueTiles(info);
+}
 
-  pimpl_->tilesetSize = {(float)tileWidth, (float)tileHeight,
-                         (float)imgSize.width(), (float)imgSize.height()};
-  pimpl_->tileCount.width(imgSize.width() / tileWidth);
-  pimpl_->tileCount.height(imgSize.height() / tileHeight);
+RENITY_API void Tileset::load(const CookedFile &cooked) {
+  const Span<const CookedTilesetInfo> info =
+      cooked.getSection<CookedTilesetInfo>(INFO_SECTION);
+  if (info.empty()) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Tileset::load: Cooked tileset is missing its details.");
+    return;
+  }
+  pimpl_->useSheet(cooked.getString(info[0].imagePath), info[0]);
 
-  // (Re)load tile properties
-  size_t totalTiles = pimpl_->tileCount.getArea();
-  pimpl_->pointLights.assign(totalTiles, 0);
-  if (!dict.isArray("tiles")) return;
-  dict.enumerateArray("tiles", [colors = &pimpl_->pointLights](
-                                   Dictionary &dict, const Uint32 &index) {
-    if (!dict.isArray("properties")) return true;
+  // Light colors were cooked using the tileset's recorded image size; the
+  // texture may differ, so fit them to it
+  const Span<const Uint32> lights = cooked.getSection<Uint32>(LIGHT_SECTION);
+  pimpl_->pointLights.assign(lights.begin(), lights.end());
+  pimpl_->pointLights.resize(pimpl_->tileCount.getArea(), 0);
+  const Span<const Uint8> opaque = cooked.getSection<Uint8>(OPAQUE_SECTION);
+  pimpl_->opaqueTiles.assign(opaque.begin(), opaque.end());
+  pimpl_->opaqueTiles.resize(pimpl_->tileCount.getArea(), 0);
 
-    size_t id = 0;
-    dict.get("id", &id);
-    dict.enumerateArray("properties", [id, colors](Dictionary &dict,
-                                                   const Uint32 &index) {
-      const char *name, *type;
-      if (!dict.get<const char *>("name", &name) ||
-          !dict.get<const char *>("type", &type)) {
-        SDL_LogError(
-            SDL_LOG_CATEGORY_APPLICATION,
-            "Tileset::load: Missing name or type for property %u of tile %u.",
-            index, id);
-        return true;
-      }
-      if (beginsWith(name, "pointLight")) {
-        const char *valueStr = "0";
-        dict.get<const char *>("value", &valueStr);
-        Uint32 value = strToColor(valueStr);
-        // Skip if the color is totally transparent
-        if (value & 0xFF) colors->at(id) = value;
-      }
-      return true;
-    });
-    return true;
-  });
+  // Likewise for animations, dropping any that refer past the texture
+  const Uint32 tileCount = pimpl_->tileCount.getArea();
+  const Span<const Uint32> starts =
+      cooked.getSection<Uint32>(ANIM_STARTS_SECTION);
+  const Span<const TileFrame> frames =
+      cooked.getSection<TileFrame>(ANIM_FRAMES_SECTION);
+  TileAnimations &anims = pimpl_->animations;
+  anims.starts.assign(tileCount + 1, 0);
+  anims.frames.clear();
+  for (TileId id = 0; id < tileCount; ++id) {
+    anims.starts[id] = (Uint32)anims.frames.size();
+    if (id + 1 >= starts.size() || starts[id] > starts[id + 1] ||
+        starts[id + 1] > frames.size()) {
+      continue;
+    }
+    for (Uint32 i = starts[id]; i < starts[id + 1]; ++i) {
+      if (frames[i].id < tileCount) anims.frames.push_back(frames[i]);
+    }
+  }
+  anims.starts[tileCount] = (Uint32)anims.frames.size();
 }
 }  // namespace renity
@@ -14,6 +14,17 @@
 
 #include "utils/physfsrwops.h"
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RENITY_HAVE_MMAP 1
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif  //__cplusplus
@@ -104,6 +115,203 @@ RENITY_API Sint64 RENITY_ReadCharBufferMax(SDL_RWops* src, char** bufOut,
   }
   return readBytes;
 }
+/* Memory-mapped files are visible all at once, so reads are plain copies and
+ * RENITY_GetMappedBuffer() can hand out the mapping itself.
+ */
+typedef struct MappedFile {
+  Uint8* base;
+  Sint64 size;
+  Sint64 pos;
+} MappedFile;
+
+static Uint8* mapNativeFile(const char* path, Sint64* sizeOut) {
+  Uint8* base = NULL;
+#if defined(_WIN32)
+  WCHAR* widePath = (WCHAR*)SDL_iconv_string("UTF-16LE", "UTF-8", path,
+                                             SDL_strlen(path) + 1);
+  if (!widePath) return NULL;
+  HANDLE file = CreateFileW(widePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  SDL_free(widePath);
+  if (file == INVALID_HANDLE_VALUE) return NULL;
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    // The view keeps the file open, so the handles can be closed right away
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping) {
+      base = (Uint8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+      *sizeOut = (Sint64)size.QuadPart;
+    }
+  }
+  CloseHandle(file);
+#elif defined(RENITY_HAVE_MMAP)
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    // The mapping keeps the file open, so the descriptor can be closed
+    void* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) {
+      base = (Uint8*)mapped;
+      *sizeOut = (Sint64)info.st_size;
+    }
+  }
+  close(fd);
+#else
+  (void)path;
+  (void)sizeOut;
+#endif
+  return base;
+}
+
+static void unmapNativeFile(Uint8* base, Sint64 size) {
+#if defined(_WIN32)
+  (void)size;
+  UnmapViewOfFile(base);
+#elif defined(RENITY_HAVE_MMAP)
+  munmap(base, (size_t)size);
+#else
+  (void)base;
+  (void)size;
+#endif
+}
+
+/* Translate a PhysFS path to a native one, if the file is in a real directory.
+ * Paths inside archives will come out as e.g. "data.zip/file", which fails to
+ * open, so there's no need to check which kind of search path it's in.
+ */
+static char* getNativePath(const char* fname) {
+  const char* realDir = PHYSFS_getRealDir(fname);
+  if (!realDir) return NULL;
+
+  // Strip off wherever the directory is mounted in the virtual tree
+  const char* mountPoint = PHYSFS_getMountPoint(realDir);
+  const char* relPath = fname;
+  while (*relPath == '/') ++relPath;
+  if (mountPoint) {
+    while (*mountPoint == '/') ++mountPoint;
+    const size_t mountLength = SDL_strlen(mountPoint);
+    if (SDL_strncmp(relPath, mountPoint, mountLength) == 0) {
+      relPath += mountLength;
+    }
+  }
+
+  const char* dirSep = PHYSFS_getDirSeparator();
+  const size_t dirLength = SDL_strlen(realDir);
+  const size_t sepLength = SDL_strlen(dirSep);
+  const size_t relLength = SDL_strlen(relPath);
+  char* nativePath = (char*)SDL_malloc(dirLength + sepLength + relLength + 1);
+  if (!nativePath) return NULL;
+  SDL_memcpy(nativePath, realDir, dirLength);
+  char* out = nativePath + dirLength;
+  if (!dirLength || SDL_strncmp(out - sepLength, dirSep, sepLength) != 0) {
+    SDL_memcpy(out, dirSep, sepLength);
+    out += sepLength;
+  }
+  for (const char* in = relPath; *in; ++in) {
+    if (*in == '/') {
+      SDL_memcpy(out, dirSep, sepLength);
+      out += sepLength;
+    } else {
+      *out++ = *in;
+    }
+  }
+  *out = '\0';
+  return nativePath;
+}
+
+static Sint64 mappedrwops_size(SDL_RWops* rw) {
+  return ((MappedFile*)rw->hidden.unknown.data1)->size;
+}
+
+static Sint64 mappedrwops_seek(SDL_RWops* rw, Sint64 offset, int whence) {
+  MappedFile* map = (MappedFile*)rw->hidden.unknown.data1;
+  Sint64 pos;
+  if (whence == SDL_RW_SEEK_SET) {
+    pos = offset;
+  } else if (whence == SDL_RW_SEEK_CUR) {
+    pos = map->pos + offset;
+  } else if (whence == SDL_RW_SEEK_END) {
+    pos = map->size + offset;
+  } else {
+    return SDL_SetError("Invalid 'whence' parameter.");
+  }
+  if (pos < 0) {
+    return SDL_SetError("Attempt to seek past start of file.");
+  }
+  map->pos = SDL_min(pos, map->size);
+  return map->pos;
+}
+
+static Sint64 mappedrwops_read(SDL_RWops* rw, void* ptr, Sint64 size) {
+  MappedFile* map = (MappedFile*)rw->hidden.unknown.data1;
+  const Sint64 readBytes = SDL_min(size, map->size - map->pos);
+  if (readBytes <= 0) return 0;
+  SDL_memcpy(ptr, map->base + map->pos, (size_t)readBytes);
+  map->pos += readBytes;
+  return readBytes;
+}
+
+static Sint64 mappedrwops_write(SDL_RWops* rw, const void* ptr, Sint64 size) {
+  (void)rw;
+  (void)ptr;
+  (void)size;
+  SDL_SetError("Memory-mapped files are read-only.");
+  return 0;
+}
+
+static int mappedrwops_close(SDL_RWops* rw) {
+  MappedFile* map = (MappedFile*)rw->hidden.unknown.data1;
+  unmapNativeFile(map->base, map->size);
+  SDL_free(map);
+  SDL_DestroyRW(rw);
+  return 0;
+}
+
+RENITY_API SDL_RWops* RENITY_OpenMappedRead(const char* fname) {
+  if (!fname) return NULL;
+  char* nativePath = getNativePath(fname);
+  if (!nativePath) return NULL;
+  Sint64 size = 0;
+  Uint8* base = mapNativeFile(nativePath, &size);
+  SDL_LogVerbose(SDL_LOG_CATEGORY_APPLICATION,
+                 "RENITY_OpenMappedRead: %s '%s' (%li bytes).\n",
+                 base ? "Mapped" : "Could not map", nativePath, size);
+  SDL_free(nativePath);
+  if (!base) return NULL;
+
+  MappedFile* map = (MappedFile*)SDL_malloc(sizeof(MappedFile));
+  SDL_RWops* rw = map ? SDL_CreateRW() : NULL;
+  if (!rw) {
+    SDL_free(map);
+    unmapNativeFile(base, size);
+    return NULL;
+  }
+  map->base = base;
+  map->size = size;
+  map->pos = 0;
+  rw->size = mappedrwops_size;
+  rw->seek = mappedrwops_seek;
+  rw->read = mappedrwops_read;
+  rw->write = mappedrwops_write;
+  rw->close = mappedrwops_close;
+  rw->hidden.unknown.data1 = map;
+  return rw;
+}
+
+RENITY_API SDL_RWops* RENITY_OpenRead(const char* fname) {
+  SDL_RWops* rw = RENITY_OpenMappedRead(fname);
+  return rw ? rw : PHYSFSRWOPS_openRead(fname);
+}
+
+RENITY_API const Uint8* RENITY_GetMappedBuffer(SDL_RWops* src,
+                                               Sint64* sizeOut) {
+  if (!src || src->close != mappedrwops_close) return NULL;
+  MappedFile* map = (MappedFile*)src->hidden.unknown.data1;
+  if (sizeOut) *sizeOut = map->size;
+  return map->base;
+}
 #ifdef __cplusplus
 }
 #endif  //__cplusplus
@@ -13,7 +13,7 @@
 #include <SDL3/SDL_image.h>
 #include <SDL3/SDL_stdinc.h>
 
-#include "utils/physfsrwops.h"
+#include "utils/rwops_utils.h"
 
 /** Load an SDL surface from an SDL_RWops. */
 RENITY_API SDL_Surface *RENITY_LoadPhysSurfaceRW(SDL_RWops *src) {
@@ -26,7 +26,7 @@ RENITY_API SDL_Surface *RENITY_LoadPhysSurfaceRW(SDL_RWops *src) {
 /** Load an SDL surface from a PhysFS image file. */
 RENITY_API SDL_Surface *RENITY_LoadPhysSurface(const char *fname) {
   if (fname) {
-    SDL_RWops *rw = PHYSFSRWOPS_openRead(fname);
+    SDL_RWops *rw = RENITY_OpenRead(fname);
     return RENITY_LoadPhysSurfaceRW(rw);
   }
 
@@ -0,0 +1,76 @@
+/****************************************************
+ * Test - CookedFile                                *
+ * Copyright (C) 2023 Zach Caldwell                 *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+
+#include "CookedFile.h"
+
+#include <SDL3/SDL_rwops.h>
+#include <assert.h>
+#include <string.h>
+
+using namespace renity;
+
+int main(void) {
+  const Uint32 type = cookedTag("TEST");
+  const Uint32 numbersTag = cookedTag("NUMS");
+  const Uint32 bytesTag = cookedTag("BYTE");
+
+  // Build a file with a few sections and strings
+  CookedFileWriter writer(type);
+  const Vector<Uint32> numbers = {1, 2, 3, 0xDEADBEEF};
+  const Vector<Uint8> bytes = {7, 8, 9};
+  writer.addSection(bytesTag, bytes);
+  writer.addSection(numbersTag, Vector<Uint32>{42});
+  writer.addSection(numbersTag, numbers);  // Replaces the previous one
+  const Uint32 fooOffset = writer.addString("foo");
+  const Uint32 barOffset = writer.addString("bar");
+  assert(writer.addString("foo") == fooOffset);
+  assert(barOffset != fooOffset);
+  Vector<Uint8> contents;
+  writer.serialize(contents);
+  assert(contents.size() % 16 == 0);
+
+  // Read it back from memory
+  CookedFile cooked;
+  assert(cooked.open(SDL_RWFromConstMem(contents.data(), contents.size()),
+                     type));
+  const Span<const Uint32> numbersIn = cooked.getSection<Uint32>(numbersTag);
+  assert(numbersIn.size() == numbers.size());
+  for (size_t i = 0; i < numbers.size(); ++i) {
+    assert(numbersIn[i] == numbers[i]);
+  }
+  const Span<const Uint8> bytesIn = cooked.getSection<Uint8>(bytesTag);
+  assert(bytesIn.size() == 3 && bytesIn[2] == 9);
+  assert(cooked.getSection<Uint8>(cookedTag("NONE")).empty());
+  assert(strcmp(cooked.getString(fooOffset), "foo") == 0);
+  assert(strcmp(cooked.getString(barOffset), "bar") == 0);
+  assert(strcmp(cooked.getString(1000), "") == 0);
+
+  // Files of other types are rejected, and left open for other loaders
+  SDL_RWops *ops = SDL_RWFromConstMem(contents.data(), contents.size());
+  CookedFile wrongType;
+  assert(!wrongType.open(ops, cookedTag("NOPE")));
+  assert(SDL_RWtell(ops) == 0);
+  SDL_RWclose(ops);
+
+  // As are files that aren't cooked, which are rewound for other loaders
+  const char json[] = "{\"foo\": \"bar\", \"baz\": [1, 2, 3]}";
+  ops = SDL_RWFromConstMem(json, sizeof(json));
+  CookedFile notCooked;
+  assert(!notCooked.open(ops, type));
+  assert(SDL_RWtell(ops) == 0);
+  SDL_RWclose(ops);
+
+  // Truncated files are too
+  ops = SDL_RWFromConstMem(contents.data(), 40);
+  CookedFile truncated;
+  assert(!truncated.open(ops, type));
+  SDL_RWclose(ops);
+  return 0;
+}
@@ -49,6 +49,17 @@ int main(int argc, char *argv[]) {
   assert(config->putArray("woof.baz"));
   config->unwind();
 
+  // Save in the background (twice, which should write once), then flush
+  const Uint64 savesWritten = Dictionary::getSavesWritten();
+  assert(config->saveAsync("config_async.json"));
+  assert(config->saveAsync("config_async.json"));
+  assert(!config->saveAsync("../config_async.json"));
+  Dictionary::flushSaves();
+  assert(Dictionary::getSavesWritten() == savesWritten + 1);
+  DictionaryPtr saved =
+      ResourceManager::getActive()->get<Dictionary>("config_async.json");
+  assert(saved->select("bar.woof.baz") == 3);
+
   // Save, reload, and check JSON file
   assert(config->saveJSON("config.json"));
   config = ResourceManager::getActive()->get<Dictionary>("config.json");
@@ -105,6 +116,48 @@ int main(int argc, char *argv[]) {
       });
   assert(innerProps == 6 && outerProps == 6);
 
+  // Both decoding backends should read (and then modify) the same values
+  const char json[] = "{\"a\":{\"b\":[1,2,{\"c\":\"x\"}]},\"n\":-3.7}";
+  for (int native = 0; native < 2; ++native) {
+    Dictionary::setNativeDecoding(native);
+    Dictionary dict;
+    dict.load(SDL_RWFromConstMem(json, sizeof(json) - 1));
+    Sint32 n;
+    const char *c;
+    assert(dict.get<Sint32>("n", &n) && n == -3);
+    Vector<Uint32> vals;
+    assert(dict.getArray("a.b", vals) && vals.size() == 3 && vals[1] == 2);
+    const DictionaryPath cPath("a.b.2.c"), newPath("d.e");
+    assert(dict.get<const char *>(cPath, &c) && SDL_strcmp(c, "x") == 0);
+    assert(dict.select("a.b") == 2 && dict.end() == 3);
+    assert(dict.selectIndex(2) == 1 && dict.get<const char *>("c", &c));
+    assert(SDL_strcmp(c, "x") == 0);
+    assert(dict.put<const char *>("c", "y"));
+    assert(dict.get<const char *>("c", &c) && SDL_strcmp(c, "y") == 0);
+    dict.unwind();
+    assert(dict.put<Sint32>(newPath, 5) && dict.get<Sint32>(newPath, &n));
+    assert(n == 5 && dict.get<Sint32>("d.e", &n) && n == 5);
+  }
+  Dictionary::setNativeDecoding(true);
+
+  // Heaps only exist once something is modified, and report their usage
+  Dictionary heap;
+  assert(heap.getHeapStats().bytesInUse == 0);
+  assert(heap.put<Uint32>("x", 3));
+  Dictionary::HeapStats heapStats = heap.getHeapStats();
+  assert(heapStats.bytesInUse > 0 && heapStats.allocations > 0);
+  assert(heapStats.peakBytes >= heapStats.bytesInUse);
+
+  // CBOR typed arrays should be viewable in-place: {"f32": Float32Array(2)}
+  const Uint8 cbor[] = {0xa1, 0x63, 'f',  '3',  '2',  0xd8, 0x55, 0x48,
+                        0x00, 0x00, 0x80, 0x3f, 0x00, 0x00, 0x20, 0xc0};
+  Dictionary typed;
+  typed.load(SDL_RWFromConstMem(cbor, sizeof(cbor)));
+  Vector<float> scratch;
+  Span<const float> floats = typed.getArraySpan<float>("f32", scratch);
+  assert(floats.size() == 2 && floats[0] == 1.0f && floats[1] == -2.5f);
+  assert(scratch.empty() || SDL_BYTEORDER == SDL_BIG_ENDIAN);
+
   app.destroy();
   return 0;
 }
@@ -0,0 +1,81 @@
+/****************************************************
+ * Benchmark - Dictionary decoding backends         *
+ * Copyright (C) 2023 Zach Caldwell                 *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+
+#include "Dictionary.h"
+using namespace renity;
+
+#include <SDL3/SDL.h>
+#include <assert.h>
+
+static const int ITERATIONS = 50;
+
+// Read a map or tileset the way Tilemap does, summing up what was read
+static double walk(Dictionary &dict) {
+  double sum = 0;
+  const char *keys[] = {"width",      "height",   "tilewidth",
+                        "tileheight", "tilecount", "columns"};
+  for (const char *key : keys) {
+    Uint32 val;
+    if (dict.get<Uint32>(key, &val)) sum += val;
+  }
+
+  // Only maps have these
+  if (dict.isArray("layers")) {
+    dict.enumerateArray("layers", [&sum](Dictionary &dict, const Uint32 &) {
+      const char *type;
+      if (dict.get<const char *>("type", &type)) sum += SDL_strlen(type);
+      Vector<TileId> scratch;
+      for (TileId tileId : dict.getArraySpan<TileId>("data", scratch)) {
+        sum += tileId;
+      }
+      return true;
+    });
+  }
+
+  // Only tilesets have these
+  if (dict.isArray("tiles")) {
+    dict.enumerateArray("tiles", [&sum](Dictionary &dict, const Uint32 &) {
+      Uint32 id;
+      if (dict.get<Uint32>("id", &id)) sum += id;
+      return true;
+    });
+  }
+
+  sum += dict.enumerate(nullptr, [](Dictionary &, const String &) {
+    return true;
+  });
+  return sum;
+}
+
+int main(int argc, char *argv[]) {
+  for (int arg = 1; arg < argc; ++arg) {
+    double checksums[2];
+    for (int native = 0; native < 2; ++native) {
+      Dictionary::setNativeDecoding(native);
+      const Uint64 start = SDL_GetTicksNS();
+      for (int i = 0; i < ITERATIONS; ++i) {
+        // Dictionary::load() closes the RWops
+        SDL_RWops *src = SDL_RWFromFile(argv[arg], "rb");
+        assert(src);
+        Dictionary dict;
+        dict.load(src);
+        checksums[native] = walk(dict);
+      }
+      const double elapsedMS =
+          (double)(SDL_GetTicksNS() - start) / SDL_NS_PER_MS / ITERATIONS;
+      SDL_Log("%s: %s load+walk took %.3f ms (checksum %.0f)\n", argv[arg],
+              native ? "native" : "Duktape", elapsedMS, checksums[native]);
+    }
+    assert(checksums[0] > 0 && checksums[0] == checksums[1]);
+  }
+
+  Dictionary::setNativeDecoding(true);
+  return 0;
+}
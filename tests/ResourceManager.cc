@@ -0,0 +1,233 @@
+/****************************************************
+ * Test - ResourceManager                           *
+ * Copyright (C) 2023 Zach Caldwell                 *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+
+#include "ResourceManager.h"
+
+#include "Application.h"
+#include "Dictionary.h"
+#include "resources/ScriptContext.h"
+#include "resources/StringBuffer.h"
+#include "utils/rwops_utils.h"
+using namespace renity;
+
+#include <SDL3/SDL.h>
+#include <assert.h>
+
+static const int GETTER_COUNT = 8;
+static DictionaryPtr concurrentGets[GETTER_COUNT];
+
+static int getConcurrently(void *data) {
+  int index = (int)(intptr_t)data;
+  concurrentGets[index] =
+      ResourceManager::getActive()->get<Dictionary>("concurrent.json");
+  return 0;
+}
+
+static void countReload(void *userdata) { ++*(int *)(userdata); }
+
+// Stands in for a Resource that uploads to the GPU, noting where it loads
+static AtomicUint64 uploadThread;
+class UploadingBuffer : public StringBuffer {
+ public:
+  void load(SDL_RWops *src) {
+    uploadThread = SDL_ThreadID();
+    StringBuffer::load(src);
+  }
+
+ protected:
+  bool needsGpuContext() const { return true; }
+};
+
+static AtomicFlag8 uploadGot;
+static int getUpload(void *data) {
+  (void)(data);
+  ResourceManager::getActive()->get<UploadingBuffer>("upload.json");
+  uploadGot = 1;
+  return 0;
+}
+
+// Files that each name the other, loaded from two threads at once, so each
+// thread ends up requesting what the other is in the middle of loading
+static AtomicUint64 cycleLoads;
+class CyclicBuffer : public StringBuffer {
+ public:
+  void load(SDL_RWops *src) {
+    StringBuffer::load(src);
+    if (!src) return;
+    ++cycleLoads;
+    for (int wait = 0; cycleLoads < 2 && wait < 1000; ++wait) SDL_Delay(1);
+    ResourceManager::getActive()->get<CyclicBuffer>(getCStr());
+  }
+};
+
+static int getCyclic(void *data) {
+  ResourceManager::getActive()->get<CyclicBuffer>((const char *)data);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  Application app(argc, argv);
+  assert(app.initialize(true));
+  ResourceManager *resMgr = ResourceManager::getActive();
+
+  // Write out some files to load back in
+  DictionaryPtr source = resMgr->get<Dictionary>("<source>");
+  assert(source->put<const char *>("foo", "bar"));
+  assert(source->saveJSON("asyncA.json"));
+  assert(source->saveJSON("asyncB.json"));
+  assert(source->saveJSON("asyncC.json"));
+  assert(source->saveJSON("concurrent.json"));
+  assert(source->saveJSON("script.json"));
+
+  // Async loads start out as placeholders and get filled in by update()
+  DictionaryPtr async = resMgr->getAsync<Dictionary>("asyncA.json");
+  const char *val = nullptr;
+  assert(async->isPending());
+  assert(!async->get<const char *>("foo", &val));
+  for (int frame = 0; async->isPending(); ++frame) {
+    assert(frame < 1000);
+    resMgr->update();
+    SDL_Delay(1);
+  }
+  assert(async->get<const char *>("foo", &val));
+  assert(SDL_strcmp(val, "bar") == 0);
+  assert(resMgr->getAsync<Dictionary>("asyncA.json") == async);
+
+  // Synchronous gets finish pending loads right away
+  async = resMgr->getAsync<Dictionary>("asyncB.json");
+  DictionaryPtr sync = resMgr->get<Dictionary>("asyncB.json");
+  assert(sync == async);
+  assert(!sync->isPending());
+  assert(sync->get<const char *>("foo", &val));
+  assert(SDL_strcmp(val, "bar") == 0);
+
+  // Prehashed and interned paths find the same cached Resources
+  static constexpr ResourcePath syncPath("asyncB.json");
+  static_assert(syncPath.id() == hashPath("asyncB.json"));
+  assert(resMgr->get<Dictionary>(syncPath) == sync);
+  String builtPath = String("async") + "B.json";
+  ResourcePath interned = ResourcePath::intern(builtPath);
+  assert(interned.c_str() != builtPath.c_str());
+  assert(interned.c_str() == ResourcePath::intern("asyncB.json").c_str());
+  assert(resMgr->get<Dictionary>(interned) == sync);
+
+  // Simultaneous requests from several threads share a single load
+  SDL_Thread *getters[GETTER_COUNT];
+  for (int i = 0; i < GETTER_COUNT; ++i) {
+    getters[i] =
+        SDL_CreateThread(getConcurrently, "getter", (void *)(intptr_t)i);
+    assert(getters[i]);
+  }
+  for (int i = 0; i < GETTER_COUNT; ++i) {
+    SDL_WaitThread(getters[i], nullptr);
+    assert(concurrentGets[i] == concurrentGets[0]);
+  }
+  assert(!concurrentGets[0]->isPending());
+  assert(concurrentGets[0]->get<const char *>("foo", &val));
+  for (auto &stats : resMgr->getLoadStats()) {
+    if (stats.path == "concurrent.json") assert(stats.reloadCount == 0);
+  }
+
+  // Other threads leave loads that need the GL context to update()
+  assert(source->saveJSON("upload.json"));
+  SDL_Thread *uploader = SDL_CreateThread(getUpload, "uploader", nullptr);
+  assert(uploader);
+  for (int frame = 0; !uploadGot; ++frame) {
+    assert(frame < 1000);
+    resMgr->update();
+    SDL_Delay(1);
+  }
+  SDL_WaitThread(uploader, nullptr);
+  assert(uploadThread == SDL_ThreadID());
+  assert(!resMgr->get<UploadingBuffer>("upload.json")->isPending());
+
+  // Cycles between threads fail one side rather than deadlocking
+  assert(RENITY_WriteBufferToPath("cycleA.txt", (const Uint8 *)"cycleB.txt",
+                                  10) == 10);
+  assert(RENITY_WriteBufferToPath("cycleB.txt", (const Uint8 *)"cycleA.txt",
+                                  10) == 10);
+  SDL_Thread *cyclers[2] = {
+      SDL_CreateThread(getCyclic, "cyclerA", (void *)"cycleA.txt"),
+      SDL_CreateThread(getCyclic, "cyclerB", (void *)"cycleB.txt")};
+  assert(cyclers[0] && cyclers[1]);
+  SDL_WaitThread(cyclers[0], nullptr);
+  SDL_WaitThread(cyclers[1], nullptr);
+  assert(!resMgr->get<CyclicBuffer>("cycleA.txt")->isPending());
+  assert(!resMgr->get<CyclicBuffer>("cycleB.txt")->isPending());
+
+  // Reloads propagate to whatever requested the reloaded Resource
+  ScriptContextPtr script = resMgr->get<ScriptContext>("script.json");
+  Vector<String> users = resMgr->getDependents("/assets/scripts/init.js");
+  assert(users.size() == 1 && users[0] == "script.json");
+  int reloads[2] = {0, 0};
+  script->addReloadCallback(countReload, &reloads[0]);
+  script->addReloadCallback(countReload, &reloads[1]);
+  script->addReloadCallback(countReload, &reloads[1]);
+  resMgr->reload("/assets/scripts/init.js");
+  assert(reloads[0] == 0);
+  resMgr->update();
+  assert(reloads[0] == 1 && reloads[1] == 1);
+  script->removeReloadCallback(countReload, &reloads[0]);
+  resMgr->reload("script.json");
+  resMgr->update();
+  assert(reloads[0] == 1 && reloads[1] == 2);
+
+  // Manifests queue up everything they list, and report progress
+  DictionaryPtr manifest = resMgr->get<Dictionary>("<manifest>");
+  assert(manifest->putArray("resources"));
+  assert(manifest->select("resources") == 1);
+  assert(manifest->push<const char *>("asyncC.json"));
+  manifest->unwind();
+  assert(manifest->saveJSON("manifest.json"));
+  Vector<ResourcePtr> preloaded = resMgr->preload("manifest.json");
+  assert(preloaded.size() == 1 && preloaded[0]->isPending());
+  for (int frame = 0; resMgr->getLoadProgress().finished <
+                      resMgr->getLoadProgress().queued;
+       ++frame) {
+    assert(frame < 1000);
+    resMgr->update();
+    SDL_Delay(1);
+  }
+  assert(!preloaded[0]->isPending());
+  assert(resMgr->get<Dictionary>("asyncC.json") == preloaded[0]);
+
+  // Loads are instrumented, whether they happened in the background or not,
+  // manifests included
+  Uint32 instrumented = 0;
+  for (auto &stats : resMgr->getLoadStats()) {
+    if (stats.path == "asyncA.json" || stats.path == "asyncB.json" ||
+        stats.path == "manifest.json") {
+      assert(stats.bytesRead > 0 && stats.refCount > 0);
+      ++instrumented;
+    }
+  }
+  assert(instrumented == 3);
+  assert(resMgr->saveLoadStats("resource_stats.json"));
+
+  // Released Resources are kept around for reuse, within the retention budget
+  Dictionary *released = sync.get();
+  sync.reset();
+  async.reset();
+  ResourceCacheStats stats = resMgr->getCacheStats();
+  assert(stats.retainedCount >= 1 && stats.retainedBytes > 0);
+  assert(resMgr->get<Dictionary>("asyncB.json").get() == released);
+  assert(resMgr->getCacheStats().hits > stats.hits);
+
+  // Or dropped right away, once their user knows they're done with
+  const Uint32 retainedCount = resMgr->getCacheStats().retainedCount;
+  resMgr->release("asyncB.json");
+  assert(resMgr->getCacheStats().retainedCount == retainedCount - 1);
+  resMgr->setRetentionBudget(0);
+  resMgr->update();
+  assert(resMgr->getCacheStats().retainedCount == 0);
+  assert(resMgr->getCacheStats().evictions >= stats.retainedCount);
+
+  return 0;
+}
@@ -0,0 +1,69 @@
+/****************************************************
+ * Test - Tilemap                                   *
+ * Copyright (C) 2023 Zach Caldwell                 *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+
+#include "resources/Tilemap.h"
+
+#include "Application.h"
+#include "CookedFile.h"
+#include "Dictionary.h"
+#include "GL_TileRenderer.h"
+using namespace renity;
+
+#include <SDL3/SDL.h>
+#include <assert.h>
+
+// A 16-tile sheet; the image itself isn't needed to cook a map
+static const char tilesetJson[] =
+    "{\"image\": \"missing.png\", \"imagewidth\": 128, \"imageheight\": 32,"
+    " \"tilewidth\": 32, \"tileheight\": 32, \"columns\": 4}";
+
+// Layer ids with a gap, out of layer order, as Tiled leaves them after
+// layers are deleted and reordered
+static const char mapJson[] =
+    "{\"width\": 3, \"height\": 1, \"tilewidth\": 32, \"tileheight\": 32,"
+    " \"tilesets\": [{\"firstgid\": 1, \"source\": \"depth_tileset.json\"}],"
+    " \"layers\": ["
+    "  {\"id\": 9, \"name\": \"back\", \"type\": \"tilelayer\","
+    "   \"data\": [1, 0, 0]},"
+    "  {\"id\": 2, \"name\": \"middle\", \"type\": \"tilelayer\","
+    "   \"data\": [0, 2, 0]},"
+    "  {\"id\": 5, \"name\": \"front\", \"type\": \"tilelayer\","
+    "   \"data\": [0, 0, 3]}]}";
+
+int main(int argc, char *argv[]) {
+  Application app(argc, argv);
+  assert(app.initialize(true));
+
+  Dictionary tileset;
+  tileset.load(SDL_RWFromConstMem(tilesetJson, sizeof(tilesetJson) - 1));
+  assert(tileset.saveJSON("depth_tileset.json"));
+
+  // Cook the map and read back its tiles, one per layer
+  Dictionary map;
+  map.load(SDL_RWFromConstMem(mapJson, sizeof(mapJson) - 1));
+  CookedFileWriter writer;
+  assert(Tilemap::cook(map, writer));
+  Vector<Uint8> contents;
+  writer.serialize(contents);
+  CookedFile cooked;
+  assert(cooked.open(SDL_RWFromConstMem(contents.data(), contents.size()),
+                     cookedTag("TMAP")));
+  const Span<const TileInstance> tiles =
+      cooked.getSection<TileInstance>(cookedTag("TILE"));
+  assert(tiles.size() == 3);
+
+  // Depth follows the layer order, back to front, whatever the ids are
+  for (auto &tile : tiles) {
+    const Uint8 depth = tile.flags & TILE_DEPTH_MASK;
+    assert(tile.y == 0 && tile.x < 3);
+    assert(depth == 2 - tile.x);
+  }
+  return 0;
+}
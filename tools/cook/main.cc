@@ -0,0 +1,148 @@
+/****************************************************
+ * main.cc: Offline asset cooker entry point        *
+ * Copyright (C) 2023 Zach Caldwell                 *
+ ****************************************************
+ * This Source Code Form is subject to the terms of *
+ * the Mozilla Public License, v. 2.0. If a copy of *
+ * the MPL was not distributed with this file, You  *
+ * can obtain one at http://mozilla.org/MPL/2.0/.   *
+ ***************************************************/
+
+#include "CookedFile.h"
+#include "Dictionary.h"
+#include "resources/GL_Mesh.h"
+#include "resources/GL_ShaderProgram.h"
+#include "resources/TileWorld.h"
+#include "resources/Tilemap.h"
+#include "resources/Tileset.h"
+#include "utils/physfsrwops.h"
+#include "utils/rwops_utils.h"
+#include "utils/string_helpers.h"
+#include "version.h"
+using namespace renity;
+
+#include <SDL3/SDL_log.h>
+#include <physfs.h>
+#include <stdio.h>
+
+// Cooked files keep their original names, so references between them still
+// resolve; loaders tell them apart from JSON by their header.
+struct Cooker {
+  const char *extension;
+  bool (*cook)(Dictionary &dict, CookedFileWriter &out);
+};
+static const Cooker cookers[] = {{".world", TileWorld::cook},
+                                 {".tmj", Tilemap::cook},
+                                 {".tsj", Tileset::cook},
+                                 {".mesh", GL_Mesh::cook},
+                                 {".shader", GL_ShaderProgram::cook}};
+
+struct CookStats {
+  Uint32 cooked;
+  Uint32 copied;
+  Uint32 failed;
+};
+
+// Cook or copy a file from /assets/<path> to <path> in the write dir
+static bool cookFile(const String &path, CookStats *stats) {
+  const String srcPath = "/assets/" + path;
+  for (auto &cooker : cookers) {
+    if (!endsWith(path, cooker.extension)) continue;
+    SDL_RWops *src = RENITY_OpenRead(srcPath.c_str());
+    if (!src) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not open '%s': %s\n",
+                   srcPath.c_str(), SDL_GetError());
+      return false;
+    }
+    Dictionary dict;
+    dict.load(src);
+    CookedFileWriter out;
+    if (!cooker.cook(dict, out) || !out.save(path.c_str())) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not cook '%s'.\n",
+                   srcPath.c_str());
+      return false;
+    }
+    ++stats->cooked;
+    return true;
+  }
+
+  Uint8 *buf = nullptr;
+  const Sint64 size =
+      RENITY_ReadRawBufferMax(PHYSFSRWOPS_openRead(srcPath.c_str()), &buf,
+                              UINT32_MAX);
+  const bool copied =
+      size >= 0 &&
+      RENITY_WriteBufferToPath(path.c_str(), buf, (Uint32)size) == size;
+  SDL_free(buf);
+  if (!copied) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not copy '%s'.\n",
+                 srcPath.c_str());
+    return false;
+  }
+  ++stats->copied;
+  return true;
+}
+
+static PHYSFS_EnumerateCallbackResult cookTree(void *data, const char *origDir,
+                                               const char *fname) {
+  CookStats *stats = (CookStats *)data;
+  String path(origDir);
+  path = path.substr(constStrlen("/assets"));
+  if (!path.empty() && path[0] == '/') path.erase(0, 1);
+  if (!path.empty()) path += '/';
+  path += fname;
+
+  PHYSFS_Stat stat;
+  const String srcPath = "/assets/" + path;
+  if (!PHYSFS_stat(srcPath.c_str(), &stat)) return PHYSFS_ENUM_ERROR;
+  if (stat.filetype == PHYSFS_FILETYPE_DIRECTORY) {
+    if (!PHYSFS_mkdir(path.c_str())) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                   "Could not create directory '%s': %s\n", path.c_str(),
+                   PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+      return PHYSFS_ENUM_ERROR;
+    }
+    if (!PHYSFS_enumerate(srcPath.c_str(), cookTree, data)) {
+      return PHYSFS_ENUM_ERROR;
+    }
+  } else if (!cookFile(path, stats)) {
+    ++stats->failed;
+  }
+  return PHYSFS_ENUM_OK;
+}
+
+int main(int argc, char *argv[]) {
+  printf("%s cooker %s.%i-%s-%s\n", PRODUCT_NAME, PRODUCT_VERSION_STR,
+         PRODUCT_VERSION_BUILD, PRODUCT_BUILD_TYPE, PRODUCT_REVISION);
+  if (argc < 3) {
+    printf("Usage: %s <assetDir> <outDir> [subdir ...]\n", argv[0]);
+    printf("Cooks the given asset subdirectories (or all of them) from "
+           "assetDir into outDir.\n");
+    return 2;
+  }
+
+  if (!PHYSFS_init(argv[0]) || !PHYSFS_mount(argv[1], "/assets", 0) ||
+      !PHYSFS_setWriteDir(argv[2])) {
+    SDL_LogCritical(SDL_LOG_CATEGORY_APPLICATION,
+                    "Could not set up asset paths: %s\n",
+                    PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+    PHYSFS_deinit();
+    return 1;
+  }
+
+  CookStats stats = {0, 0, 0};
+  bool enumerated = true;
+  if (argc == 3) {
+    enumerated = PHYSFS_enumerate("/assets", cookTree, &stats);
+  }
+  for (int arg = 3; arg < argc; ++arg) {
+    enumerated = enumerated && PHYSFS_mkdir(argv[arg]) &&
+                 PHYSFS_enumerate((String("/assets/") + argv[arg]).c_str(),
+                                  cookTree, &stats);
+  }
+  PHYSFS_deinit();
+
+  printf("Cooked %u and copied %u file(s); %u failed.\n", stats.cooked,
+         stats.copied, stats.failed);
+  return (enumerated && !stats.failed) ? 0 : 1;
+}